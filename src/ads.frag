@@ -1,4 +1,6 @@
-in vec3 LightIntensity;
+#version 430
+
+layout(location = 0) in vec3 LightIntensity;
 
 out vec4 FragColor;
 
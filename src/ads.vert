@@ -1,9 +1,41 @@
 #version 430
 
+#if defined(MULTI_DRAW)
+// Objects of a multi-draw indirect batch: one draw per object, each finding
+// its instance by draw index
+#extension GL_ARB_shader_draw_parameters : require
+#define INSTANCED
+#define INSTANCE_INDEX gl_DrawIDARB
+#elif defined(GPU_CULLED)
+// Objects that passed cull.comp: one draw per mesh, instanced over the
+// range of visible objects starting at the draw's base instance
+#extension GL_ARB_shader_draw_parameters : require
+#define INSTANCED
+#define INSTANCE_INDEX (gl_BaseInstanceARB + gl_InstanceID)
+#else
+#define INSTANCE_INDEX gl_InstanceID
+#endif
+
 in vec3 VertexPosition;
+#ifdef OCTAHEDRAL_NORMAL
+in vec2 VertexNormal;   // octahedral encoding
+#else
 in vec3 VertexNormal;
+#endif
+
+#ifdef QUANTIZED_POSITION
+// Maps the normalized stored position to mesh space
+uniform vec3 PositionScale;
+uniform vec3 PositionOffset;
+#endif
+
+layout(location = 0) out vec3 LightIntensity;
 
-out vec3 LightIntensity;
+// Needed to use the shader in a separable program
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
 
 struct LightInfo
 {
@@ -12,7 +44,10 @@ struct LightInfo
     vec3 Ld;        // diffuse intensity
     vec3 Ls;        // specular intensity
 };
-uniform LightInfo Light;
+layout(std140) uniform LightBlock
+{
+    LightInfo Light;
+};
 
 struct MaterialInfo
 {
@@ -21,35 +56,92 @@ struct MaterialInfo
     vec3 Ks;        // specular reflectivity
     float Shine;    // "shininess" factor for specular reflection
 };
-uniform MaterialInfo Material;
 
-uniform mat4 ModelViewMatrix;
-uniform mat4 ProjectionMatrix;
-uniform mat3 NormalMatrix;
+#ifdef INSTANCED
+// Per-instance transforms and materials, indexed by INSTANCE_INDEX. Lighting
+// is done in world space, with ModelViewMatrix holding the view matrix.
+struct InstanceInfo
+{
+    mat4 ModelMatrix;   // rotation and uniform scale only
+    uint MaterialIndex;
+};
+layout(std430, binding = 0) readonly buffer InstanceBuffer
+{
+    InstanceInfo Instances[];
+};
+layout(std430, binding = 1) readonly buffer MaterialBuffer
+{
+    MaterialInfo Materials[];
+};
+#else
+layout(std140) uniform MaterialBlock
+{
+    MaterialInfo Material;
+};
+#endif
+
+#include "matrices.glsl"
+
+vec3 DecodePosition()
+{
+#ifdef QUANTIZED_POSITION
+    return VertexPosition * PositionScale + PositionOffset;
+#else
+    return VertexPosition;
+#endif
+}
+
+vec3 DecodeNormal()
+{
+#ifdef OCTAHEDRAL_NORMAL
+    // Unfold the lower hemisphere from the corners of the square
+    vec3 n = vec3(VertexNormal, 1.0 - abs(VertexNormal.x) - abs(VertexNormal.y));
+    float fold = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -fold : fold;
+    n.y += n.y >= 0.0 ? -fold : fold;
+    return n;
+#else
+    return VertexNormal;
+#endif
+}
 
 void main()
 {
+    vec3 vertexPosition = DecodePosition();
+    vec3 vertexNormal = DecodeNormal();
+
+#ifdef INSTANCED
+    InstanceInfo instance = Instances[INSTANCE_INDEX];
+    MaterialInfo material = Materials[instance.MaterialIndex];
+    vec3 position = vec3(instance.ModelMatrix * vec4(vertexPosition, 1.0));
+    vec3 normal = mat3(instance.ModelMatrix) * vertexNormal;
+#else
+    MaterialInfo material = Material;
+    vec3 position = vertexPosition;
+    vec3 normal = vertexNormal;
+#endif
+
     // Calculate ambient light intensity
-    vec3 ambientLight = Material.Ka * Light.La;
+    vec3 ambientLight = material.Ka * Light.La;
 
     // Calculate diffuse light intensity
-    vec3 s = normalize(Light.Position - VertexPosition);
-    vec3 n = normalize(VertexNormal);
-    vec3 diffuseLight = Material.Kd * Light.Ld * max(dot(s, n), 0.0);
+    vec3 s = normalize(Light.Position - position);
+    vec3 n = normalize(normal);
+    vec3 diffuseLight = material.Kd * Light.Ld * max(dot(s, n), 0.0);
 
     // Calculate specular light intensity
     vec3 r = -s + n * 2 * dot(s, n);
     mat4 viewModel = inverse(ModelViewMatrix);
     vec3 cameraPos = vec3(viewModel[3]);
-    vec3 v = normalize(cameraPos - VertexPosition);
+    vec3 v = normalize(cameraPos - position);
     //vec3 v = -normalize(vec3(ModelViewMatrix * vec4(VertexPosition, 1.0)));
     //vec3 v = normalize(vec3(inverse(ModelViewMatrix) * -vec4(VertexPosition, 1.0)));
-    vec3 specularLight = Material.Ks * Light.Ls * pow(max(dot(r, v), 0.0), Material.Shine);
+    vec3 specularLight = material.Ks * Light.Ls * pow(max(dot(r, v), 0.0), material.Shine);
 
     // Calculate and pass total light intensity
     LightIntensity = ambientLight + diffuseLight + specularLight;
 
     // Calculate vertex position
     mat4 MVP = ProjectionMatrix * ModelViewMatrix;
-    gl_Position = MVP * vec4(VertexPosition, 1.0);
+    gl_Position = MVP * vec4(position, 1.0);
 }
\ No newline at end of file
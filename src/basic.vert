@@ -3,7 +3,13 @@
 in vec3 VertexPosition;
 in vec3 VertexColor;
 
-out vec3 Color;
+layout(location = 0) out vec3 Color;
+
+// Needed to use the shader in a separable program
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
 
 uniform mat4 RotationMatrix;
 
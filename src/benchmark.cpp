@@ -0,0 +1,1205 @@
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "benchmark.hpp"
+#include "clustered_lighting.hpp"
+#include "cooked_mesh.hpp"
+#include "cpu_culler.hpp"
+#include "error.hpp"
+#include "glsl_compiler.hpp"
+#include "glsl_pipeline.hpp"
+#include "glsl_program.hpp"
+#include "glsl_program_cache.hpp"
+#include "glsl_shader_cache.hpp"
+#include "gpu_culler.hpp"
+#include "job_system.hpp"
+#include "mesh_batch.hpp"
+#include "mesh_loader.hpp"
+#include "mesh_optimizer.hpp"
+#include "parallel.hpp"
+#include "render_target.hpp"
+#include "scene.hpp"
+#include "stream_buffer.hpp"
+#include "timing_stats.hpp"
+#include "vertex_format.hpp"
+
+static const char BENCH_CACHE_DIR[] = "../cache/bench";
+static const char ADS_VERT_PATH[] = "../src/ads.vert";
+static const char ADS_FRAG_PATH[] = "../src/ads.frag";
+static const char CULL_COMP_PATH[] = "../src/cull.comp";
+static const int MESH_LOAD_REPEAT_NUM = 5;
+// Frames are rendered until both limits are reached
+static const int INSTANCE_BENCH_MIN_FRAME_NUM = 5;
+static const double INSTANCE_BENCH_MIN_TIME_MS = 500.0;
+static const int MULTI_DRAW_BENCH_MIN_SEGMENT_NUM = 8;
+// Half size of the culling benchmark grid, with the camera at its center
+static const float CULL_BENCH_GRID_EXTENT = 10.0f;
+static const int CPU_CULL_BENCH_REPEAT_NUM = 9;
+static const char BASIC_VERT_PATH[] = "../src/basic.vert";
+static const char BASIC_FRAG_PATH[] = "../src/basic.frag";
+static const int STREAM_BENCH_FRAME_NUM = 60;
+static const char CLUSTERED_VERT_PATH[] = "../src/clustered.vert";
+static const char CLUSTERED_FRAG_PATH[] = "../src/clustered.frag";
+static const char CLUSTER_LIGHTS_COMP_PATH[] = "../src/cluster_lights.comp";
+// Lights are spread over a cube of this half-size around the mesh, with
+// radii giving every point about this many lights
+static const float LIGHT_BENCH_EXTENT = 1.5f;
+static const float LIGHT_BENCH_LIGHTS_PER_POINT = 16.0f;
+static const int JOB_BENCH_REPEAT_NUM = 5;
+static const int JOB_BENCH_FIB_CUTOFF = 16;
+static const size_t JOB_BENCH_REDUCE_CHUNK = 64 * 1024;
+static const int JOB_BENCH_NBODY_STEP_NUM = 4;
+static const size_t JOB_BENCH_NBODY_GRAIN = 32;
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+static std::string ReadFile(const char *file)
+{
+    std::ifstream ifs(file);
+    return std::string((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+}
+
+typedef std::vector<std::unique_ptr<GLSLProgram>> ProgramList;
+
+// Create programs with recorded (not yet compiled) ADS shader sources. A unique
+// comment per program keeps the sources and cache keys distinct.
+static ProgramList CreateVariantPrograms(GLSLProgramCache *cache, const std::string &vertSource, const std::string &fragSource, int programNum)
+{
+    ProgramList programs;
+    for (int i = 0; i < programNum; i++) {
+        std::ostringstream vertVariant;
+        vertVariant << vertSource << "\n// variant " << i << "\n";
+
+        std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+        program->SetBinaryCache(cache);
+        program->CompileShader(vertVariant.str(), GLSLShaderType::VERTEX, ADS_VERT_PATH);
+        program->CompileShader(fragSource, GLSLShaderType::FRAGMENT, ADS_FRAG_PATH);
+        program->BindAttribLocation(0, "VertexPosition");
+        program->BindAttribLocation(1, "VertexNormal");
+        programs.push_back(std::move(program));
+    }
+    return programs;
+}
+
+static double BuildPrograms(GLSLProgramCache &cache, const std::string &vertSource, const std::string &fragSource, int programNum)
+{
+    ProgramList programs = CreateVariantPrograms(&cache, vertSource, fragSource, programNum);
+    BenchClock::time_point start = BenchClock::now();
+    for (size_t i = 0; i < programs.size(); i++) {
+        programs[i]->Link();
+    }
+    return ElapsedMs(start);
+}
+
+void RunStartupBenchmark(int programNum)
+{
+    GLSLProgramCache cache(BENCH_CACHE_DIR);
+    if (!cache.IsSupported()) {
+        std::cout << "Startup benchmark: program binaries are not supported by the driver" << std::endl;
+        return;
+    }
+    cache.Clear();
+
+    std::string vertSource = ReadFile(ADS_VERT_PATH);
+    std::string fragSource = ReadFile(ADS_FRAG_PATH);
+
+    double coldMs = BuildPrograms(cache, vertSource, fragSource, programNum);
+    unsigned long coldMisses = cache.Misses();
+    double warmMs = BuildPrograms(cache, vertSource, fragSource, programNum);
+    unsigned long warmHits = cache.Hits();
+
+    std::cout << "Startup benchmark (" << programNum << " programs):" << std::endl;
+    std::cout << "  cold: " << coldMs << " ms (" << coldMisses << " misses)" << std::endl;
+    std::cout << "  warm: " << warmMs << " ms (" << warmHits << " hits)" << std::endl;
+
+    cache.Clear();
+}
+
+void RunCompileBenchmark(GLFWwindow *window, int programNum)
+{
+    std::string vertSource = ReadFile(ADS_VERT_PATH);
+    std::string fragSource = ReadFile(ADS_FRAG_PATH);
+
+    // Different variant offsets keep the driver from reusing the serial
+    // pass's shaders in the batched one
+    ProgramList serialPrograms = CreateVariantPrograms(nullptr, vertSource + "// serial\n", fragSource, programNum);
+    BenchClock::time_point serialStart = BenchClock::now();
+    for (size_t i = 0; i < serialPrograms.size(); i++) {
+        serialPrograms[i]->Link();
+    }
+    double serialMs = ElapsedMs(serialStart);
+
+    GLSLCompiler compiler(window);
+    ProgramList batchPrograms = CreateVariantPrograms(nullptr, vertSource + "// batch\n", fragSource, programNum);
+    std::vector<GLSLProgram *> batch;
+    for (size_t i = 0; i < batchPrograms.size(); i++) {
+        batch.push_back(batchPrograms[i].get());
+    }
+    BenchClock::time_point batchStart = BenchClock::now();
+    compiler.LinkAll(batch);
+    double batchMs = ElapsedMs(batchStart);
+
+    std::cout << "Compile benchmark (" << programNum << " programs):" << std::endl;
+    std::cout << "  serial: " << serialMs << " ms" << std::endl;
+    std::cout << "  batch:  " << batchMs << " ms (";
+    if (compiler.IsDriverParallel()) {
+        std::cout << "driver parallel compile";
+    } else {
+        std::cout << compiler.ThreadNum() << " worker contexts";
+    }
+    std::cout << ")" << std::endl;
+}
+
+static std::unique_ptr<GLSLProgram> CreateStageProgram(const char *file, const GLSLDefines &defines)
+{
+    std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+    program->SetSeparable(true);
+    program->SetDefines(defines);
+    program->CompileShader(file);
+    program->BindAttribLocation(0, "VertexPosition");
+    program->BindAttribLocation(1, "VertexNormal");
+    program->Link();
+    return program;
+}
+
+void RunPipelineBenchmark(int stageVariantNum, int drawNum)
+{
+    int comboNum = stageVariantNum * stageVariantNum;
+
+    // Separable: one program per stage variant, combined in pipelines
+    BenchClock::time_point separableStart = BenchClock::now();
+    ProgramList vertexStages;
+    ProgramList fragmentStages;
+    for (int i = 0; i < stageVariantNum; i++) {
+        vertexStages.push_back(CreateStageProgram(ADS_VERT_PATH, GLSLDefines().Set("VERTEX_VARIANT", i)));
+        fragmentStages.push_back(CreateStageProgram(ADS_FRAG_PATH, GLSLDefines().Set("FRAGMENT_VARIANT", i)));
+    }
+    GLSLPipelineCache pipelines;
+    std::vector<GLSLPipeline *> pipelineCombos;
+    for (int i = 0; i < comboNum; i++) {
+        pipelineCombos.push_back(&pipelines.Get(*vertexStages[i / stageVariantNum], *fragmentStages[i % stageVariantNum]));
+    }
+    double separableBuildMs = ElapsedMs(separableStart);
+
+    // Monolithic: one linked program per combination
+    BenchClock::time_point monolithicStart = BenchClock::now();
+    ProgramList programCombos;
+    for (int i = 0; i < comboNum; i++) {
+        std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+        program->SetDefines(GLSLDefines().Set("VERTEX_VARIANT", i / stageVariantNum).Set("FRAGMENT_VARIANT", i % stageVariantNum));
+        program->CompileShader(ADS_VERT_PATH);
+        program->CompileShader(ADS_FRAG_PATH);
+        program->BindAttribLocation(0, "VertexPosition");
+        program->BindAttribLocation(1, "VertexNormal");
+        program->Link();
+        programCombos.push_back(std::move(program));
+    }
+    double monolithicBuildMs = ElapsedMs(monolithicStart);
+
+    // Switch state before every draw of a single triangle, so that the
+    // switching cost dominates
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glFinish();
+    BenchClock::time_point pipelineStart = BenchClock::now();
+    for (int i = 0; i < drawNum; i++) {
+        pipelineCombos[i % comboNum]->Use();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glFinish();
+    double pipelineSwitchMs = ElapsedMs(pipelineStart);
+    glBindProgramPipeline(0);
+
+    BenchClock::time_point programStart = BenchClock::now();
+    for (int i = 0; i < drawNum; i++) {
+        programCombos[i % comboNum]->Use();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glFinish();
+    double programSwitchMs = ElapsedMs(programStart);
+    GLSLProgram::UseNone();
+
+    glDeleteVertexArrays(1, &vao);
+
+    std::cout << "Pipeline benchmark (" << stageVariantNum << " x " << stageVariantNum << " stage combinations, "
+              << drawNum << " draws):" << std::endl;
+    std::cout << "  build: separable " << separableBuildMs << " ms (" << stageVariantNum * 2 << " programs), "
+              << "monolithic " << monolithicBuildMs << " ms (" << comboNum << " programs)" << std::endl;
+    std::cout << "  switch + draw: glBindProgramPipeline " << pipelineSwitchMs << " ms, "
+              << "glUseProgram " << programSwitchMs << " ms" << std::endl;
+}
+
+// Link all vertex x fragment variant combinations. Every program is recorded
+// before the first link, so that shared shader objects stay alive until the
+// last program using them is linked.
+static double BuildSharedStagePrograms(GLSLShaderCache *shaderCache, const std::string &vertSource, const std::string &fragSource, int stageVariantNum)
+{
+    std::vector<std::string> vertVariants;
+    std::vector<std::string> fragVariants;
+    for (int i = 0; i < stageVariantNum; i++) {
+        std::ostringstream variant;
+        variant << "\n// variant " << i << "\n";
+        vertVariants.push_back(vertSource + variant.str());
+        fragVariants.push_back(fragSource + variant.str());
+    }
+
+    BenchClock::time_point start = BenchClock::now();
+    ProgramList programs;
+    for (int i = 0; i < stageVariantNum * stageVariantNum; i++) {
+        std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+        program->SetShaderCache(shaderCache);
+        program->CompileShader(vertVariants[i / stageVariantNum], GLSLShaderType::VERTEX, ADS_VERT_PATH);
+        program->CompileShader(fragVariants[i % stageVariantNum], GLSLShaderType::FRAGMENT, ADS_FRAG_PATH);
+        program->BindAttribLocation(0, "VertexPosition");
+        program->BindAttribLocation(1, "VertexNormal");
+        programs.push_back(std::move(program));
+    }
+    for (size_t i = 0; i < programs.size(); i++) {
+        programs[i]->Link();
+    }
+    return ElapsedMs(start);
+}
+
+void RunShaderSharingBenchmark(int stageVariantNum)
+{
+    std::string vertSource = ReadFile(ADS_VERT_PATH);
+    std::string fragSource = ReadFile(ADS_FRAG_PATH);
+    int programNum = stageVariantNum * stageVariantNum;
+
+    // Different suffixes keep the driver from reusing the first pass's shaders
+    double unsharedMs = BuildSharedStagePrograms(nullptr, vertSource + "// unshared\n", fragSource + "// unshared\n", stageVariantNum);
+
+    GLSLShaderCache shaderCache;
+    double sharedMs = BuildSharedStagePrograms(&shaderCache, vertSource + "// shared\n", fragSource + "// shared\n", stageVariantNum);
+
+    std::cout << "Shader sharing benchmark (" << programNum << " programs from " << stageVariantNum << " + "
+              << stageVariantNum << " stage variants):" << std::endl;
+    std::cout << "  unshared: " << unsharedMs << " ms (" << programNum * 2 << " compiles)" << std::endl;
+    std::cout << "  shared:   " << sharedMs << " ms (" << shaderCache.Compiles() << " compiles, "
+              << shaderCache.Reuses() << " reuses, peak " << shaderCache.PeakLiveShaderNum() << " live shader objects, "
+              << shaderCache.LiveShaderNum() << " left after linking)" << std::endl;
+}
+
+// Unindexed UV sphere, as a list of independent triangles
+static std::vector<MeshVertex> CreateSphereTriangles(int segmentNum)
+{
+    int ringNum = segmentNum / 2;
+    std::vector<MeshVertex> grid;
+    for (int ring = 0; ring <= ringNum; ring++) {
+        float theta = glm::pi<float>() * ring / ringNum;
+        for (int segment = 0; segment <= segmentNum; segment++) {
+            float phi = glm::two_pi<float>() * segment / segmentNum;
+            MeshVertex vertex;
+            vertex.normal = glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            vertex.position = vertex.normal;
+            grid.push_back(vertex);
+        }
+    }
+
+    std::vector<MeshVertex> triangles;
+    int rowSize = segmentNum + 1;
+    for (int ring = 0; ring < ringNum; ring++) {
+        for (int segment = 0; segment < segmentNum; segment++) {
+            int v0 = ring * rowSize + segment;
+            int v1 = v0 + rowSize;
+            triangles.push_back(grid[v0]);
+            triangles.push_back(grid[v1]);
+            triangles.push_back(grid[v0 + 1]);
+            triangles.push_back(grid[v0 + 1]);
+            triangles.push_back(grid[v1]);
+            triangles.push_back(grid[v1 + 1]);
+        }
+    }
+    return triangles;
+}
+
+// Deterministic triangle shuffle, standing in for an exporter that pays no
+// attention to triangle order
+static void ShuffleTriangles(std::vector<uint32_t> &indices)
+{
+    uint32_t state = 12345;
+    size_t triangleNum = indices.size() / 3;
+    if (triangleNum == 0) {
+        return;
+    }
+    for (size_t i = triangleNum - 1; i > 0; i--) {
+        state = state * 1664525 + 1013904223;
+        size_t j = state % (i + 1);
+        for (size_t k = 0; k < 3; k++) {
+            std::swap(indices[i * 3 + k], indices[j * 3 + k]);
+        }
+    }
+}
+
+void RunMeshBenchmark(int segmentNum)
+{
+    std::vector<MeshVertex> triangles = CreateSphereTriangles(segmentNum);
+
+    BenchClock::time_point dedupStart = BenchClock::now();
+    MeshData mesh = DeduplicateVertices(triangles);
+    double dedupMs = ElapsedMs(dedupStart);
+    double gridAcmr = ComputeACMR(mesh.indices, mesh.vertices.size());
+
+    ShuffleTriangles(mesh.indices);
+    double shuffledAcmr = ComputeACMR(mesh.indices, mesh.vertices.size());
+
+    BenchClock::time_point optimizeStart = BenchClock::now();
+    OptimizeMesh(mesh);
+    double optimizeMs = ElapsedMs(optimizeStart);
+    double optimizedAcmr = ComputeACMR(mesh.indices, mesh.vertices.size());
+
+    std::cout << "Mesh benchmark (" << mesh.indices.size() / 3 << " triangles, " << triangles.size() << " -> "
+              << mesh.vertices.size() << " vertices after deduplication in " << dedupMs << " ms):" << std::endl;
+    std::cout << "  ACMR (cache size " << VERTEX_CACHE_SIZE << "): unindexed 3, grid order " << gridAcmr
+              << ", shuffled " << shuffledAcmr << ", optimized " << optimizedAcmr << std::endl;
+    std::cout << "  optimization: " << optimizeMs << " ms" << std::endl;
+}
+
+static void AppendFormat(std::string &text, const char *format, float a, float b, float c)
+{
+    char line[128];
+    int length = std::snprintf(line, sizeof(line), format, a, b, c);
+    text.append(line, length);
+}
+
+static void WriteBenchFile(const boost::filesystem::path &path, const std::string &content)
+{
+    std::ofstream file(path.string().c_str(), std::ios::binary);
+    file.write(content.data(), content.size());
+    if (!file) {
+        THROW(Error, "Failed to write benchmark mesh: " + path.string());
+    }
+}
+
+static void WriteObj(const boost::filesystem::path &path, const MeshData &mesh)
+{
+    std::string text;
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const MeshVertex &vertex = mesh.vertices[i];
+        AppendFormat(text, "v %.6f %.6f %.6f\n", vertex.position.x, vertex.position.y, vertex.position.z);
+        AppendFormat(text, "vn %.6f %.6f %.6f\n", vertex.normal.x, vertex.normal.y, vertex.normal.z);
+    }
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        char line[128];
+        int length = std::snprintf(line, sizeof(line), "f %u//%u %u//%u %u//%u\n",
+                                   mesh.indices[i] + 1, mesh.indices[i] + 1,
+                                   mesh.indices[i + 1] + 1, mesh.indices[i + 1] + 1,
+                                   mesh.indices[i + 2] + 1, mesh.indices[i + 2] + 1);
+        text.append(line, length);
+    }
+    WriteBenchFile(path, text);
+}
+
+static void WritePly(const boost::filesystem::path &path, const MeshData &mesh, bool binary)
+{
+    std::ostringstream header;
+    header << "ply\nformat " << (binary ? "binary_little_endian" : "ascii") << " 1.0\n"
+           << "element vertex " << mesh.vertices.size() << "\n"
+           << "property float x\nproperty float y\nproperty float z\n"
+           << "property float nx\nproperty float ny\nproperty float nz\n"
+           << "element face " << mesh.indices.size() / 3 << "\n"
+           << "property list uchar int vertex_indices\nend_header\n";
+    std::string text = header.str();
+
+    if (binary) {
+        // The vertex records are the in-memory layout on little endian hosts
+        text.append(reinterpret_cast<const char *>(mesh.vertices.data()), mesh.vertices.size() * sizeof(MeshVertex));
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            text.push_back(3);
+            text.append(reinterpret_cast<const char *>(&mesh.indices[i]), sizeof(uint32_t) * 3);
+        }
+    } else {
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            const MeshVertex &vertex = mesh.vertices[i];
+            AppendFormat(text, "%.6f %.6f %.6f ", vertex.position.x, vertex.position.y, vertex.position.z);
+            AppendFormat(text, "%.6f %.6f %.6f\n", vertex.normal.x, vertex.normal.y, vertex.normal.z);
+        }
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            char line[64];
+            int length = std::snprintf(line, sizeof(line), "3 %u %u %u\n", mesh.indices[i], mesh.indices[i + 1], mesh.indices[i + 2]);
+            text.append(line, length);
+        }
+    }
+    WriteBenchFile(path, text);
+}
+
+void RunMeshLoaderBenchmark(int segmentNum)
+{
+    MeshData mesh = DeduplicateVertices(CreateSphereTriangles(segmentNum));
+
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("mesh-bench-%%%%%%%%");
+    boost::filesystem::create_directories(directory);
+    std::vector<std::pair<const char *, boost::filesystem::path> > files;
+    files.push_back(std::make_pair("OBJ", directory / "sphere.obj"));
+    files.push_back(std::make_pair("PLY (ASCII)", directory / "sphere_ascii.ply"));
+    files.push_back(std::make_pair("PLY (binary)", directory / "sphere_binary.ply"));
+    WriteObj(files[0].second, mesh);
+    WritePly(files[1].second, mesh, false);
+    WritePly(files[2].second, mesh, true);
+
+    std::vector<unsigned> threadNums;
+    for (unsigned threadNum = 1; threadNum < HardwareThreadNum(); threadNum *= 2) {
+        threadNums.push_back(threadNum);
+    }
+    threadNums.push_back(HardwareThreadNum());
+
+    std::cout << "Mesh loader benchmark (" << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3 << " triangles):" << std::endl;
+    for (size_t i = 0; i < files.size(); i++) {
+        double megabytes = boost::filesystem::file_size(files[i].second) / (1024.0 * 1024.0);
+        std::cout << "  " << files[i].first << ", " << megabytes << " MB:" << std::endl;
+
+        // Untimed load to fill the page cache
+        LoadMesh(files[i].second.string());
+        for (size_t j = 0; j < threadNums.size(); j++) {
+            BenchClock::time_point start = BenchClock::now();
+            MeshData loaded = LoadMesh(files[i].second.string(), threadNums[j]);
+            double ms = ElapsedMs(start);
+
+            std::cout << "    " << threadNums[j] << " threads: " << ms << " ms, " << megabytes / (ms / 1000.0) << " MB/s";
+            if (loaded.vertices.size() != mesh.vertices.size() || loaded.indices.size() != mesh.indices.size()) {
+                std::cout << " (mismatch: " << loaded.vertices.size() << " vertices, " << loaded.indices.size() / 3 << " triangles)";
+            }
+            std::cout << std::endl;
+        }
+    }
+
+    boost::filesystem::remove_all(directory);
+}
+
+void RunCookedMeshBenchmark(int segmentNum)
+{
+    MeshData mesh = DeduplicateVertices(CreateSphereTriangles(segmentNum));
+    OptimizeMesh(mesh);
+
+    boost::filesystem::path directory = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("mesh-bench-%%%%%%%%");
+    boost::filesystem::create_directories(directory);
+    std::vector<std::pair<const char *, boost::filesystem::path> > files;
+    files.push_back(std::make_pair("OBJ", directory / "sphere.obj"));
+    files.push_back(std::make_pair("PLY (binary)", directory / "sphere.ply"));
+    files.push_back(std::make_pair("cooked", directory / "sphere.mesh"));
+    WriteObj(files[0].second, mesh);
+    WritePly(files[1].second, mesh, true);
+    CookMesh(mesh, files[2].second.string());
+
+    // File to GPU buffers, with the page cache warm from writing
+    std::cout << "Cooked mesh benchmark (" << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3
+              << " triangles, load and upload, p50 of " << MESH_LOAD_REPEAT_NUM << "):" << std::endl;
+    for (size_t i = 0; i < files.size(); i++) {
+        std::string path = files[i].second.string();
+        std::vector<double> samples;
+        for (int j = 0; j < MESH_LOAD_REPEAT_NUM; j++) {
+            BenchClock::time_point start = BenchClock::now();
+            std::unique_ptr<Mesh> gpuMesh;
+            if (i + 1 == files.size()) {
+                CookedMesh cookedMesh(path);
+                gpuMesh.reset(new Mesh(cookedMesh.Streams()));
+            } else {
+                gpuMesh.reset(new Mesh(LoadMesh(path)));
+            }
+            glFinish();
+            samples.push_back(ElapsedMs(start));
+        }
+
+        double megabytes = boost::filesystem::file_size(files[i].second) / (1024.0 * 1024.0);
+        double ms = TimingStats::FromSamples(samples).p50;
+        std::cout << "  " << files[i].first << ", " << megabytes << " MB: " << ms << " ms, "
+                  << megabytes / (ms / 1000.0) << " MB/s" << std::endl;
+    }
+
+    boost::filesystem::remove_all(directory);
+}
+
+static std::unique_ptr<GLSLProgram> CreateAdsProgram(const GLSLDefines &defines)
+{
+    std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+    program->SetDefines(defines);
+    program->CompileShader(ADS_VERT_PATH);
+    program->CompileShader(ADS_FRAG_PATH);
+    program->BindAttribLocation(0, "VertexPosition");
+    program->BindAttribLocation(1, "VertexNormal");
+    program->Link();
+    return program;
+}
+
+// Median frame time, each frame ending with glFinish()
+// p50 frame time; submitMs, if given, receives the p50 time spent in
+// Render() before waiting for the GPU
+static double MeasureFrameMs(Scene &scene, const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix, double *submitMs = nullptr)
+{
+    scene.Render(viewMatrix, projectionMatrix);
+    glFinish();
+
+    std::vector<double> frameTimes;
+    std::vector<double> submitTimes;
+    BenchClock::time_point runStart = BenchClock::now();
+    while (frameTimes.size() < INSTANCE_BENCH_MIN_FRAME_NUM || ElapsedMs(runStart) < INSTANCE_BENCH_MIN_TIME_MS) {
+        BenchClock::time_point frameStart = BenchClock::now();
+        scene.Render(viewMatrix, projectionMatrix);
+        submitTimes.push_back(ElapsedMs(frameStart));
+        glFinish();
+        frameTimes.push_back(ElapsedMs(frameStart));
+    }
+    if (submitMs) {
+        *submitMs = TimingStats::FromSamples(submitTimes).p50;
+    }
+    return TimingStats::FromSamples(frameTimes).p50;
+}
+
+void RunInstancingBenchmark(size_t maxInstanceNum, size_t maxPerObjectNum, uint32_t materialNum)
+{
+    std::unique_ptr<GLSLProgram> perObjectProgram = CreateAdsProgram(GLSLDefines());
+    std::unique_ptr<GLSLProgram> instancedProgram = CreateAdsProgram(GLSLDefines().Set("INSTANCED"));
+    Scene perObjectScene(*perObjectProgram);
+    Scene instancedScene(*instancedProgram);
+    std::vector<SceneMaterial> materials = CreateMaterialPalette(materialNum);
+
+    RenderTarget target(1024, 768);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)target.Width() / target.Height(), 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::cout << "Instancing benchmark (frames/second, p50 frame time):" << std::endl;
+    for (size_t instanceNum = 1; instanceNum <= maxInstanceNum; instanceNum *= 10) {
+        std::vector<SceneInstance> instances = CreateInstanceGrid(instanceNum, materialNum);
+
+        instancedScene.SetInstances(instances, materials);
+        double instancedMs = MeasureFrameMs(instancedScene, viewMatrix, projectionMatrix);
+        std::cout << "  " << instanceNum << " instances: instanced " << 1000.0 / instancedMs << " fps (" << instancedMs << " ms)";
+
+        if (instanceNum <= maxPerObjectNum) {
+            perObjectScene.SetInstances(instances, materials);
+            double perObjectMs = MeasureFrameMs(perObjectScene, viewMatrix, projectionMatrix);
+            std::cout << ", one draw per object " << 1000.0 / perObjectMs << " fps (" << perObjectMs << " ms)";
+        }
+        std::cout << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+// Spheres of increasing detail, standing in for different meshes
+static std::vector<MeshData> CreateBatchMeshes(uint32_t meshNum)
+{
+    std::vector<MeshData> meshes;
+    for (uint32_t i = 0; i < meshNum; i++) {
+        MeshData mesh = DeduplicateVertices(CreateSphereTriangles(MULTI_DRAW_BENCH_MIN_SEGMENT_NUM + 2 * i));
+        OptimizeMesh(mesh);
+        meshes.push_back(mesh);
+    }
+    return meshes;
+}
+
+void RunMultiDrawBenchmark(size_t maxObjectNum, uint32_t meshNum, uint32_t materialNum)
+{
+    if (!MeshBatch::IsSupported()) {
+        std::cout << "Multi-draw benchmark: ARB_shader_draw_parameters is not supported" << std::endl;
+        return;
+    }
+
+    std::unique_ptr<GLSLProgram> perObjectProgram = CreateAdsProgram(GLSLDefines());
+    std::unique_ptr<GLSLProgram> multiDrawProgram = CreateAdsProgram(GLSLDefines().Set("MULTI_DRAW"));
+    Scene perObjectScene(*perObjectProgram);
+    Scene multiDrawScene(*multiDrawProgram);
+    std::vector<MeshData> meshes = CreateBatchMeshes(meshNum);
+    std::vector<SceneMaterial> materials = CreateMaterialPalette(materialNum);
+
+    RenderTarget target(1024, 768);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)target.Width() / target.Height(), 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::cout << "Multi-draw benchmark (" << meshNum << " meshes; p50 CPU submit time / frame time):" << std::endl;
+    for (size_t objectNum = 1000; objectNum <= maxObjectNum; objectNum *= 10) {
+        std::vector<SceneInstance> instances = CreateInstanceGrid(objectNum, materialNum);
+        std::vector<SceneObject> objects(objectNum);
+        for (size_t i = 0; i < objectNum; i++) {
+            objects[i].meshIndex = i % meshNum;
+            objects[i].instance = instances[i];
+        }
+
+        multiDrawScene.SetObjects(std::unique_ptr<MeshBatch>(new MeshBatch(meshes, objectNum)), objects, materials);
+        double multiDrawSubmitMs = 0.0;
+        double multiDrawMs = MeasureFrameMs(multiDrawScene, viewMatrix, projectionMatrix, &multiDrawSubmitMs);
+
+        perObjectScene.SetObjects(std::unique_ptr<MeshBatch>(new MeshBatch(meshes, objectNum)), objects, materials);
+        double perObjectSubmitMs = 0.0;
+        double perObjectMs = MeasureFrameMs(perObjectScene, viewMatrix, projectionMatrix, &perObjectSubmitMs);
+
+        std::cout << "  " << objectNum << " objects: multi-draw indirect " << multiDrawSubmitMs << " / " << multiDrawMs
+                  << " ms, one draw per object " << perObjectSubmitMs << " / " << perObjectMs << " ms" << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void RunGpuCullingBenchmark(size_t maxObjectNum, uint32_t meshNum, uint32_t materialNum)
+{
+    if (!MeshBatch::IsSupported()) {
+        std::cout << "GPU culling benchmark: ARB_shader_draw_parameters is not supported" << std::endl;
+        return;
+    }
+
+    std::unique_ptr<GLSLProgram> multiDrawProgram = CreateAdsProgram(GLSLDefines().Set("MULTI_DRAW"));
+    std::unique_ptr<GLSLProgram> culledProgram = CreateAdsProgram(GLSLDefines().Set("GPU_CULLED"));
+    GLSLProgram cullProgram;
+    cullProgram.CompileShader(CULL_COMP_PATH);
+    cullProgram.Link();
+
+    Scene multiDrawScene(*multiDrawProgram);
+    Scene culledScene(*culledProgram);
+    culledScene.SetGpuCulling(&cullProgram);
+    std::vector<MeshData> meshes = CreateBatchMeshes(meshNum);
+    std::vector<SceneMaterial> materials = CreateMaterialPalette(materialNum);
+
+    // Looking sideways from the middle of the grid, so that most of it is
+    // out of view
+    RenderTarget target(1024, 768);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)target.Width() / target.Height(), 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 gridMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(CULL_BENCH_GRID_EXTENT));
+
+    std::cout << "GPU culling benchmark (" << meshNum << " meshes; p50 frame time):" << std::endl;
+    for (size_t objectNum = 1000; objectNum <= maxObjectNum; objectNum *= 10) {
+        std::vector<SceneInstance> instances = CreateInstanceGrid(objectNum, materialNum);
+        std::vector<SceneObject> objects(objectNum);
+        for (size_t i = 0; i < objectNum; i++) {
+            objects[i].meshIndex = i % meshNum;
+            objects[i].instance = instances[i];
+            objects[i].instance.modelMatrix = gridMatrix * instances[i].modelMatrix;
+        }
+
+        multiDrawScene.SetObjects(std::unique_ptr<MeshBatch>(new MeshBatch(meshes, objectNum)), objects, materials);
+        double multiDrawMs = MeasureFrameMs(multiDrawScene, viewMatrix, projectionMatrix);
+
+        culledScene.SetObjects(std::unique_ptr<MeshBatch>(new MeshBatch(meshes, objectNum)), objects, materials);
+        double culledMs = MeasureFrameMs(culledScene, viewMatrix, projectionMatrix);
+        size_t visibleNum = culledScene.Culler()->ReadVisibleNum();
+
+        std::cout << "  " << objectNum << " objects submitted, " << visibleNum << " visible: all drawn " << multiDrawMs
+                  << " ms, GPU culled " << culledMs << " ms" << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+// Scalar reference for CpuCuller: one box and one plane at a time
+static void CullBoxesScalar(const std::vector<MeshBounds> &boxes, const glm::mat4 &viewProjectionMatrix, std::vector<uint32_t> &visible)
+{
+    glm::vec4 planes[6];
+    ComputeFrustumPlanes(viewProjectionMatrix, planes);
+
+    visible.clear();
+    for (size_t i = 0; i < boxes.size(); i++) {
+        glm::vec3 center = (boxes[i].min + boxes[i].max) * 0.5f;
+        glm::vec3 extent = (boxes[i].max - boxes[i].min) * 0.5f;
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            glm::vec3 normal(planes[p]);
+            inside = glm::dot(normal, center) + planes[p].w + glm::dot(glm::abs(normal), extent) >= 0.0f;
+        }
+        if (inside) {
+            visible.push_back(static_cast<uint32_t>(i));
+        }
+    }
+}
+
+// Boxes of random size scattered through a cube around the origin
+static std::vector<MeshBounds> CreateRandomBoxes(size_t boxNum)
+{
+    uint32_t state = 12345;
+    std::vector<MeshBounds> boxes(boxNum);
+    for (size_t i = 0; i < boxNum; i++) {
+        float values[4];
+        for (int k = 0; k < 4; k++) {
+            state = state * 1664525 + 1013904223;
+            values[k] = (state >> 8) / 16777216.0f;
+        }
+        glm::vec3 center = (glm::vec3(values[0], values[1], values[2]) * 2.0f - 1.0f) * CULL_BENCH_GRID_EXTENT;
+        glm::vec3 extent(0.01f + 0.1f * values[3]);
+        boxes[i].min = center - extent;
+        boxes[i].max = center + extent;
+    }
+    return boxes;
+}
+
+void RunCpuCullingBenchmark(size_t maxBoxNum)
+{
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, 4.0f / 3.0f, 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 viewProjectionMatrix = projectionMatrix * viewMatrix;
+    unsigned threadNum = HardwareThreadNum();
+
+    std::cout << "CPU culling benchmark (p50 ms; scalar, SSE on 1 thread, SSE on " << threadNum << " threads):" << std::endl;
+    for (size_t boxNum = 10000; boxNum <= maxBoxNum; boxNum *= 10) {
+        std::vector<MeshBounds> boxes = CreateRandomBoxes(boxNum);
+        CpuCuller singleCuller(1);
+        singleCuller.SetBoxes(boxes);
+        CpuCuller threadedCuller(threadNum);
+        threadedCuller.SetBoxes(boxes);
+
+        std::vector<uint32_t> scalarVisible;
+        std::vector<double> scalarTimes, singleTimes, threadedTimes;
+        for (int i = 0; i < CPU_CULL_BENCH_REPEAT_NUM; i++) {
+            BenchClock::time_point start = BenchClock::now();
+            CullBoxesScalar(boxes, viewProjectionMatrix, scalarVisible);
+            scalarTimes.push_back(ElapsedMs(start));
+
+            start = BenchClock::now();
+            singleCuller.Cull(viewProjectionMatrix);
+            singleTimes.push_back(ElapsedMs(start));
+
+            start = BenchClock::now();
+            threadedCuller.Cull(viewProjectionMatrix);
+            threadedTimes.push_back(ElapsedMs(start));
+        }
+
+        if (singleCuller.Cull(viewProjectionMatrix) != scalarVisible || threadedCuller.Cull(viewProjectionMatrix) != scalarVisible) {
+            THROW(Error, "SIMD culling result differs from the scalar reference");
+        }
+
+        std::cout << "  " << boxNum << " boxes, " << scalarVisible.size() << " visible: " << TimingStats::FromSamples(scalarTimes).p50
+                  << " / " << TimingStats::FromSamples(singleTimes).p50 << " / " << TimingStats::FromSamples(threadedTimes).p50 << std::endl;
+    }
+}
+
+// Animated point grid regenerated every frame, written straight to dst
+static void WriteStreamVertices(MeshVertex *dst, size_t vertexNum, int frame)
+{
+    size_t side = static_cast<size_t>(std::sqrt(static_cast<double>(vertexNum))) + 1;
+    float phase = 0.1f * frame;
+    for (size_t i = 0; i < vertexNum; i++) {
+        float x = static_cast<float>(i % side) / side * 2.0f - 1.0f;
+        float y = static_cast<float>(i / side) / side * 2.0f - 1.0f;
+        dst[i].position = glm::vec3(x, y, 0.1f * std::sin(4.0f * x + phase));
+        dst[i].normal = glm::vec3(0.5f + 0.5f * x, 0.5f + 0.5f * y, 0.5f);
+    }
+}
+
+enum class StreamMethod
+{
+    SUB_DATA,
+    ORPHAN,
+    PERSISTENT,
+};
+
+// Milliseconds per frame over a pipelined run, without waiting for the GPU
+// between frames
+static double MeasureStreaming(StreamMethod method, size_t vertexNum, StreamBufferStats *stats)
+{
+    GLsizeiptr frameSize = static_cast<GLsizeiptr>(vertexNum * sizeof(MeshVertex));
+    std::vector<MeshVertex> staging(vertexNum);
+    std::unique_ptr<StreamBuffer> streamBuffer;
+    GLuint buffer = 0;
+    if (method == StreamMethod::PERSISTENT) {
+        streamBuffer.reset(new StreamBuffer(GL_ARRAY_BUFFER, frameSize));
+    } else {
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, frameSize, nullptr, GL_STREAM_DRAW);
+    }
+
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    for (size_t i = 0; i < sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(MESH_VERTEX_ATTRIBUTES[0]); i++) {
+        const MeshAttribute &attribute = MESH_VERTEX_ATTRIBUTES[i];
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribFormat(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.relativeOffset);
+        glVertexAttribBinding(attribute.location, attribute.binding);
+    }
+
+    glFinish();
+    BenchClock::time_point start = BenchClock::now();
+    for (int frame = 0; frame < STREAM_BENCH_FRAME_NUM; frame++) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (method == StreamMethod::PERSISTENT) {
+            streamBuffer->BeginFrame();
+            StreamAllocation allocation = streamBuffer->Allocate(frameSize);
+            WriteStreamVertices(static_cast<MeshVertex *>(allocation.data), vertexNum, frame);
+            glBindVertexBuffer(0, streamBuffer->Handle(), allocation.offset, sizeof(MeshVertex));
+        } else {
+            WriteStreamVertices(staging.data(), vertexNum, frame);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            if (method == StreamMethod::ORPHAN) {
+                // A fresh store, so the driver need not wait for the old one
+                glBufferData(GL_ARRAY_BUFFER, frameSize, nullptr, GL_STREAM_DRAW);
+            }
+            glBufferSubData(GL_ARRAY_BUFFER, 0, frameSize, staging.data());
+            glBindVertexBuffer(0, buffer, 0, sizeof(MeshVertex));
+        }
+        glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(vertexNum));
+        if (method == StreamMethod::PERSISTENT) {
+            streamBuffer->EndFrame();
+        }
+    }
+    glFinish();
+    double frameMs = ElapsedMs(start) / STREAM_BENCH_FRAME_NUM;
+
+    if (streamBuffer) {
+        *stats = streamBuffer->Stats();
+    }
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &buffer);
+    return frameMs;
+}
+
+void RunStreamingBenchmark(size_t maxFrameBytes)
+{
+    GLSLProgram program;
+    program.CompileShader(BASIC_VERT_PATH);
+    program.CompileShader(BASIC_FRAG_PATH);
+    program.BindAttribLocation(0, "VertexPosition");
+    program.BindAttribLocation(1, "VertexColor");
+    program.Link();
+    program.Use();
+    program.SetUniform("RotationMatrix", glm::mat4(1.0f));
+
+    RenderTarget target(1024, 768);
+    target.Bind();
+
+    static const char *METHOD_NAMES[] = { "glBufferSubData", "orphaning", "persistent mapping" };
+    static const StreamMethod METHODS[] = { StreamMethod::SUB_DATA, StreamMethod::ORPHAN, StreamMethod::PERSISTENT };
+
+    std::cout << "Streaming benchmark (" << STREAM_BENCH_FRAME_NUM << " frames of animated vertices, GB/s and ms/frame):" << std::endl;
+    for (size_t frameBytes = 1024 * 1024; frameBytes <= maxFrameBytes; frameBytes *= 4) {
+        size_t vertexNum = frameBytes / sizeof(MeshVertex);
+        std::cout << "  " << frameBytes / (1024 * 1024) << " MB/frame:";
+        for (size_t i = 0; i < sizeof(METHODS) / sizeof(METHODS[0]); i++) {
+            StreamBufferStats stats;
+            double frameMs = MeasureStreaming(METHODS[i], vertexNum, &stats);
+            double gbPerSecond = vertexNum * sizeof(MeshVertex) / (frameMs * 1.0e6);
+            std::cout << (i > 0 ? "," : "") << " " << METHOD_NAMES[i] << " " << gbPerSecond << " GB/s (" << frameMs << " ms)";
+            if (METHODS[i] == StreamMethod::PERSISTENT) {
+                std::cout << ", waited on " << stats.waits << " of " << stats.frames << " fences (" << stats.waitMs << " ms)";
+            }
+        }
+        std::cout << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void RunVertexFormatBenchmark(int segmentNum)
+{
+    MeshData mesh = DeduplicateVertices(CreateSphereTriangles(segmentNum));
+    OptimizeMesh(mesh);
+
+    RenderTarget target(1024, 768);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)target.Width() / target.Height(), 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::cout << "Vertex format benchmark (" << mesh.vertices.size() << " vertices, " << mesh.indices.size() / 3
+              << " triangles; p50 frame time):" << std::endl;
+    static const VertexFormat FORMATS[] = { VertexFormat::FLOAT, VertexFormat::HALF, VertexFormat::QUANTIZED };
+    for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); i++) {
+        BenchClock::time_point encodeStart = BenchClock::now();
+        PackedMesh packedMesh(mesh, FORMATS[i]);
+        double encodeMs = ElapsedMs(encodeStart);
+
+        GLSLDefines defines;
+        AddVertexFormatDefines(FORMATS[i], defines);
+        std::unique_ptr<GLSLProgram> program = CreateAdsProgram(defines);
+        Scene scene(*program, std::unique_ptr<Mesh>(new Mesh(packedMesh.Streams())));
+        scene.SetPositionTransform(packedMesh.Transform());
+        double frameMs = MeasureFrameMs(scene, viewMatrix, projectionMatrix);
+
+        std::cout << "  " << VertexFormatName(FORMATS[i]) << ": " << VertexFormatStride(FORMATS[i]) << " bytes/vertex, encoded in "
+                  << encodeMs << " ms, " << frameMs << " ms/frame" << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+static std::vector<PointLight> CreateRandomLights(size_t lightNum)
+{
+    float volume = 8.0f * LIGHT_BENCH_EXTENT * LIGHT_BENCH_EXTENT * LIGHT_BENCH_EXTENT;
+    float radius = std::cbrt(LIGHT_BENCH_LIGHTS_PER_POINT * volume / (4.0f / 3.0f * glm::pi<float>() * lightNum));
+    radius = std::min(radius, 2.0f * LIGHT_BENCH_EXTENT);
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-LIGHT_BENCH_EXTENT, LIGHT_BENCH_EXTENT);
+    std::uniform_real_distribution<float> color(0.0f, 2.0f / LIGHT_BENCH_LIGHTS_PER_POINT);
+    std::vector<PointLight> lights(lightNum);
+    for (size_t i = 0; i < lightNum; i++) {
+        lights[i].position = glm::vec3(position(random), position(random), position(random));
+        lights[i].radius = radius;
+        lights[i].color = glm::vec3(color(random), color(random), color(random));
+    }
+    return lights;
+}
+
+static std::unique_ptr<GLSLProgram> CreateClusteredProgram(const GLSLDefines &defines)
+{
+    std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+    program->SetDefines(defines);
+    program->CompileShader(CLUSTERED_VERT_PATH);
+    program->CompileShader(CLUSTERED_FRAG_PATH);
+    program->BindAttribLocation(0, "VertexPosition");
+    program->BindAttribLocation(1, "VertexNormal");
+    program->Link();
+    return program;
+}
+
+static std::vector<unsigned char> ReadTargetPixels(const RenderTarget &target)
+{
+    std::vector<unsigned char> pixels(static_cast<size_t>(target.Width()) * target.Height() * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.Handle());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.Width(), target.Height(), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
+}
+
+// Largest difference of a color channel between two images
+static int MaxPixelDifference(const std::vector<unsigned char> &a, const std::vector<unsigned char> &b)
+{
+    int maxDifference = 0;
+    for (size_t i = 0; i < a.size() && i < b.size(); i++) {
+        maxDifference = std::max(maxDifference, std::abs(static_cast<int>(a[i]) - static_cast<int>(b[i])));
+    }
+    return maxDifference;
+}
+
+void RunClusteredLightingBenchmark(size_t maxLightNum, int segmentNum)
+{
+    MeshData mesh = DeduplicateVertices(CreateSphereTriangles(segmentNum));
+    OptimizeMesh(mesh);
+
+    std::unique_ptr<GLSLProgram> clusteredProgram = CreateClusteredProgram(GLSLDefines());
+    std::unique_ptr<GLSLProgram> naiveProgram = CreateClusteredProgram(GLSLDefines().Set("NAIVE_LIGHTING"));
+    std::unique_ptr<GLSLProgram> clusterProgram(new GLSLProgram);
+    clusterProgram->CompileShader(CLUSTER_LIGHTS_COMP_PATH);
+    clusterProgram->Link();
+
+    Scene clusteredScene(*clusteredProgram, std::unique_ptr<Mesh>(new Mesh(mesh)));
+    Scene naiveScene(*naiveProgram, std::unique_ptr<Mesh>(new Mesh(mesh)));
+    ClusteredLighting clusteredLighting(clusterProgram.get(), maxLightNum);
+    ClusteredLighting naiveLighting(nullptr, maxLightNum);
+    clusteredScene.SetLighting(&clusteredLighting);
+    naiveScene.SetLighting(&naiveLighting);
+
+    RenderTarget target(1024, 768);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)target.Width() / target.Height(), 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::cout << "Clustered lighting benchmark (" << CLUSTER_X << "x" << CLUSTER_Y << "x" << CLUSTER_Z
+              << " clusters; p50 frame time):" << std::endl;
+    static const size_t LIGHT_NUMS[] = { 1, 64, 1000, 10000 };
+    for (size_t i = 0; i < sizeof(LIGHT_NUMS) / sizeof(LIGHT_NUMS[0]) && LIGHT_NUMS[i] <= maxLightNum; i++) {
+        size_t lightNum = LIGHT_NUMS[i];
+        std::vector<PointLight> lights = CreateRandomLights(lightNum);
+        clusteredLighting.SetLights(lights);
+        naiveLighting.SetLights(lights);
+
+        double clusteredMs = MeasureFrameMs(clusteredScene, viewMatrix, projectionMatrix);
+        ClusterLightStats stats = clusteredLighting.ReadStats();
+        std::vector<unsigned char> clusteredPixels = ReadTargetPixels(target);
+        double naiveMs = MeasureFrameMs(naiveScene, viewMatrix, projectionMatrix);
+        std::vector<unsigned char> naivePixels = ReadTargetPixels(target);
+
+        // Dropped lights make the clustered image darker than the naive one,
+        // and the speedup compare different work
+        double clusterLightNum = static_cast<double>(stats.assignedNum) / (CLUSTER_X * CLUSTER_Y * CLUSTER_Z);
+        std::cout << "  " << lightNum << " lights: clustered " << clusteredMs << " ms (" << clusterLightNum
+                  << " lights/cluster), naive " << naiveMs << " ms, " << naiveMs / clusteredMs << "x; max pixel difference "
+                  << MaxPixelDifference(clusteredPixels, naivePixels) << "/255";
+        if (stats.droppedNum > 0) {
+            std::cout << ", " << stats.droppedNum << " lights dropped from " << stats.fullClusterNum << " clusters past the end of the light index list";
+        }
+        std::cout << std::endl;
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+void RunUniformHoistingBenchmark(int segmentNum)
+{
+    MeshData mesh = DeduplicateVertices(CreateSphereTriangles(segmentNum));
+    OptimizeMesh(mesh);
+
+    // A small target keeps the frame bound by vertex work
+    RenderTarget target(256, 192);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)target.Width() / target.Height(), 0.01f, 100.0f);
+    glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    std::cout << "Uniform hoisting benchmark (" << mesh.vertices.size() << " vertices; p50 frame time):" << std::endl;
+    double frameMs[2];
+    std::vector<unsigned char> pixels[2];
+    for (int hoist = 0; hoist < 2; hoist++) {
+        std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+        program->SetUniformHoisting(hoist != 0);
+        program->CompileShader(ADS_VERT_PATH);
+        program->CompileShader(ADS_FRAG_PATH);
+        program->BindAttribLocation(0, "VertexPosition");
+        program->BindAttribLocation(1, "VertexNormal");
+        program->Link();
+
+        Scene scene(*program, std::unique_ptr<Mesh>(new Mesh(mesh)));
+        frameMs[hoist] = MeasureFrameMs(scene, viewMatrix, projectionMatrix);
+        pixels[hoist] = ReadTargetPixels(target);
+        std::cout << "  " << (hoist ? "hoisted" : "per vertex") << ": " << frameMs[hoist] << " ms/frame, "
+                  << mesh.vertices.size() / (frameMs[hoist] * 1000.0) << " Mvertices/s" << std::endl;
+        for (size_t i = 0; i < program->HoistedUniforms().size(); i++) {
+            std::cout << "    " << program->HoistedUniforms()[i].decl.name << std::endl;
+        }
+    }
+    // Hoisting only moves the math to the CPU, so the images should agree
+    // up to rounding
+    std::cout << "  speedup: " << frameMs[0] / frameMs[1] << "x; max pixel difference "
+              << MaxPixelDifference(pixels[0], pixels[1]) << "/255" << std::endl;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+static uint64_t SerialFib(int n)
+{
+    return n < 2 ? static_cast<uint64_t>(n) : SerialFib(n - 1) + SerialFib(n - 2);
+}
+
+// One job per call above the cutoff; the waiting job runs others meanwhile
+static uint64_t JobFib(JobSystem &jobs, int n)
+{
+    if (n < JOB_BENCH_FIB_CUTOFF) {
+        return SerialFib(n);
+    }
+    uint64_t a = 0;
+    JobCounter counter;
+    jobs.Submit([&jobs, &a, n]() { a = JobFib(jobs, n - 1); }, &counter);
+    uint64_t b = JobFib(jobs, n - 2);
+    jobs.Wait(counter);
+    return a + b;
+}
+
+// Fixed chunks, so that the sum does not depend on the thread count
+static double JobReduce(JobSystem &jobs, const std::vector<float> &values)
+{
+    size_t chunkNum = (values.size() + JOB_BENCH_REDUCE_CHUNK - 1) / JOB_BENCH_REDUCE_CHUNK;
+    std::vector<double> partials(chunkNum);
+    jobs.ParallelFor(0, chunkNum, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            size_t last = std::min(values.size(), (chunk + 1) * JOB_BENCH_REDUCE_CHUNK);
+            double sum = 0.0;
+            for (size_t i = chunk * JOB_BENCH_REDUCE_CHUNK; i < last; i++) {
+                sum += values[i];
+            }
+            partials[chunk] = sum;
+        }
+    });
+
+    double sum = 0.0;
+    for (size_t i = 0; i < chunkNum; i++) {
+        sum += partials[i];
+    }
+    return sum;
+}
+
+// All-pairs gravity with unit masses; returns the sum of final positions
+static glm::vec3 JobNBody(JobSystem &jobs, std::vector<glm::vec3> positions, std::vector<glm::vec3> velocities)
+{
+    const float dt = 0.001f;
+    const float softening = 0.01f;
+    size_t bodyNum = positions.size();
+    for (int step = 0; step < JOB_BENCH_NBODY_STEP_NUM; step++) {
+        jobs.ParallelFor(0, bodyNum, JOB_BENCH_NBODY_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                glm::vec3 acceleration(0.0f);
+                for (size_t j = 0; j < bodyNum; j++) {
+                    glm::vec3 d = positions[j] - positions[i];
+                    float distanceSquared = glm::dot(d, d) + softening;
+                    acceleration += d / (distanceSquared * std::sqrt(distanceSquared));
+                }
+                velocities[i] += acceleration * dt;
+            }
+        });
+        jobs.ParallelFor(0, bodyNum, JOB_BENCH_NBODY_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                positions[i] += velocities[i] * dt;
+            }
+        });
+    }
+
+    glm::vec3 sum(0.0f);
+    for (size_t i = 0; i < bodyNum; i++) {
+        sum += positions[i];
+    }
+    return sum;
+}
+
+template <typename Result, typename Run>
+static double MeasureJobMs(Run run, Result &result)
+{
+    std::vector<double> times;
+    for (int i = 0; i < JOB_BENCH_REPEAT_NUM; i++) {
+        BenchClock::time_point start = BenchClock::now();
+        result = run();
+        times.push_back(ElapsedMs(start));
+    }
+    return TimingStats::FromSamples(times).p50;
+}
+
+void RunJobSystemBenchmark(int fibN, size_t reduceNum, size_t bodyNum)
+{
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<float> values(reduceNum);
+    for (size_t i = 0; i < reduceNum; i++) {
+        values[i] = unit(random);
+    }
+    std::vector<glm::vec3> positions(bodyNum), velocities(bodyNum, glm::vec3(0.0f));
+    for (size_t i = 0; i < bodyNum; i++) {
+        positions[i] = glm::vec3(unit(random), unit(random), unit(random));
+    }
+
+    std::vector<unsigned> threadNums;
+    unsigned coreNum = HardwareThreadNum();
+    for (unsigned threadNum = 1; threadNum < coreNum; threadNum *= 2) {
+        threadNums.push_back(threadNum);
+    }
+    threadNums.push_back(coreNum);
+
+    std::cout << "Job system benchmark (p50 ms, speedup over 1 thread; fib(" << fibN << "), reduce of " << reduceNum
+              << " floats, " << bodyNum << " bodies x " << JOB_BENCH_NBODY_STEP_NUM << " steps):" << std::endl;
+    double baseMs[3] = {};
+    uint64_t baseFib = 0;
+    double baseSum = 0.0;
+    glm::vec3 baseBodies;
+    for (size_t i = 0; i < threadNums.size(); i++) {
+        JobSystem jobs(threadNums[i]);
+        uint64_t fib = 0;
+        double sum = 0.0;
+        glm::vec3 bodies;
+        double ms[3] = {
+            MeasureJobMs([&]() { return JobFib(jobs, fibN); }, fib),
+            MeasureJobMs([&]() { return JobReduce(jobs, values); }, sum),
+            MeasureJobMs([&]() { return JobNBody(jobs, positions, velocities); }, bodies),
+        };
+        if (i == 0) {
+            std::copy(ms, ms + 3, baseMs);
+            baseFib = fib;
+            baseSum = sum;
+            baseBodies = bodies;
+        } else if (fib != baseFib || sum != baseSum || bodies != baseBodies) {
+            THROW(Error, "Job system result differs from the single thread one");
+        }
+
+        std::cout << "  " << threadNums[i] << " threads: fib " << ms[0] << " (" << baseMs[0] / ms[0] << "x), reduce " << ms[1]
+                  << " (" << baseMs[1] / ms[1] << "x), nbody " << ms[2] << " (" << baseMs[2] / ms[2] << "x)" << std::endl;
+    }
+}
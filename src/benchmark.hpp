@@ -0,0 +1,91 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+struct GLFWwindow;
+
+// Startup benchmark: compiles and links a set of distinct ADS programs through
+// the program binary cache, first with an empty cache (cold), then again with
+// the binaries stored by the first pass (warm).
+// When running on Mesa, set MESA_SHADER_CACHE_DISABLE=true so that the
+// driver's own shader cache does not hide the cold compile cost.
+void RunStartupBenchmark(int programNum);
+
+// Compile benchmark: links a set of distinct programs one by one, then as a
+// single GLSLCompiler batch.
+void RunCompileBenchmark(GLFWwindow *window, int programNum);
+
+// Pipeline benchmark: builds every combination of ADS vertex and fragment
+// stage variants as separable programs and as monolithic programs, then
+// compares glBindProgramPipeline and glUseProgram switching between draws.
+void RunPipelineBenchmark(int stageVariantNum, int drawNum);
+
+// Shader sharing benchmark: links every combination of ADS vertex and
+// fragment stage variants with a shader object per program, then with shader
+// objects shared through a GLSLShaderCache.
+void RunShaderSharingBenchmark(int stageVariantNum);
+
+// Mesh benchmark: deduplicates an unindexed sphere, shuffles its triangles
+// and reports the vertex cache miss ratio (ACMR) before and after
+// optimization, with the time the optimization takes.
+void RunMeshBenchmark(int segmentNum);
+
+// Mesh loader benchmark: writes a sphere as OBJ, ASCII PLY and binary PLY
+// to a temporary directory and loads each with 1, 2, 4... threads up to one
+// per core, reporting load time and MB/s.
+void RunMeshLoaderBenchmark(int segmentNum);
+
+// Cooked mesh benchmark: writes a sphere as OBJ, binary PLY and a cooked
+// mesh, and times loading each into GPU buffers.
+void RunCookedMeshBenchmark(int segmentNum);
+
+// Instancing benchmark: renders a grid of 1, 10, 100... cubes up to
+// maxInstanceNum offscreen with one instanced draw call, and up to
+// maxPerObjectNum with one draw call per cube, reporting frames/second.
+void RunInstancingBenchmark(size_t maxInstanceNum, size_t maxPerObjectNum, uint32_t materialNum);
+
+// Multi-draw benchmark: renders 1000, 10000... objects up to maxObjectNum,
+// cycling through meshNum spheres of different detail packed in one
+// MeshBatch, with one multi-draw indirect call and with one draw call per
+// object, reporting CPU submit time and frame time.
+void RunMultiDrawBenchmark(size_t maxObjectNum, uint32_t meshNum, uint32_t materialNum);
+
+// GPU culling benchmark: renders 1000, 10000... objects up to maxObjectNum
+// from the middle of a grid, all of them with one multi-draw indirect call
+// and only those that pass frustum culling in cull.comp, reporting submitted
+// and visible objects and frame time.
+void RunGpuCullingBenchmark(size_t maxObjectNum, uint32_t meshNum, uint32_t materialNum);
+
+// CPU culling benchmark: culls 10000, 100000... random boxes up to maxBoxNum
+// with a scalar glm::vec3 loop and with CpuCuller on one thread and on one
+// thread per core, checking that the results match.
+void RunCpuCullingBenchmark(size_t maxBoxNum);
+
+// Streaming benchmark: regenerates 1 MB, 4 MB... up to maxFrameBytes of
+// vertices every frame and draws them, uploading with glBufferSubData, with
+// orphaning and through a persistently mapped StreamBuffer. Reports upload
+// GB/s, frame time and how often the stream buffer waited on a fence.
+void RunStreamingBenchmark(size_t maxFrameBytes);
+
+// Vertex format benchmark: packs a sphere in each VertexFormat and reports
+// bytes per vertex, encoding time and frame time.
+void RunVertexFormatBenchmark(int segmentNum);
+
+// Clustered lighting benchmark: shades a sphere with 1, 64, 1000 and 10000
+// random point lights, up to maxLightNum, binned into clusters and with a
+// loop over all lights per fragment.
+void RunClusteredLightingBenchmark(size_t maxLightNum, int segmentNum);
+
+// Uniform hoisting benchmark: draws a dense sphere with ads.vert as written
+// and with its uniform-only expressions hoisted, and reports vertex
+// throughput.
+void RunUniformHoistingBenchmark(int segmentNum);
+
+// Job system benchmark: runs recursive fib, a parallel reduce and an n-body
+// step over glm vectors on JobSystem with 1, 2, 4, ... threads up to the core
+// count, and reports times and speedup over one thread.
+void RunJobSystemBenchmark(int fibN, size_t reduceNum, size_t bodyNum);
+
+#endif
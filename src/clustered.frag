@@ -0,0 +1,69 @@
+#version 430
+
+// Per-fragment ADS shading with many point lights. Each fragment loops over
+// the lights of its cluster, or over all lights with NAIVE_LIGHTING.
+
+layout(location = 0) in vec3 Position;
+layout(location = 1) in vec3 Normal;
+
+out vec4 FragColor;
+
+struct LightInfo
+{
+    vec3 Position;
+    vec3 La;        // ambient intensity
+    vec3 Ld;        // diffuse intensity
+    vec3 Ls;        // specular intensity
+};
+// Only the ambient intensity is used
+layout(std140) uniform LightBlock
+{
+    LightInfo Light;
+};
+
+struct MaterialInfo
+{
+    vec3 Ka;        // ambient reflectivity
+    vec3 Kd;        // diffuse reflectivity
+    vec3 Ks;        // specular reflectivity
+    float Shine;    // "shininess" factor for specular reflection
+};
+layout(std140) uniform MaterialBlock
+{
+    MaterialInfo Material;
+};
+
+#include "clusters.glsl"
+
+vec3 ShadeLight(PointLight light, vec3 n, vec3 v)
+{
+    vec3 toLight = light.PositionRadius.xyz - Position;
+    float distance = length(toLight);
+    vec3 s = toLight / distance;
+    vec3 r = reflect(-s, n);
+    vec3 diffuseLight = Material.Kd * max(dot(s, n), 0.0);
+    vec3 specularLight = Material.Ks * pow(max(dot(r, v), 0.0), Material.Shine);
+    return (diffuseLight + specularLight) * light.Color.rgb * Attenuation(distance, light.PositionRadius.w);
+}
+
+void main()
+{
+    vec3 n = normalize(Normal);
+    vec3 v = normalize(-Position);
+    vec3 color = Material.Ka * Light.La;
+
+#ifdef NAIVE_LIGHTING
+    for (uint i = 0u; i < LightNum; i++) {
+        color += ShadeLight(Lights[i], n, v);
+    }
+#else
+    uint cluster = ClusterIndex(gl_FragCoord.xy, Position.z);
+    uint offset = ClusterLightOffsets[cluster];
+    uint lightNum = ClusterStoredLightNum(ClusterLightNums[cluster], offset);
+    for (uint i = 0u; i < lightNum; i++) {
+        color += ShadeLight(Lights[ClusterLights[offset + i]], n, v);
+    }
+#endif
+
+    FragColor = vec4(color, 1.0);
+}
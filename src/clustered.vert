@@ -0,0 +1,24 @@
+#version 430
+
+in vec3 VertexPosition;
+in vec3 VertexNormal;
+
+// View-space position and normal, shaded per fragment
+layout(location = 0) out vec3 Position;
+layout(location = 1) out vec3 Normal;
+
+// Needed to use the shader in a separable program
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+#include "matrices.glsl"
+
+void main()
+{
+    vec4 position = ModelViewMatrix * vec4(VertexPosition, 1.0);
+    Position = vec3(position);
+    Normal = NormalMatrix * VertexNormal;
+    gl_Position = ProjectionMatrix * position;
+}
@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "clustered_lighting.hpp"
+#include "error.hpp"
+
+static const size_t CLUSTER_NUM = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// Start of LightBuffer, in std430 layout
+struct LightBufferHeader
+{
+    glm::vec4 clusterScale;
+    uint32_t lightNum;
+    uint32_t lightIndexCapacity;
+    uint32_t padding[2];
+};
+
+// PointLight of clusters.glsl, in std430 layout
+struct GpuPointLight
+{
+    glm::vec4 positionRadius;
+    glm::vec4 color;
+};
+
+static GLuint CreateStorageBuffer(GLsizeiptr size)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+ClusteredLighting::ClusteredLighting(GLSLProgram *clusterProgram, size_t maxLightNum, size_t maxLightIndexNum) :
+    m_clusterProgram(clusterProgram),
+    m_maxLightNum(maxLightNum),
+    m_maxLightIndexNum(maxLightIndexNum),
+    m_lights(),
+    m_lightRing(GL_SHADER_STORAGE_BUFFER, sizeof(LightBufferHeader) + maxLightNum * sizeof(GpuPointLight)),
+    m_lightAllocation(),
+    m_clusterLightNumBuffer(0),
+    m_clusterLightBuffer(0),
+    m_clusterLightOffsetBuffer(0),
+    m_inverseProjectionUniform()
+{
+    if (m_clusterProgram) {
+        m_inverseProjectionUniform = m_clusterProgram->GetUniform<glm::mat4>("InverseProjectionMatrix");
+    }
+    m_clusterLightNumBuffer = CreateStorageBuffer(CLUSTER_NUM * sizeof(GLuint));
+    // The index list follows its allocation counter
+    m_clusterLightBuffer = CreateStorageBuffer((1 + maxLightIndexNum) * sizeof(GLuint));
+    m_clusterLightOffsetBuffer = CreateStorageBuffer(CLUSTER_NUM * sizeof(GLuint));
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+    glDeleteBuffers(1, &m_clusterLightOffsetBuffer);
+    glDeleteBuffers(1, &m_clusterLightBuffer);
+    glDeleteBuffers(1, &m_clusterLightNumBuffer);
+}
+
+void ClusteredLighting::SetLights(const std::vector<PointLight> &lights)
+{
+    if (lights.size() > m_maxLightNum) {
+        THROW(Error, "Too many lights: " + std::to_string(lights.size()) + ", at most " + std::to_string(m_maxLightNum));
+    }
+    m_lights = lights;
+}
+
+void ClusteredLighting::Update(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Clip planes of a perspective projection, from its depth row
+    float zNear = projectionMatrix[3][2] / (projectionMatrix[2][2] - 1.0f);
+    float zFar = projectionMatrix[3][2] / (projectionMatrix[2][2] + 1.0f);
+
+    m_lightRing.BeginFrame();
+    m_lightAllocation = m_lightRing.Allocate(sizeof(LightBufferHeader) + m_lights.size() * sizeof(GpuPointLight));
+
+    LightBufferHeader header;
+    header.clusterScale = glm::vec4(
+        static_cast<float>(CLUSTER_X) / viewport[2],
+        static_cast<float>(CLUSTER_Y) / viewport[3],
+        zNear,
+        CLUSTER_Z / std::log(zFar / zNear));
+    header.lightNum = static_cast<uint32_t>(m_lights.size());
+    header.lightIndexCapacity = static_cast<uint32_t>(m_maxLightIndexNum);
+    header.padding[0] = header.padding[1] = 0;
+    unsigned char *data = static_cast<unsigned char *>(m_lightAllocation.data);
+    std::memcpy(data, &header, sizeof(header));
+
+    GpuPointLight *gpuLights = reinterpret_cast<GpuPointLight *>(data + sizeof(header));
+    for (size_t i = 0; i < m_lights.size(); i++) {
+        glm::vec4 position = viewMatrix * glm::vec4(m_lights[i].position, 1.0f);
+        gpuLights[i].positionRadius = glm::vec4(glm::vec3(position), m_lights[i].radius);
+        gpuLights[i].color = glm::vec4(m_lights[i].color, 1.0f);
+    }
+
+    Bind();
+    if (m_clusterProgram) {
+        // Empty the index list
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterLightBuffer);
+        glClearBufferSubData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, 0, sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        m_clusterProgram->SetUniform(m_inverseProjectionUniform, glm::inverse(projectionMatrix));
+        m_clusterProgram->DispatchThreads(static_cast<GLuint>(CLUSTER_NUM));
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+}
+
+void ClusteredLighting::Bind() const
+{
+    m_lightRing.BindRange(LIGHT_BUFFER_BINDING, m_lightAllocation);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHT_NUM_BUFFER_BINDING, m_clusterLightNumBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHT_BUFFER_BINDING, m_clusterLightBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHT_OFFSET_BUFFER_BINDING, m_clusterLightOffsetBuffer);
+}
+
+void ClusteredLighting::EndFrame()
+{
+    m_lightRing.EndFrame();
+}
+
+ClusterLightStats ClusteredLighting::ReadStats() const
+{
+    std::vector<GLuint> counts(CLUSTER_NUM);
+    std::vector<GLuint> offsets(CLUSTER_NUM);
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterLightNumBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, counts.size() * sizeof(GLuint), counts.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_clusterLightOffsetBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, offsets.size() * sizeof(GLuint), offsets.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    // Same as ClusterStoredLightNum() of clusters.glsl
+    ClusterLightStats stats = {};
+    for (size_t i = 0; i < counts.size(); i++) {
+        size_t storedNum = offsets[i] < m_maxLightIndexNum ? std::min<size_t>(counts[i], m_maxLightIndexNum - offsets[i]) : 0;
+        stats.assignedNum += storedNum;
+        if (counts[i] > storedNum) {
+            stats.droppedNum += counts[i] - storedNum;
+            stats.fullClusterNum++;
+        }
+    }
+    return stats;
+}
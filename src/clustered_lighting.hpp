@@ -0,0 +1,93 @@
+#ifndef CLUSTERED_LIGHTING_HPP
+#define CLUSTERED_LIGHTING_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+#include "glsl_program.hpp"
+#include "stream_buffer.hpp"
+
+// Storage buffer bindings of clusters.glsl
+static const GLuint LIGHT_BUFFER_BINDING = 6;
+static const GLuint CLUSTER_LIGHT_NUM_BUFFER_BINDING = 7;
+static const GLuint CLUSTER_LIGHT_BUFFER_BINDING = 8;
+static const GLuint CLUSTER_LIGHT_OFFSET_BUFFER_BINDING = 9;
+
+// Cluster grid of clusters.glsl
+static const GLuint CLUSTER_X = 16;
+static const GLuint CLUSTER_Y = 9;
+static const GLuint CLUSTER_Z = 24;
+// Default size of the light index list shared by the clusters: 256 lights
+// per cluster on average, which crowded clusters can exceed
+static const size_t CLUSTER_LIGHT_INDEX_NUM = CLUSTER_X * CLUSTER_Y * CLUSTER_Z * 256;
+
+// World-space point light
+struct PointLight
+{
+    glm::vec3 position;
+    // Distance at which the light fades out completely
+    float radius;
+    glm::vec3 color;
+};
+
+// Light counts of the clusters after binning
+struct ClusterLightStats
+{
+    // Lights shaded, summed over the clusters
+    size_t assignedNum;
+    // Lights touching a cluster past the end of the index list, so not
+    // shaded there
+    size_t droppedNum;
+    // Clusters that lost some of their lights that way
+    size_t fullClusterNum;
+};
+
+// Many point lights for clustered.frag. Each frame the lights are moved to
+// view space into a storage buffer and, given a cluster_lights.comp
+// program, binned into the clusters of the view frustum on the GPU, so that
+// each fragment only shades the lights of its cluster. The clusters share
+// one list of up to maxLightIndexNum light indices, so a cluster can hold
+// any number of lights as long as the list has room. Without the program
+// only the light buffer is written, for the NAIVE_LIGHTING variant that
+// loops over all lights.
+class ClusteredLighting
+{
+public:
+    // The program, if any, must outlive the lighting
+    ClusteredLighting(GLSLProgram *clusterProgram, size_t maxLightNum, size_t maxLightIndexNum = CLUSTER_LIGHT_INDEX_NUM);
+    ~ClusteredLighting();
+
+    ClusteredLighting(const ClusteredLighting &) = delete;
+    ClusteredLighting & operator=(const ClusteredLighting &) = delete;
+
+    // Throws Error for more than the maximum number of lights
+    void SetLights(const std::vector<PointLight> &lights);
+    size_t LightNum() const { return m_lights.size(); }
+
+    // Write the lights for this frame and bin them. The clusters cover the
+    // current viewport; the projection must be a perspective one.
+    void Update(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix);
+    // Bind the buffers of the last Update() for drawing
+    void Bind() const;
+    // Finish the frame, after the draws that read the lights
+    void EndFrame();
+
+    // Light counts after the last Update(). Reads the counts back, waiting
+    // for the GPU, so it is meant for statistics only.
+    ClusterLightStats ReadStats() const;
+
+private:
+    GLSLProgram *m_clusterProgram;
+    size_t m_maxLightNum;
+    size_t m_maxLightIndexNum;
+    std::vector<PointLight> m_lights;
+    StreamBuffer m_lightRing;
+    StreamAllocation m_lightAllocation;
+    GLuint m_clusterLightNumBuffer;
+    GLuint m_clusterLightBuffer;
+    GLuint m_clusterLightOffsetBuffer;
+    GLSLUniform<glm::mat4> m_inverseProjectionUniform;
+};
+
+#endif
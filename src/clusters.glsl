@@ -0,0 +1,65 @@
+#pragma once
+
+// View-space light clusters: a CLUSTER_X by CLUSTER_Y grid of screen tiles,
+// each cut into CLUSTER_Z depth slices spaced exponentially from the near
+// to the far plane. Must match clustered_lighting.hpp.
+#define CLUSTER_X 16
+#define CLUSTER_Y 9
+#define CLUSTER_Z 24
+
+struct PointLight
+{
+    vec4 PositionRadius;    // view-space position, radius of influence
+    vec4 Color;             // diffuse and specular intensity
+};
+
+layout(std430, binding = 6) readonly buffer LightBuffer
+{
+    // CLUSTER_X / viewport width, CLUSTER_Y / viewport height, near plane
+    // distance, CLUSTER_Z / log(far / near)
+    vec4 ClusterScale;
+    uint LightNum;
+    // Size of ClusterLights
+    uint LightIndexCapacity;
+    PointLight Lights[];
+};
+
+// Lights of each cluster: ClusterLightNums[cluster] light indices starting
+// at ClusterLightOffsets[cluster] in the shared ClusterLights list, which is
+// allocated by bumping ClusterLightIndexNum. Indices past the capacity are
+// dropped from shading but kept in the counts so that they can be reported.
+layout(std430, binding = 7) buffer ClusterLightNumBuffer
+{
+    uint ClusterLightNums[];
+};
+layout(std430, binding = 8) buffer ClusterLightBuffer
+{
+    uint ClusterLightIndexNum;
+    uint ClusterLights[];
+};
+layout(std430, binding = 9) buffer ClusterLightOffsetBuffer
+{
+    uint ClusterLightOffsets[];
+};
+
+// Lights of the cluster that made it into ClusterLights
+uint ClusterStoredLightNum(uint lightNum, uint offset)
+{
+    return offset < LightIndexCapacity ? min(lightNum, LightIndexCapacity - offset) : 0u;
+}
+
+uint ClusterIndex(vec2 fragCoord, float viewZ)
+{
+    uvec2 tile = min(uvec2(fragCoord * ClusterScale.xy), uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    float slice = log(max(-viewZ / ClusterScale.z, 1.0)) * ClusterScale.w;
+    uint z = min(uint(slice), uint(CLUSTER_Z - 1));
+    return (z * CLUSTER_Y + tile.y) * CLUSTER_X + tile.x;
+}
+
+// Smooth falloff reaching zero at the radius, so that lights can be
+// skipped outside of it
+float Attenuation(float distance, float radius)
+{
+    float x = clamp(1.0 - (distance * distance) / (radius * radius), 0.0, 1.0);
+    return x * x;
+}
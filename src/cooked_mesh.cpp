@@ -0,0 +1,136 @@
+#include <cstring>
+#include <fstream>
+#include "cooked_mesh.hpp"
+#include "error.hpp"
+#include "trace.hpp"
+
+static_assert(sizeof(CookedMeshHeader) <= COOKED_MESH_ALIGNMENT * 2, "Cooked mesh header is too large");
+
+static uint64_t AlignOffset(uint64_t offset)
+{
+    return (offset + COOKED_MESH_ALIGNMENT - 1) / COOKED_MESH_ALIGNMENT * COOKED_MESH_ALIGNMENT;
+}
+
+static void WritePadding(std::ofstream &file, uint64_t offset)
+{
+    static const char ZEROS[COOKED_MESH_ALIGNMENT] = {};
+    uint64_t position = static_cast<uint64_t>(file.tellp());
+    file.write(ZEROS, static_cast<std::streamsize>(offset - position));
+}
+
+void CookMesh(const MeshData &mesh, const std::string &path)
+{
+    TraceZone zone("cook mesh", "mesh");
+    zone.SetDetail(path.c_str());
+
+    bool shortIndices = mesh.vertices.size() <= 0x10000;
+    size_t indexSize = shortIndices ? sizeof(uint16_t) : sizeof(uint32_t);
+    size_t attributeNum = sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(MESH_VERTEX_ATTRIBUTES[0]);
+    MeshBounds bounds = ComputeBounds(mesh);
+
+    CookedMeshHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = COOKED_MESH_MAGIC;
+    header.version = COOKED_MESH_VERSION;
+    header.vertexNum = static_cast<uint32_t>(mesh.vertices.size());
+    header.vertexStride = sizeof(MeshVertex);
+    header.indexNum = static_cast<uint32_t>(mesh.indices.size());
+    header.indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    header.attributeNum = static_cast<uint32_t>(attributeNum);
+    header.vertexOffset = AlignOffset(sizeof(header));
+    header.vertexSize = mesh.vertices.size() * sizeof(MeshVertex);
+    header.indexOffset = AlignOffset(header.vertexOffset + header.vertexSize);
+    header.indexSize = mesh.indices.size() * indexSize;
+    for (int i = 0; i < 3; i++) {
+        header.boundsMin[i] = bounds.min[i];
+        header.boundsMax[i] = bounds.max[i];
+    }
+    for (size_t i = 0; i < attributeNum; i++) {
+        const MeshAttribute &attribute = MESH_VERTEX_ATTRIBUTES[i];
+        CookedMeshAttribute &cooked = header.attributes[i];
+        cooked.location = attribute.location;
+        cooked.binding = attribute.binding;
+        cooked.components = attribute.components;
+        cooked.type = attribute.type;
+        cooked.normalized = attribute.normalized;
+        cooked.relativeOffset = attribute.relativeOffset;
+    }
+
+    std::ofstream file(path.c_str(), std::ios::binary);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    WritePadding(file, header.vertexOffset);
+    file.write(reinterpret_cast<const char *>(mesh.vertices.data()), static_cast<std::streamsize>(header.vertexSize));
+    WritePadding(file, header.indexOffset);
+    if (shortIndices) {
+        std::vector<uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+        file.write(reinterpret_cast<const char *>(indices.data()), static_cast<std::streamsize>(header.indexSize));
+    } else {
+        file.write(reinterpret_cast<const char *>(mesh.indices.data()), static_cast<std::streamsize>(header.indexSize));
+    }
+    if (!file) {
+        THROW(Error, "Failed to write cooked mesh: " + path);
+    }
+}
+
+CookedMesh::CookedMesh(const std::string &path) :
+    m_file(path),
+    m_header(reinterpret_cast<const CookedMeshHeader *>(m_file.Data())),
+    m_attributes()
+{
+    TraceZone zone("open cooked mesh", "mesh");
+    zone.SetDetail(path.c_str());
+
+    // Only the header is checked; the streams are uploaded untouched
+    uint64_t fileSize = m_file.Size();
+    if (fileSize < sizeof(CookedMeshHeader)) {
+        THROW(Error, "Invalid cooked mesh file: " + path);
+    }
+    const CookedMeshHeader &header = *m_header;
+    size_t indexSize = header.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+    bool valid = header.magic == COOKED_MESH_MAGIC
+        && header.version == COOKED_MESH_VERSION
+        && (header.indexType == GL_UNSIGNED_SHORT || header.indexType == GL_UNSIGNED_INT)
+        && header.attributeNum <= COOKED_MESH_MAX_ATTRIBUTES
+        && header.vertexStride > 0
+        && header.vertexSize == static_cast<uint64_t>(header.vertexNum) * header.vertexStride
+        && header.indexSize == static_cast<uint64_t>(header.indexNum) * indexSize
+        && header.vertexOffset <= fileSize && header.vertexSize <= fileSize - header.vertexOffset
+        && header.indexOffset <= fileSize && header.indexSize <= fileSize - header.indexOffset;
+    if (!valid) {
+        THROW(Error, "Invalid cooked mesh file: " + path);
+    }
+
+    for (uint32_t i = 0; i < header.attributeNum; i++) {
+        const CookedMeshAttribute &cooked = header.attributes[i];
+        MeshAttribute attribute;
+        attribute.location = cooked.location;
+        attribute.binding = cooked.binding;
+        attribute.components = static_cast<GLint>(cooked.components);
+        attribute.type = cooked.type;
+        attribute.normalized = cooked.normalized ? GL_TRUE : GL_FALSE;
+        attribute.relativeOffset = cooked.relativeOffset;
+        m_attributes.push_back(attribute);
+    }
+}
+
+MeshStreams CookedMesh::Streams() const
+{
+    MeshStreams streams;
+    streams.vertexData = m_file.Data() + m_header->vertexOffset;
+    streams.vertexDataSize = static_cast<size_t>(m_header->vertexSize);
+    streams.vertexStride = static_cast<GLsizei>(m_header->vertexStride);
+    streams.attributes = m_attributes.data();
+    streams.attributeNum = m_attributes.size();
+    streams.indexData = m_file.Data() + m_header->indexOffset;
+    streams.indexNum = static_cast<GLsizei>(m_header->indexNum);
+    streams.indexType = m_header->indexType;
+    return streams;
+}
+
+MeshBounds CookedMesh::Bounds() const
+{
+    MeshBounds bounds;
+    bounds.min = glm::vec3(m_header->boundsMin[0], m_header->boundsMin[1], m_header->boundsMin[2]);
+    bounds.max = glm::vec3(m_header->boundsMax[0], m_header->boundsMax[1], m_header->boundsMax[2]);
+    return bounds;
+}
@@ -0,0 +1,77 @@
+#ifndef COOKED_MESH_HPP
+#define COOKED_MESH_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+
+// Cooked mesh file: a header followed by the vertex and index streams in
+// their GPU layout, so that loading is a mapping and an upload with no
+// per-vertex work. Streams start on COOKED_MESH_ALIGNMENT byte boundaries.
+// Values are stored little endian.
+
+static const uint32_t COOKED_MESH_MAGIC = 0x4853454D;   // "MESH"
+static const uint32_t COOKED_MESH_VERSION = 1;
+static const size_t COOKED_MESH_ALIGNMENT = 256;
+static const size_t COOKED_MESH_MAX_ATTRIBUTES = 8;
+
+// MeshAttribute with fixed-size fields
+struct CookedMeshAttribute
+{
+    uint32_t location;
+    uint32_t binding;
+    uint32_t components;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t relativeOffset;
+};
+
+struct CookedMeshHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexNum;
+    uint32_t vertexStride;
+    uint32_t indexNum;
+    uint32_t indexType;
+    uint32_t attributeNum;
+    uint32_t reserved;
+    // Stream positions in bytes from the start of the file
+    uint64_t vertexOffset;
+    uint64_t vertexSize;
+    uint64_t indexOffset;
+    uint64_t indexSize;
+    float boundsMin[3];
+    float boundsMax[3];
+    CookedMeshAttribute attributes[COOKED_MESH_MAX_ATTRIBUTES];
+};
+
+// Write a mesh as a cooked mesh file, with 16-bit indices when the vertices
+// allow it. Throws Error if the file cannot be written.
+void CookMesh(const MeshData &mesh, const std::string &path);
+
+// Memory-mapped cooked mesh file, checked on open. Throws Error for files
+// that are not valid cooked meshes.
+class CookedMesh
+{
+public:
+    explicit CookedMesh(const std::string &path);
+
+    CookedMesh(const CookedMesh &) = delete;
+    CookedMesh & operator=(const CookedMesh &) = delete;
+
+    // Streams pointing into the mapping, valid while the file is open
+    MeshStreams Streams() const;
+    MeshBounds Bounds() const;
+    size_t VertexNum() const { return m_header->vertexNum; }
+    size_t IndexNum() const { return m_header->indexNum; }
+
+private:
+    MappedFile m_file;
+    const CookedMeshHeader *m_header;
+    std::vector<MeshAttribute> m_attributes;
+};
+
+#endif
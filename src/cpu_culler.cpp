@@ -0,0 +1,135 @@
+#include <glm/gtx/simd_mat4.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <xmmintrin.h>
+#include <algorithm>
+#include "cpu_culler.hpp"
+#include "parallel.hpp"
+
+static const int FRUSTUM_PLANE_NUM = 6;
+// Boxes per task; a multiple of 4
+static const size_t CULL_CHUNK_BOX_NUM = 16384;
+
+// Plane components, each repeated in the four lanes
+struct SimdPlane
+{
+    glm::simdVec4 x;
+    glm::simdVec4 y;
+    glm::simdVec4 z;
+    glm::simdVec4 w;
+    glm::simdVec4 absX;
+    glm::simdVec4 absY;
+    glm::simdVec4 absZ;
+};
+
+void ComputeFrustumPlanes(const glm::mat4 &viewProjectionMatrix, glm::vec4 planes[6])
+{
+    // Gribb-Hartmann: the planes are sums and differences of the rows
+    glm::simdMat4 rows = glm::transpose(glm::simdMat4(viewProjectionMatrix));
+    for (int i = 0; i < 3; i++) {
+        planes[i * 2] = glm::vec4_cast(rows[3] + rows[i]);
+        planes[i * 2 + 1] = glm::vec4_cast(rows[3] - rows[i]);
+    }
+}
+
+static void CullChunk(const SimdPlane *planes, const float *centerX, const float *centerY, const float *centerZ,
+                      const float *extentX, const float *extentY, const float *extentZ,
+                      uint32_t first, uint32_t boxNum, std::vector<uint32_t> &visible)
+{
+    visible.clear();
+    const glm::simdVec4 zero(0.0f);
+    for (uint32_t i = 0; i < boxNum; i += 4) {
+        glm::simdVec4 cx(_mm_loadu_ps(centerX + i));
+        glm::simdVec4 cy(_mm_loadu_ps(centerY + i));
+        glm::simdVec4 cz(_mm_loadu_ps(centerZ + i));
+        glm::simdVec4 ex(_mm_loadu_ps(extentX + i));
+        glm::simdVec4 ey(_mm_loadu_ps(extentY + i));
+        glm::simdVec4 ez(_mm_loadu_ps(extentZ + i));
+
+        // A box is out when even its corner furthest along the normal is
+        // behind a plane
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < FRUSTUM_PLANE_NUM; p++) {
+            const SimdPlane &plane = planes[p];
+            glm::simdVec4 distance = (plane.x * cx + plane.y * cy + plane.z * cz + plane.w)
+                                   + (plane.absX * ex + plane.absY * ey + plane.absZ * ez);
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(distance.Data, zero.Data));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        if (outsideMask == 0xF) {
+            continue;
+        }
+        for (uint32_t lane = 0; lane < 4 && i + lane < boxNum; lane++) {
+            if (!(outsideMask & (1 << lane))) {
+                visible.push_back(first + i + lane);
+            }
+        }
+    }
+}
+
+CpuCuller::CpuCuller(unsigned threadNum) :
+    m_threadNum(threadNum),
+    m_boxNum(0),
+    m_centerX(),
+    m_centerY(),
+    m_centerZ(),
+    m_extentX(),
+    m_extentY(),
+    m_extentZ(),
+    m_chunkVisible(),
+    m_visible()
+{
+}
+
+void CpuCuller::SetBoxes(const std::vector<MeshBounds> &boxes)
+{
+    m_boxNum = boxes.size();
+    size_t paddedNum = (m_boxNum + 3) / 4 * 4;
+    m_centerX.assign(paddedNum, 0.0f);
+    m_centerY.assign(paddedNum, 0.0f);
+    m_centerZ.assign(paddedNum, 0.0f);
+    m_extentX.assign(paddedNum, 0.0f);
+    m_extentY.assign(paddedNum, 0.0f);
+    m_extentZ.assign(paddedNum, 0.0f);
+    for (size_t i = 0; i < m_boxNum; i++) {
+        glm::vec3 center = (boxes[i].min + boxes[i].max) * 0.5f;
+        glm::vec3 extent = (boxes[i].max - boxes[i].min) * 0.5f;
+        m_centerX[i] = center.x;
+        m_centerY[i] = center.y;
+        m_centerZ[i] = center.z;
+        m_extentX[i] = extent.x;
+        m_extentY[i] = extent.y;
+        m_extentZ[i] = extent.z;
+    }
+    m_chunkVisible.resize((m_boxNum + CULL_CHUNK_BOX_NUM - 1) / CULL_CHUNK_BOX_NUM);
+}
+
+const std::vector<uint32_t> & CpuCuller::Cull(const glm::mat4 &viewProjectionMatrix)
+{
+    glm::vec4 planes[FRUSTUM_PLANE_NUM];
+    ComputeFrustumPlanes(viewProjectionMatrix, planes);
+    SimdPlane simdPlanes[FRUSTUM_PLANE_NUM];
+    for (int i = 0; i < FRUSTUM_PLANE_NUM; i++) {
+        simdPlanes[i].x = glm::simdVec4(planes[i].x);
+        simdPlanes[i].y = glm::simdVec4(planes[i].y);
+        simdPlanes[i].z = glm::simdVec4(planes[i].z);
+        simdPlanes[i].w = glm::simdVec4(planes[i].w);
+        simdPlanes[i].absX = glm::simdVec4(glm::abs(planes[i].x));
+        simdPlanes[i].absY = glm::simdVec4(glm::abs(planes[i].y));
+        simdPlanes[i].absZ = glm::simdVec4(glm::abs(planes[i].z));
+    }
+
+    ParallelFor(m_chunkVisible.size(), m_threadNum, [&](size_t chunk) {
+        size_t first = chunk * CULL_CHUNK_BOX_NUM;
+        size_t boxNum = std::min(CULL_CHUNK_BOX_NUM, m_boxNum - first);
+        CullChunk(simdPlanes, &m_centerX[first], &m_centerY[first], &m_centerZ[first],
+                  &m_extentX[first], &m_extentY[first], &m_extentZ[first],
+                  static_cast<uint32_t>(first), static_cast<uint32_t>(boxNum), m_chunkVisible[chunk]);
+    });
+
+    m_visible.clear();
+    for (size_t i = 0; i < m_chunkVisible.size(); i++) {
+        m_visible.insert(m_visible.end(), m_chunkVisible[i].begin(), m_chunkVisible[i].end());
+    }
+    return m_visible;
+}
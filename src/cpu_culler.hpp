@@ -0,0 +1,46 @@
+#ifndef CPU_CULLER_HPP
+#define CPU_CULLER_HPP
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh.hpp"
+
+// Frustum planes of a view-projection matrix (left, right, bottom, top,
+// near, far), pointing inside and not normalized: a point p is inside
+// plane i when dot(planes[i], vec4(p, 1)) >= 0
+void ComputeFrustumPlanes(const glm::mat4 &viewProjectionMatrix, glm::vec4 planes[6]);
+
+// Frustum culling of world-space axis-aligned boxes on the CPU, for when
+// culling cannot run on the GPU. Boxes are stored as structure-of-arrays
+// centers and half extents and tested four at a time against the six
+// planes with glm's SSE types. The box range is split into chunks culled on
+// up to threadNum threads (0: one per core).
+class CpuCuller
+{
+public:
+    explicit CpuCuller(unsigned threadNum = 0);
+
+    void SetBoxes(const std::vector<MeshBounds> &boxes);
+    size_t BoxNum() const { return m_boxNum; }
+
+    // Indices of the boxes inside or crossing the frustum, in increasing
+    // order. Valid until the next call.
+    const std::vector<uint32_t> & Cull(const glm::mat4 &viewProjectionMatrix);
+
+private:
+    unsigned m_threadNum;
+    size_t m_boxNum;
+    // Padded to a multiple of 4
+    std::vector<float> m_centerX;
+    std::vector<float> m_centerY;
+    std::vector<float> m_centerZ;
+    std::vector<float> m_extentX;
+    std::vector<float> m_extentY;
+    std::vector<float> m_extentZ;
+    std::vector<std::vector<uint32_t>> m_chunkVisible;
+    std::vector<uint32_t> m_visible;
+};
+
+#endif
@@ -1,8 +1 @@
-in vec3 LightIntensity;
-
-out vec4 FragColor;
-
-void main()
-{
-    FragColor = vec4(LightIntensity, 1.0);
-}
\ No newline at end of file
+#include "ads.frag"
\ No newline at end of file
@@ -3,11 +3,15 @@
 in vec3 VertexPosition;
 in vec3 VertexNormal;
 
-out vec3 LightIntensity;
+layout(location = 0) out vec3 LightIntensity;
 
-uniform mat4 ModelViewMatrix;
-uniform mat4 ProjectionMatrix;
-uniform mat3 NormalMatrix;
+// Needed to use the shader in a separable program
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+#include "matrices.glsl"
 
 uniform vec3 LightPosition;
 uniform vec3 Kd;
@@ -3,4 +3,11 @@
 
 #include "error.hpp"
 
+// Failure to create or map an OpenGL object outside of GLSL programs
+class GLError : public Error
+{
+public:
+    GLError(const std::string &file, unsigned long line, const std::string &msg) : Error(file, line, msg) {}
+};
+
 #endif
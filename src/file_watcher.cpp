@@ -0,0 +1,104 @@
+#include <algorithm>
+#include "file_watcher.hpp"
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+static std::time_t GetLastWriteTime(const boost::filesystem::path &path)
+{
+    boost::system::error_code ec;
+    std::time_t time = boost::filesystem::last_write_time(path, ec);
+    return ec ? 0 : time;
+}
+
+static void AddUnique(std::vector<std::string> &files, const std::string &file)
+{
+    if (std::find(files.begin(), files.end(), file) == files.end()) {
+        files.push_back(file);
+    }
+}
+
+FileWatcher::FileWatcher() :
+    m_files()
+#ifdef __linux__
+    , m_inotify(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+    , m_directories()
+#endif
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        close(m_inotify);
+    }
+#endif
+}
+
+void FileWatcher::Watch(const std::string &file)
+{
+    boost::system::error_code ec;
+    boost::filesystem::path path = boost::filesystem::canonical(file, ec);
+    if (ec) {
+        path = boost::filesystem::absolute(file);
+    }
+
+    WatchedFile watched;
+    watched.file = file;
+    watched.directory = path.parent_path();
+    watched.fileName = path.filename().string();
+    watched.lastWriteTime = GetLastWriteTime(path);
+    m_files.push_back(watched);
+
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        int wd = inotify_add_watch(m_inotify, watched.directory.string().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd >= 0) {
+            m_directories[wd] = watched.directory;
+        }
+    }
+#endif
+}
+
+void FileWatcher::Poll(std::vector<std::string> &changed)
+{
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        alignas(struct inotify_event) char buffer[4096];
+        for (;;) {
+            ssize_t len = read(m_inotify, buffer, sizeof(buffer));
+            if (len <= 0) {
+                break;
+            }
+
+            for (char *ptr = buffer; ptr < buffer + len; ) {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(ptr);
+                ptr += sizeof(struct inotify_event) + event->len;
+
+                std::map<int, boost::filesystem::path>::iterator dir = m_directories.find(event->wd);
+                if (dir == m_directories.end() || event->len == 0) {
+                    continue;
+                }
+                for (size_t i = 0; i < m_files.size(); i++) {
+                    if (m_files[i].directory == dir->second && m_files[i].fileName == event->name) {
+                        AddUnique(changed, m_files[i].file);
+                    }
+                }
+            }
+        }
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < m_files.size(); i++) {
+        std::time_t time = GetLastWriteTime(m_files[i].directory / m_files[i].fileName);
+        if (time != 0 && time != m_files[i].lastWriteTime) {
+            m_files[i].lastWriteTime = time;
+            AddUnique(changed, m_files[i].file);
+        }
+    }
+}
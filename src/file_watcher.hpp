@@ -0,0 +1,44 @@
+#ifndef FILE_WATCHER_HPP
+#define FILE_WATCHER_HPP
+
+#include <boost/filesystem.hpp>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports modified files without blocking. Uses inotify on Linux (watching
+// the parent directories, so that editors which save by renaming a temporary
+// file are detected too) and falls back to polling modification times
+// elsewhere.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher & operator=(const FileWatcher &) = delete;
+
+    void Watch(const std::string &file);
+
+    // Append files changed since the last call, each reported once
+    void Poll(std::vector<std::string> &changed);
+
+private:
+    struct WatchedFile
+    {
+        std::string file;
+        boost::filesystem::path directory;
+        std::string fileName;
+        std::time_t lastWriteTime;
+    };
+
+    std::vector<WatchedFile> m_files;
+#ifdef __linux__
+    int m_inotify;
+    std::map<int, boost::filesystem::path> m_directories;
+#endif
+};
+
+#endif
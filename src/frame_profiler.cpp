@@ -0,0 +1,123 @@
+#include "frame_profiler.hpp"
+#include "json_writer.hpp"
+
+FrameProfiler::FrameProfiler(unsigned frameLatency, size_t historySize) :
+    m_frames(frameLatency),
+    m_frame(frameLatency - 1),
+    m_openPasses(),
+    m_cpuTimes(historySize),
+    m_gpuTimes(historySize),
+    m_droppedFrames(0)
+{
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        m_frames[i].usedNum = 0;
+        m_frames[i].lastQuery = 0;
+        m_frames[i].pending = false;
+    }
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        std::vector<PassQueries> &passes = m_frames[i].passes;
+        for (size_t j = 0; j < passes.size(); j++) {
+            glDeleteQueries(1, &passes[j].beginQuery);
+            glDeleteQueries(1, &passes[j].endQuery);
+        }
+    }
+}
+
+void FrameProfiler::BeginFrame()
+{
+    m_frame = (m_frame + 1) % m_frames.size();
+    FrameQueries &frame = m_frames[m_frame];
+    if (frame.pending) {
+        _Collect(frame, false);
+    }
+    frame.usedNum = 0;
+    frame.pending = false;
+}
+
+void FrameProfiler::EndFrame()
+{
+    FrameQueries &frame = m_frames[m_frame];
+    frame.pending = (frame.usedNum > 0);
+}
+
+void FrameProfiler::BeginPass(const char *name)
+{
+    FrameQueries &frame = m_frames[m_frame];
+    if (frame.usedNum == frame.passes.size()) {
+        PassQueries queries;
+        glGenQueries(1, &queries.beginQuery);
+        glGenQueries(1, &queries.endQuery);
+        frame.passes.push_back(queries);
+    }
+
+    PassQueries &queries = frame.passes[frame.usedNum];
+    queries.name = name;
+    glQueryCounter(queries.beginQuery, GL_TIMESTAMP);
+
+    OpenPass pass;
+    pass.name = name;
+    pass.cpuStart = Clock::now();
+    pass.queries = frame.usedNum;
+    m_openPasses.push_back(pass);
+    frame.usedNum++;
+}
+
+void FrameProfiler::EndPass()
+{
+    OpenPass pass = m_openPasses.back();
+    m_openPasses.pop_back();
+
+    FrameQueries &frame = m_frames[m_frame];
+    GLuint endQuery = frame.passes[pass.queries].endQuery;
+    glQueryCounter(endQuery, GL_TIMESTAMP);
+    frame.lastQuery = endQuery;
+
+    m_cpuTimes.Add(pass.name, std::chrono::duration<double, std::milli>(Clock::now() - pass.cpuStart).count());
+}
+
+void FrameProfiler::Flush()
+{
+    for (size_t i = 0; i < m_frames.size(); i++) {
+        if (m_frames[i].pending) {
+            _Collect(m_frames[i], true);
+            m_frames[i].pending = false;
+        }
+    }
+}
+
+void FrameProfiler::_Collect(FrameQueries &frame, bool wait)
+{
+    // Queries complete in order, so the last one tells about all of them
+    if (!wait) {
+        GLuint available = GL_FALSE;
+        glGetQueryObjectuiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            m_droppedFrames++;
+            return;
+        }
+    }
+
+    for (size_t i = 0; i < frame.usedNum; i++) {
+        GLuint64 begin;
+        GLuint64 end;
+        glGetQueryObjectui64v(frame.passes[i].beginQuery, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.passes[i].endQuery, GL_QUERY_RESULT, &end);
+        m_gpuTimes.Add(frame.passes[i].name, (end - begin) / 1000000.0);
+    }
+}
+
+void FrameProfiler::WriteJson(JsonWriter &json) const
+{
+    json.BeginObject();
+    json.Key("cpu_ms");
+    m_cpuTimes.WriteJson(json);
+    json.Key("gpu_ms");
+    m_gpuTimes.WriteJson(json);
+    json.Key("dropped_gpu_frames");
+    json.Value(static_cast<unsigned long long>(m_droppedFrames));
+    json.EndObject();
+}
@@ -0,0 +1,104 @@
+#ifndef FRAME_PROFILER_HPP
+#define FRAME_PROFILER_HPP
+
+#include <GL/glew.h>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include "timing_stats.hpp"
+
+class JsonWriter;
+
+// CPU and GPU time of named passes within a frame. GPU time comes from a
+// pair of GL_TIMESTAMP queries per pass (unlike GL_TIME_ELAPSED queries,
+// they can nest). The queries of a frame are read back frameLatency frames
+// later, when the GPU is normally done with them, so measuring never
+// stalls the pipeline. Results that are still not available by then are
+// dropped and counted.
+class FrameProfiler
+{
+public:
+    explicit FrameProfiler(unsigned frameLatency = 4, size_t historySize = 256);
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler &) = delete;
+    FrameProfiler & operator=(const FrameProfiler &) = delete;
+
+    void BeginFrame();
+    void EndFrame();
+
+    // Pass names are kept by pointer and must be string literals
+    void BeginPass(const char *name);
+    void EndPass();
+
+    // Read back every outstanding result, waiting for the GPU if needed
+    void Flush();
+
+    const TimingHistory & CpuTimes() const { return m_cpuTimes; }
+    const TimingHistory & GpuTimes() const { return m_gpuTimes; }
+    unsigned long DroppedFrames() const { return m_droppedFrames; }
+
+    void WriteJson(JsonWriter &json) const;
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct PassQueries
+    {
+        const char *name;
+        GLuint beginQuery;
+        GLuint endQuery;
+    };
+
+    // Query objects are kept and reused by the frame slot that created them
+    struct FrameQueries
+    {
+        std::vector<PassQueries> passes;
+        size_t usedNum;
+        GLuint lastQuery;
+        bool pending;
+    };
+
+    struct OpenPass
+    {
+        const char *name;
+        Clock::time_point cpuStart;
+        size_t queries;
+    };
+
+    void _Collect(FrameQueries &frame, bool wait);
+
+    std::vector<FrameQueries> m_frames;
+    size_t m_frame;
+    std::vector<OpenPass> m_openPasses;
+    TimingHistory m_cpuTimes;
+    TimingHistory m_gpuTimes;
+    unsigned long m_droppedFrames;
+};
+
+// Times a pass for the enclosing scope. A null profiler does nothing.
+class ProfilerScope
+{
+public:
+    ProfilerScope(FrameProfiler *profiler, const char *name) : m_profiler(profiler)
+    {
+        if (m_profiler) {
+            m_profiler->BeginPass(name);
+        }
+    }
+
+    ~ProfilerScope()
+    {
+        if (m_profiler) {
+            m_profiler->EndPass();
+        }
+    }
+
+    ProfilerScope(const ProfilerScope &) = delete;
+    ProfilerScope & operator=(const ProfilerScope &) = delete;
+
+private:
+    FrameProfiler *m_profiler;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <memory>
+#include "glsl_compiler.hpp"
+#include "trace.hpp"
+
+typedef void (GLAPIENTRY * MaxShaderCompilerThreadsProc)(GLuint count);
+
+GLSLCompiler::GLSLCompiler(GLFWwindow *sharedWindow, unsigned threadNum) :
+    m_driverParallel(HasParallelShaderCompile()),
+    m_contexts(),
+    m_workers(),
+    m_jobs(),
+    m_jobsMutex(),
+    m_jobsCond(),
+    m_stopping(false),
+    m_pending()
+{
+    if (m_driverParallel) {
+        // Let the driver pick the number of compiler threads
+        MaxShaderCompilerThreadsProc maxThreads = nullptr;
+        if (GLEW_ARB_parallel_shader_compile) {
+            maxThreads = glMaxShaderCompilerThreadsARB;
+        } else {
+            maxThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(glfwGetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        }
+        if (maxThreads) {
+            maxThreads(0xFFFFFFFF);
+        }
+        return;
+    }
+
+    if (threadNum == 0) {
+        threadNum = std::thread::hardware_concurrency();
+    }
+
+    // Windows (and their contexts) can only be created on the main thread
+    glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+    for (unsigned i = 0; i < threadNum; i++) {
+        GLFWwindow *context = glfwCreateWindow(1, 1, "", nullptr, sharedWindow);
+        if (!context) {
+            break;
+        }
+        m_contexts.push_back(context);
+    }
+    glfwDefaultWindowHints();
+    glfwMakeContextCurrent(sharedWindow);
+
+    for (size_t i = 0; i < m_contexts.size(); i++) {
+        m_workers.push_back(std::thread(&GLSLCompiler::_WorkerLoop, this, m_contexts[i]));
+    }
+}
+
+GLSLCompiler::~GLSLCompiler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_jobsMutex);
+        m_stopping = true;
+    }
+    m_jobsCond.notify_all();
+
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        m_workers[i].join();
+    }
+    for (size_t i = 0; i < m_contexts.size(); i++) {
+        glfwDestroyWindow(m_contexts[i]);
+    }
+}
+
+void GLSLCompiler::Submit(GLSLProgram &program)
+{
+    if (m_workers.empty()) {
+        program.SubmitLink();
+        return;
+    }
+
+    GLSLProgram *programPtr = &program;
+    std::shared_ptr<std::packaged_task<void()>> task = std::make_shared<std::packaged_task<void()>>([programPtr] {
+        programPtr->SubmitLink();
+
+        // Querying the status blocks until the driver is done, and glFinish
+        // makes the results visible to the main context
+        GLint linkStatus;
+        glGetProgramiv(programPtr->Handle(), GL_LINK_STATUS, &linkStatus);
+        glFinish();
+    });
+    m_pending[programPtr] = task->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(m_jobsMutex);
+        m_jobs.push([task] { (*task)(); });
+    }
+    m_jobsCond.notify_one();
+}
+
+bool GLSLCompiler::IsComplete(GLSLProgram &program)
+{
+    std::map<GLSLProgram *, std::future<void>>::iterator it = m_pending.find(&program);
+    if (it == m_pending.end()) {
+        return program.IsLinkComplete();
+    }
+    return it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+void GLSLCompiler::Wait(GLSLProgram &program)
+{
+    std::map<GLSLProgram *, std::future<void>>::iterator it = m_pending.find(&program);
+    if (it != m_pending.end()) {
+        std::future<void> result = std::move(it->second);
+        m_pending.erase(it);
+        // Rethrows errors raised on the worker
+        result.get();
+    }
+
+    program.FinishLink();
+}
+
+void GLSLCompiler::LinkAll(const std::vector<GLSLProgram *> &programs)
+{
+    for (size_t i = 0; i < programs.size(); i++) {
+        Submit(*programs[i]);
+    }
+    for (size_t i = 0; i < programs.size(); i++) {
+        Wait(*programs[i]);
+    }
+}
+
+void GLSLCompiler::_WorkerLoop(GLFWwindow *context)
+{
+    glfwMakeContextCurrent(context);
+    TraceSetThreadName("shader compiler");
+
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(m_jobsMutex);
+            m_jobsCond.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty()) {
+                break;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop();
+        }
+        job();
+    }
+
+    glfwMakeContextCurrent(nullptr);
+}
@@ -0,0 +1,56 @@
+#ifndef GLSL_COMPILER_HPP
+#define GLSL_COMPILER_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include "glsl_program.hpp"
+
+struct GLFWwindow;
+
+// Compiles and links programs without serializing on each status query.
+// When the driver supports parallel shader compilation, programs are submitted
+// on the calling thread and the driver compiles them in the background.
+// Otherwise they are handed to a pool of worker threads, each owning a hidden
+// window whose context shares objects with the main one.
+class GLSLCompiler
+{
+public:
+    // Must be called on the main thread with `sharedWindow` context current.
+    // A thread number of 0 uses the hardware concurrency.
+    explicit GLSLCompiler(GLFWwindow *sharedWindow, unsigned threadNum = 0);
+    ~GLSLCompiler();
+
+    bool IsDriverParallel() const { return m_driverParallel; }
+    unsigned ThreadNum() const { return static_cast<unsigned>(m_workers.size()); }
+
+    // Start compiling and linking a program with recorded shader sources.
+    // The program must not be used until Wait() returns for it.
+    void Submit(GLSLProgram &program);
+    bool IsComplete(GLSLProgram &program);
+
+    // Block until the program is linked; throws GLSLException on failure
+    void Wait(GLSLProgram &program);
+
+    // Submit all programs, then wait for all of them
+    void LinkAll(const std::vector<GLSLProgram *> &programs);
+
+private:
+    void _WorkerLoop(GLFWwindow *context);
+
+    bool m_driverParallel;
+    std::vector<GLFWwindow *> m_contexts;
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_jobs;
+    std::mutex m_jobsMutex;
+    std::condition_variable m_jobsCond;
+    bool m_stopping;
+    std::map<GLSLProgram *, std::future<void>> m_pending;
+};
+
+#endif
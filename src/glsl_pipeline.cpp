@@ -0,0 +1,45 @@
+#include "glsl_pipeline.hpp"
+
+GLSLPipeline::GLSLPipeline() :
+    m_handle(0)
+{
+    glGenProgramPipelines(1, &m_handle);
+    if (m_handle == 0) {
+        throw GLSLException("Failed to create program pipeline");
+    }
+}
+
+GLSLPipeline::~GLSLPipeline()
+{
+    glDeleteProgramPipelines(1, &m_handle);
+}
+
+void GLSLPipeline::UseStages(const GLSLProgram &program)
+{
+    if (!program.IsSeparable() || !program.IsLinked()) {
+        throw GLSLException("Only linked separable programs can be used as pipeline stages");
+    }
+    glUseProgramStages(m_handle, program.GetStageBits(), program.Handle());
+}
+
+void GLSLPipeline::Use()
+{
+    GLSLProgram::UseNone();
+    glBindProgramPipeline(m_handle);
+}
+
+GLSLPipeline & GLSLPipelineCache::Get(const GLSLProgram &vertex, const GLSLProgram &fragment)
+{
+    Entry &entry = m_pipelines[std::make_pair(&vertex, &fragment)];
+    if (!entry.pipeline) {
+        entry.pipeline.reset(new GLSLPipeline);
+    } else if (entry.vertexGeneration == vertex.Generation() && entry.fragmentGeneration == fragment.Generation()) {
+        return *entry.pipeline;
+    }
+
+    entry.pipeline->UseStages(vertex);
+    entry.pipeline->UseStages(fragment);
+    entry.vertexGeneration = vertex.Generation();
+    entry.fragmentGeneration = fragment.Generation();
+    return *entry.pipeline;
+}
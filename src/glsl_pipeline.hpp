@@ -0,0 +1,57 @@
+#ifndef GLSL_PIPELINE_HPP
+#define GLSL_PIPELINE_HPP
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <utility>
+#include "glsl_program.hpp"
+
+// Program pipeline object combining separable programs. N vertex and M
+// fragment stages then cost N + M compiles instead of N x M program links.
+// Uniforms are set on the stage programs themselves.
+class GLSLPipeline
+{
+public:
+    GLSLPipeline();
+    ~GLSLPipeline();
+
+    GLSLPipeline(const GLSLPipeline &) = delete;
+    GLSLPipeline & operator=(const GLSLPipeline &) = delete;
+
+    // Attach all stages of a linked separable program
+    void UseStages(const GLSLProgram &program);
+
+    // Bind the pipeline. A program bound with GLSLProgram::Use() takes
+    // precedence over pipelines, so this unbinds it; only the first bind
+    // after a Use() pays for glUseProgram(0).
+    void Use();
+
+    GLuint Handle() const { return m_handle; }
+
+private:
+    GLuint m_handle;
+};
+
+// Pipelines by vertex/fragment program pair, created on first use. A pair
+// whose programs were reloaded since gets its stages attached again.
+class GLSLPipelineCache
+{
+public:
+    GLSLPipeline & Get(const GLSLProgram &vertex, const GLSLProgram &fragment);
+
+    size_t Size() const { return m_pipelines.size(); }
+
+private:
+    struct Entry
+    {
+        uint64_t vertexGeneration;
+        uint64_t fragmentGeneration;
+        std::unique_ptr<GLSLPipeline> pipeline;
+    };
+
+    std::map<std::pair<const GLSLProgram *, const GLSLProgram *>, Entry> m_pipelines;
+};
+
+#endif
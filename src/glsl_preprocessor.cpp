@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include "glsl_exception.hpp"
+#include "glsl_preprocessor.hpp"
+#include "hash.hpp"
+
+static const int MAX_INCLUDE_DEPTH = 32;
+static const char *ONCE_GUARD_PREFIX = "GLSL_PREPROCESSOR_ONCE_";
+
+static std::string ReadIncludeFile(const boost::filesystem::path &path)
+{
+    std::ifstream ifs(path.string().c_str());
+    if (!ifs) {
+        throw GLSLException(std::string("Failed to read shader include: ") + path.string());
+    }
+    return std::string((std::istreambuf_iterator<char>(ifs)), (std::istreambuf_iterator<char>()));
+}
+
+// Returns the directive name of a preprocessor line ("include", "version", ...)
+// and sets `rest` to the text following it, or returns an empty string
+static std::string ParseDirective(const std::string &line, std::string &rest)
+{
+    size_t pos = line.find_first_not_of(" \t");
+    if (pos == std::string::npos || line[pos] != '#') {
+        return std::string();
+    }
+    pos = line.find_first_not_of(" \t", pos + 1);
+    if (pos == std::string::npos) {
+        return std::string();
+    }
+    size_t end = line.find_first_of(" \t\r", pos);
+    std::string directive = line.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+    rest = (end == std::string::npos ? std::string() : line.substr(end));
+    return directive;
+}
+
+// Whether `rest` of a #pragma is exactly "once"
+static bool IsPragmaOnce(const std::string &rest)
+{
+    std::istringstream iss(rest);
+    std::string token;
+    return (iss >> token) && token == "once" && !(iss >> token);
+}
+
+// Files are told apart by canonical path; the root file may not exist on
+// disk, in which case its path is taken as is
+static boost::filesystem::path FileKey(const boost::filesystem::path &path)
+{
+    boost::system::error_code error;
+    boost::filesystem::path canonical = boost::filesystem::canonical(path, error);
+    return error ? path : canonical;
+}
+
+GLSLDefines & GLSLDefines::Set(const std::string &name, const std::string &value)
+{
+    m_defines[name] = value;
+    return *this;
+}
+
+GLSLDefines & GLSLDefines::Set(const std::string &name, int value)
+{
+    std::ostringstream oss;
+    oss << value;
+    return Set(name, oss.str());
+}
+
+uint64_t GLSLDefines::Hash(uint64_t hash) const
+{
+    for (std::map<std::string, std::string>::const_iterator it = m_defines.begin(); it != m_defines.end(); ++it) {
+        hash = HashString(it->first, hash);
+        hash = HashString(it->second, hash);
+    }
+    return hash;
+}
+
+std::string GLSLDefines::ToSource() const
+{
+    std::string source;
+    for (std::map<std::string, std::string>::const_iterator it = m_defines.begin(); it != m_defines.end(); ++it) {
+        source += "#define " + it->first + " " + it->second + "\n";
+    }
+    return source;
+}
+
+GLSLPreprocessor::GLSLPreprocessor() :
+    m_includePaths()
+{
+}
+
+void GLSLPreprocessor::AddIncludePath(const std::string &directory)
+{
+    m_includePaths.push_back(directory);
+}
+
+GLSLPreprocessedSource GLSLPreprocessor::Process(const std::string &source, const char *fileName, const GLSLDefines &defines) const
+{
+    Context context;
+    _Process(source, boost::filesystem::path(fileName ? fileName : ""), 0, context);
+
+    // #version must precede everything else, including the #line of an
+    // included file that has it, so it is moved to the top and followed by
+    // the defines
+    if (!context.version.empty() || !defines.IsEmpty()) {
+        std::string header = context.version.empty() ? std::string() : context.version + "\n";
+        context.result.source = header + defines.ToSource() + "#line 1 0\n" + context.result.source;
+    }
+    return context.result;
+}
+
+void GLSLPreprocessor::_Process(const std::string &source, const boost::filesystem::path &path, int depth, Context &context) const
+{
+    if (depth > MAX_INCLUDE_DEPTH) {
+        throw GLSLException(std::string("Shader include depth exceeded (recursive include?): ") + path.string());
+    }
+
+    int fileIndex = static_cast<int>(context.result.files.size());
+    context.result.files.push_back(path.string());
+    boost::filesystem::path key = FileKey(path);
+    context.openFiles.push_back(key);
+    bool guarded = false;
+    if (depth > 0) {
+        std::ostringstream begin;
+        begin << "#line 1 " << fileIndex << "\n";
+        context.result.source += begin.str();
+    }
+
+    std::istringstream iss(source);
+    std::string line;
+    std::string rest;
+    for (int lineNo = 1; std::getline(iss, line); lineNo++) {
+        std::string directive = ParseDirective(line, rest);
+
+        if (directive == "include") {
+            size_t begin = rest.find_first_of("\"<");
+            size_t end = (begin == std::string::npos ? std::string::npos : rest.find_first_of("\">", begin + 1));
+            if (end == std::string::npos) {
+                std::ostringstream msg;
+                msg << "Malformed #include in " << path.string() << ":" << lineNo;
+                throw GLSLException(msg.str());
+            }
+
+            // A "#pragma once" file that is still open is being included by
+            // itself; any other include is expanded and left to its guard
+            boost::filesystem::path includePath = _Resolve(rest.substr(begin + 1, end - begin - 1), path);
+            bool open = std::find(context.openFiles.begin(), context.openFiles.end(), includePath) != context.openFiles.end();
+            if (!open || context.onceGuards.count(includePath) == 0) {
+                _Process(ReadIncludeFile(includePath), includePath, depth + 1, context);
+                std::ostringstream resume;
+                resume << "#line " << lineNo + 1 << " " << fileIndex << "\n";
+                context.result.source += resume.str();
+            } else {
+                context.result.source += "\n";
+            }
+            continue;
+        }
+
+        if (directive == "pragma" && IsPragmaOnce(rest)) {
+            if (!guarded) {
+                std::map<boost::filesystem::path, int>::const_iterator it = context.onceGuards.find(key);
+                if (it == context.onceGuards.end()) {
+                    it = context.onceGuards.insert(std::make_pair(key, static_cast<int>(context.onceGuards.size()))).first;
+                }
+                std::ostringstream guard;
+                guard << "#ifndef " << ONCE_GUARD_PREFIX << it->second << "\n";
+                guard << "#define " << ONCE_GUARD_PREFIX << it->second << "\n";
+                guard << "#line " << lineNo + 1 << " " << fileIndex << "\n";
+                context.result.source += guard.str();
+                guarded = true;
+            } else {
+                context.result.source += "\n";
+            }
+            continue;
+        }
+
+        if (directive == "version") {
+            if (!context.version.empty()) {
+                std::ostringstream msg;
+                msg << "Duplicate #version in " << path.string() << ":" << lineNo;
+                throw GLSLException(msg.str());
+            }
+            // Moved to the top by Process(); the blank line keeps numbering
+            context.version = line;
+            context.result.source += "\n";
+            continue;
+        }
+
+        context.result.source += line;
+        context.result.source += "\n";
+    }
+
+    if (guarded) {
+        context.result.source += "#endif\n";
+    }
+    context.openFiles.pop_back();
+}
+
+boost::filesystem::path GLSLPreprocessor::_Resolve(const std::string &include, const boost::filesystem::path &includingFile) const
+{
+    boost::filesystem::path candidate = includingFile.parent_path() / include;
+    if (boost::filesystem::is_regular_file(candidate)) {
+        return boost::filesystem::canonical(candidate);
+    }
+    for (size_t i = 0; i < m_includePaths.size(); i++) {
+        candidate = m_includePaths[i] / include;
+        if (boost::filesystem::is_regular_file(candidate)) {
+            return boost::filesystem::canonical(candidate);
+        }
+    }
+    throw GLSLException(std::string("Shader include not found: ") + include + " (included from " + includingFile.string() + ")");
+}
@@ -0,0 +1,64 @@
+#ifndef GLSL_PREPROCESSOR_HPP
+#define GLSL_PREPROCESSOR_HPP
+
+#include <boost/filesystem.hpp>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Set of preprocessor defines, kept sorted so that equal sets produce equal
+// sources and hashes regardless of insertion order
+class GLSLDefines
+{
+public:
+    GLSLDefines & Set(const std::string &name, const std::string &value = "1");
+    GLSLDefines & Set(const std::string &name, int value);
+
+    bool IsEmpty() const { return m_defines.empty(); }
+    bool IsSet(const std::string &name) const { return m_defines.count(name) != 0; }
+    uint64_t Hash(uint64_t hash) const;
+    std::string ToSource() const;
+
+private:
+    std::map<std::string, std::string> m_defines;
+};
+
+// Result of preprocessing: the source handed to the compiler and the files
+// it was assembled from. "#line <line> <n>" directives refer to files[n].
+struct GLSLPreprocessedSource
+{
+    std::string source;
+    std::vector<std::string> files;
+};
+
+// Resolves #include "file" (relative to the including file, then to the
+// include paths). The #version directive, from whichever file has it, is
+// moved to the top and followed by the defines. "#pragma once" becomes an
+// include guard, so that it also holds for includes inside #if blocks, which
+// are left to the compiler; their files must still exist.
+class GLSLPreprocessor
+{
+public:
+    GLSLPreprocessor();
+
+    void AddIncludePath(const std::string &directory);
+
+    GLSLPreprocessedSource Process(const std::string &source, const char *fileName, const GLSLDefines &defines) const;
+
+private:
+    struct Context
+    {
+        GLSLPreprocessedSource result;
+        std::map<boost::filesystem::path, int> onceGuards;
+        std::vector<boost::filesystem::path> openFiles;
+        std::string version;
+    };
+
+    void _Process(const std::string &source, const boost::filesystem::path &path, int depth, Context &context) const;
+    boost::filesystem::path _Resolve(const std::string &include, const boost::filesystem::path &includingFile) const;
+
+    std::vector<boost::filesystem::path> m_includePaths;
+};
+
+#endif
@@ -1,9 +1,22 @@
 #include <vector>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <utility>
 #include <sstream>
 #include <fstream>
 #include <iostream>
 #include <boost/filesystem.hpp>
 #include "glsl_program.hpp"
+#include "glsl_program_cache.hpp"
+#include "glsl_shader_cache.hpp"
+#include "hash.hpp"
+#include "trace.hpp"
+#include "uniform_block.hpp"
+
+// Program bound by GLSLProgram::Use() on the GL thread, 0 once unbound
+static GLuint g_usedProgram = 0;
+static uint64_t g_lastGeneration = 0;
 
 void CheckFileExists(const boost::filesystem::path &path)
 {
@@ -24,6 +37,8 @@ GLSLShaderType GetShaderTypeByPath(const boost::filesystem::path &path)
         type = GLSLShaderType::VERTEX;
     } else if (ext == ".frag") {
         type = GLSLShaderType::FRAGMENT;
+    } else if (ext == ".comp") {
+        type = GLSLShaderType::COMPUTE;
     } else {
         throw GLSLException(std::string("Unknown shader file extension: ") + ext);
     }
@@ -156,10 +171,79 @@ const char * OglTypeToString(GLenum type)
     }
 }
 
+bool HasParallelShaderCompile()
+{
+    // GLEW predates the KHR version of the extension, so look it up by name
+    static const bool hasParallelCompile = [] {
+        if (GLEW_ARB_parallel_shader_compile) {
+            return true;
+        }
+        GLint extNum = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extNum);
+        for (GLint i = 0; i < extNum; i++) {
+            const char *ext = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+            if (ext && std::strcmp(ext, "GL_KHR_parallel_shader_compile") == 0) {
+                return true;
+            }
+        }
+        return false;
+    }();
+    return hasParallelCompile;
+}
+
+// Size of a uniform value in the shadow copy, or 0 for types that are not shadowed
+size_t UniformTypeSize(GLenum type)
+{
+    switch (type) {
+        case GL_FLOAT:      return sizeof(GLfloat);
+        case GL_FLOAT_VEC2: return sizeof(GLfloat) * 2;
+        case GL_FLOAT_VEC3: return sizeof(GLfloat) * 3;
+        case GL_FLOAT_VEC4: return sizeof(GLfloat) * 4;
+        case GL_FLOAT_MAT3: return sizeof(GLfloat) * 9;
+        case GL_FLOAT_MAT4: return sizeof(GLfloat) * 16;
+        case GL_INT:
+        case GL_BOOL:       return sizeof(GLint);
+        default:            return 0;
+    }
+}
+
+// Whether a value of `type` can be kept in a shadow slot of `slotType`;
+// booleans are set as integers
+static bool IsShadowCompatible(GLenum slotType, GLenum type)
+{
+    if (slotType == GL_BOOL) {
+        slotType = GL_INT;
+    }
+    return slotType == type;
+}
+
 GLSLProgram::GLSLProgram() :
     m_handle(0),
+    m_generation(++g_lastGeneration),
     m_linked(false),
-    m_uniformLocations()
+    m_loadedFromCache(false),
+    m_separable(false),
+    m_cache(nullptr),
+    m_cacheKey(0),
+    m_shaderCache(nullptr),
+    m_preprocessor(nullptr),
+    m_defines(),
+    m_sources(),
+    m_shaders(),
+    m_shaderKeys(),
+    m_attribLocations(),
+    m_uniforms(),
+    m_uniformBlocks(),
+    m_shadowUniforms(false),
+    m_shadowSlots(),
+    m_shadowSlotByLocation(),
+    m_shadowData(),
+    m_dirtySlots(),
+    m_hoistUniforms(false),
+    m_hoistedUniforms(),
+    m_hoistedSlots(),
+    m_virtualLocationBase(INT_MAX),
+    m_uniformStats()
 {
     m_handle = glCreateProgram();
     if (m_handle == 0) {
@@ -169,6 +253,7 @@ GLSLProgram::GLSLProgram() :
 
 GLSLProgram::~GLSLProgram()
 {
+    _ReleaseShaders();
     glDeleteProgram(m_handle);
 }
 
@@ -196,16 +281,187 @@ void GLSLProgram::CompileShader(const char *file, GLSLShaderType type)
 
 void GLSLProgram::CompileShader(const std::string &source, GLSLShaderType type, const char *fileName)
 {
-    GLuint shader = glCreateShader((GLenum)type);
-    if (shader == 0) {
-        throw GLSLException("Failed to create shader");
+    TraceZone zone("preprocess", "shader");
+    zone.SetDetail(fileName ? fileName : "");
+
+    static const GLSLPreprocessor defaultPreprocessor;
+    const GLSLPreprocessor &preprocessor = (m_preprocessor ? *m_preprocessor : defaultPreprocessor);
+    GLSLPreprocessedSource processed = preprocessor.Process(source, fileName, m_defines);
+
+    ShaderSource shaderSource;
+    shaderSource.type = type;
+    shaderSource.source.swap(processed.source);
+    shaderSource.fileName = (fileName ? fileName : "");
+    shaderSource.files.swap(processed.files);
+    if (m_hoistUniforms) {
+        GLSLHoistResult hoisted = HoistUniformExpressions(shaderSource.source);
+        shaderSource.source.swap(hoisted.source);
+        shaderSource.hoistedUniforms.swap(hoisted.uniforms);
+    }
+    _AddSource(shaderSource);
+}
+
+void GLSLProgram::_AddSource(const ShaderSource &shaderSource)
+{
+    // Stages share hoisted uniforms of the same expression
+    for (size_t i = 0; i < shaderSource.hoistedUniforms.size(); i++) {
+        const GLSLHoistedUniform &uniform = shaderSource.hoistedUniforms[i];
+        bool found = false;
+        for (size_t j = 0; j < m_hoistedUniforms.size() && !found; j++) {
+            const GLSLHoistedUniform &other = m_hoistedUniforms[j];
+            if (other.decl.name != uniform.decl.name) {
+                continue;
+            }
+            if (other.op != uniform.op || other.operands[0].name != uniform.operands[0].name || other.operands[1].name != uniform.operands[1].name) {
+                throw GLSLException("Hoisted uniform name collision: " + uniform.decl.name);
+            }
+            found = true;
+        }
+        if (!found) {
+            m_hoistedUniforms.push_back(uniform);
+        }
+    }
+
+    m_sources.push_back(shaderSource);
+    if (m_shaderCache) {
+        m_shaderKeys.push_back(m_shaderCache->Acquire((GLenum)shaderSource.type, shaderSource.source));
+    }
+}
+
+std::unique_ptr<GLSLProgram> GLSLProgram::CreateReloaded() const
+{
+    std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+    program->SetBinaryCache(m_cache);
+    program->SetShaderCache(m_shaderCache);
+    program->SetPreprocessor(m_preprocessor);
+    program->SetDefines(m_defines);
+    program->SetSeparable(m_separable);
+    program->m_shadowUniforms = m_shadowUniforms;
+    program->m_hoistUniforms = m_hoistUniforms;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        const ShaderSource &shaderSource = m_sources[i];
+        if (shaderSource.fileName.empty()) {
+            program->_AddSource(shaderSource);
+        } else {
+            program->CompileShader(shaderSource.fileName.c_str(), shaderSource.type);
+        }
     }
+    for (size_t i = 0; i < m_attribLocations.size(); i++) {
+        program->BindAttribLocation(m_attribLocations[i].location, m_attribLocations[i].name.c_str());
+    }
+    return program;
+}
 
-    const GLchar *sourcePtr = source.c_str();
-    GLint sourceLen = static_cast<GLint>(source.length());
-    glShaderSource(shader, 1, &sourcePtr, &sourceLen);
+std::vector<std::string> GLSLProgram::GetSourceFiles() const
+{
+    std::vector<std::string> files;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        if (m_sources[i].fileName.empty()) {
+            continue;
+        }
+        const std::vector<std::string> &sourceFiles = m_sources[i].files;
+        for (size_t j = 0; j < sourceFiles.size(); j++) {
+            if (std::find(files.begin(), files.end(), sourceFiles[j]) == files.end()) {
+                files.push_back(sourceFiles[j]);
+            }
+        }
+    }
+    return files;
+}
+
+void GLSLProgram::Swap(GLSLProgram &other)
+{
+    std::swap(m_handle, other.m_handle);
+    std::swap(m_generation, other.m_generation);
+    std::swap(m_linked, other.m_linked);
+    std::swap(m_loadedFromCache, other.m_loadedFromCache);
+    std::swap(m_separable, other.m_separable);
+    std::swap(m_cache, other.m_cache);
+    std::swap(m_cacheKey, other.m_cacheKey);
+    std::swap(m_shaderCache, other.m_shaderCache);
+    std::swap(m_preprocessor, other.m_preprocessor);
+    std::swap(m_defines, other.m_defines);
+    m_sources.swap(other.m_sources);
+    m_shaders.swap(other.m_shaders);
+    m_shaderKeys.swap(other.m_shaderKeys);
+    m_attribLocations.swap(other.m_attribLocations);
+    m_uniforms.swap(other.m_uniforms);
+    m_uniformBlocks.swap(other.m_uniformBlocks);
+    std::swap(m_shadowUniforms, other.m_shadowUniforms);
+    m_shadowSlots.swap(other.m_shadowSlots);
+    m_shadowSlotByLocation.swap(other.m_shadowSlotByLocation);
+    m_shadowData.swap(other.m_shadowData);
+    m_dirtySlots.swap(other.m_dirtySlots);
+    std::swap(m_hoistUniforms, other.m_hoistUniforms);
+    m_hoistedUniforms.swap(other.m_hoistedUniforms);
+    m_hoistedSlots.swap(other.m_hoistedSlots);
+    std::swap(m_virtualLocationBase, other.m_virtualLocationBase);
+}
+
+void GLSLProgram::SetSeparable(bool separable)
+{
+    m_separable = separable;
+    glProgramParameteri(m_handle, GL_PROGRAM_SEPARABLE, separable ? GL_TRUE : GL_FALSE);
+}
+
+GLbitfield GLSLProgram::GetStageBits() const
+{
+    GLbitfield bits = 0;
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        switch (m_sources[i].type) {
+            case GLSLShaderType::VERTEX:          bits |= GL_VERTEX_SHADER_BIT; break;
+            case GLSLShaderType::FRAGMENT:        bits |= GL_FRAGMENT_SHADER_BIT; break;
+            case GLSLShaderType::GEOMETRY:        bits |= GL_GEOMETRY_SHADER_BIT; break;
+            case GLSLShaderType::TESS_CONTROL:    bits |= GL_TESS_CONTROL_SHADER_BIT; break;
+            case GLSLShaderType::TESS_EVALUATION: bits |= GL_TESS_EVALUATION_SHADER_BIT; break;
+            case GLSLShaderType::COMPUTE:         bits |= GL_COMPUTE_SHADER_BIT; break;
+        }
+    }
+    return bits;
+}
+
+GLuint GLSLProgram::_SubmitShader(size_t index)
+{
+    const ShaderSource &shaderSource = m_sources[index];
+    // With parallel compile, this only covers issuing the compile
+    TraceZone zone("compile", "shader");
+    zone.SetDetail(shaderSource.fileName.c_str());
+
+    GLuint shader;
+    if (m_shaderCache) {
+        shader = m_shaderCache->Compile(m_shaderKeys[index], shaderSource.source);
+    } else {
+        shader = glCreateShader((GLenum)shaderSource.type);
+        if (shader == 0) {
+            throw GLSLException("Failed to create shader");
+        }
+
+        const GLchar *sourcePtr = shaderSource.source.c_str();
+        GLint sourceLen = static_cast<GLint>(shaderSource.source.length());
+        glShaderSource(shader, 1, &sourcePtr, &sourceLen);
+        glCompileShader(shader);
+    }
+    glAttachShader(m_handle, shader);
+    return shader;
+}
+
+void GLSLProgram::_ReleaseShaders()
+{
+    for (size_t i = 0; i < m_shaders.size(); i++) {
+        glDetachShader(m_handle, m_shaders[i]);
+        if (!m_shaderCache) {
+            glDeleteShader(m_shaders[i]);
+        }
+    }
+    for (size_t i = 0; i < m_shaderKeys.size(); i++) {
+        m_shaderCache->Release(m_shaderKeys[i]);
+    }
+    m_shaders.clear();
+    m_shaderKeys.clear();
+}
 
-    glCompileShader(shader);
+void GLSLProgram::_CheckShader(GLuint shader, const ShaderSource &shaderSource)
+{
     GLint compileStatus;
     glGetShaderiv(shader, GL_COMPILE_STATUS, &compileStatus);
     if (!compileStatus) {
@@ -214,26 +470,135 @@ void GLSLProgram::CompileShader(const std::string &source, GLSLShaderType type,
         std::vector<char> log(logLen);
         glGetShaderInfoLog(shader, logLen, nullptr, &log[0]);
         std::ostringstream msg;
-        msg << "Shader (" << fileName << ") compilation failed:" << std::endl << &log[0] << std::endl;
+        msg << "Shader (" << shaderSource.fileName << ") compilation failed:" << std::endl << &log[0] << std::endl;
+        // Line numbers of included code refer to source string numbers
+        if (shaderSource.files.size() > 1) {
+            msg << "Source strings:" << std::endl;
+            for (size_t i = 0; i < shaderSource.files.size(); i++) {
+                msg << "  " << i << ": " << shaderSource.files[i] << std::endl;
+            }
+        }
         throw GLSLException(msg.str());
     }
+}
 
-    glAttachShader(m_handle, shader);
+uint64_t GLSLProgram::_GetCacheKey() const
+{
+    uint64_t key = m_cache->DriverHash();
+    key = HashValue(m_separable, key);
+    for (size_t i = 0; i < m_sources.size(); i++) {
+        key = HashValue(m_sources[i].type, key);
+        key = HashString(m_sources[i].source, key);
+    }
+    for (size_t i = 0; i < m_attribLocations.size(); i++) {
+        key = HashValue(m_attribLocations[i].location, key);
+        key = HashString(m_attribLocations[i].name, key);
+    }
+    return key;
 }
 
 void GLSLProgram::Use()
 {
     if (m_linked) {
         glUseProgram(m_handle);
+        g_usedProgram = m_handle;
     }
 }
 
+void GLSLProgram::UseNone()
+{
+    if (g_usedProgram != 0) {
+        glUseProgram(0);
+        g_usedProgram = 0;
+    }
+}
+
+void GLSLProgram::Dispatch(GLuint groupNumX, GLuint groupNumY, GLuint groupNumZ)
+{
+    Use();
+    FlushUniforms();
+    glDispatchCompute(groupNumX, groupNumY, groupNumZ);
+}
+
+void GLSLProgram::DispatchThreads(GLuint threadNum)
+{
+    GLuint groupSize = GetWorkGroupSize().x;
+    Dispatch((threadNum + groupSize - 1) / groupSize);
+}
+
+glm::uvec3 GLSLProgram::GetWorkGroupSize() const
+{
+    GLint size[3];
+    glGetProgramiv(m_handle, GL_COMPUTE_WORK_GROUP_SIZE, size);
+    return glm::uvec3(size[0], size[1], size[2]);
+}
+
 void GLSLProgram::Link()
 {
+    SubmitLink();
+    FinishLink();
+}
+
+void GLSLProgram::SubmitLink()
+{
+    // Shader objects are gone after the first link
+    if (m_linked) {
+        throw GLSLException("Program is already linked");
+    }
+
+    TraceZone zone("submit link", "shader");
+    zone.SetDetail(m_sources.empty() ? "" : m_sources[0].fileName.c_str());
+
+    if (m_cache) {
+        m_cacheKey = _GetCacheKey();
+        if (m_cache->Load(m_handle, m_cacheKey)) {
+            m_loadedFromCache = true;
+            return;
+        }
+        glProgramParameteri(m_handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // No status is queried here, so that the driver can compile in the
+    // background until FinishLink() (or IsLinkComplete()) is called
+    for (size_t i = m_shaders.size(); i < m_sources.size(); i++) {
+        m_shaders.push_back(_SubmitShader(i));
+    }
     glLinkProgram(m_handle);
+}
+
+bool GLSLProgram::IsLinkComplete()
+{
+    if (m_loadedFromCache || !HasParallelShaderCompile()) {
+        return true;
+    }
+
+    GLint completionStatus;
+    glGetProgramiv(m_handle, GL_COMPLETION_STATUS_ARB, &completionStatus);
+    return completionStatus != 0;
+}
+
+void GLSLProgram::FinishLink()
+{
+    // Waits for the driver when compiling in the background
+    TraceZone zone("finish link", "shader");
+    zone.SetDetail(m_sources.empty() ? "" : m_sources[0].fileName.c_str());
+
+    if (m_loadedFromCache) {
+        _ReleaseShaders();
+        _ReflectUniforms();
+        _ReflectUniformBlocks();
+        m_linked = true;
+        return;
+    }
+
     GLint linkStatus;
     glGetProgramiv(m_handle, GL_LINK_STATUS, &linkStatus);
     if (!linkStatus) {
+        // Report the failing stage rather than the generic link error
+        for (size_t i = 0; i < m_shaders.size(); i++) {
+            _CheckShader(m_shaders[i], m_sources[i]);
+        }
+
         GLint logLen;
         glGetProgramiv(m_handle, GL_INFO_LOG_LENGTH, &logLen);
         std::vector<char> log(logLen);
@@ -243,65 +608,428 @@ void GLSLProgram::Link()
         throw GLSLException(msg.str());
     }
 
+    if (m_cache) {
+        m_cache->Store(m_handle, m_cacheKey);
+    }
+    _ReleaseShaders();
+
+    _ReflectUniforms();
+    _ReflectUniformBlocks();
     m_linked = true;
 }
 
 void GLSLProgram::BindAttribLocation(GLuint location, const char *name)
 {
+    AttribLocation attribLocation;
+    attribLocation.location = location;
+    attribLocation.name = name;
+    m_attribLocations.push_back(attribLocation);
+
     glBindAttribLocation(m_handle, location, name);
 }
 
-GLuint GLSLProgram::_GetUniformLocation(const char *name)
+void GLSLProgram::_ReflectUniforms()
+{
+    typedef std::pair<UniformInfo, std::string> UniformEntry;
+    std::vector<UniformEntry> entries;
+    // Arrays take a location per element
+    GLint maxLocation = -1;
+
+    GLint uniformNum;
+    glGetProgramInterfaceiv(m_handle, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformNum);
+    GLenum props[] = { GL_NAME_LENGTH, GL_TYPE, GL_LOCATION, GL_ARRAY_SIZE };
+    for (int i = 0; i < uniformNum; i++) {
+        GLint results[4];
+        glGetProgramResourceiv(m_handle, GL_UNIFORM, i, 4, props, 4, nullptr, results);
+
+        // Members of uniform blocks have no location
+        if (results[2] == -1) {
+            continue;
+        }
+
+        std::vector<char> nameBuf(results[0] + 1);
+        glGetProgramResourceName(m_handle, GL_UNIFORM, i, static_cast<GLsizei>(nameBuf.size()), nullptr, &nameBuf[0]);
+        std::string name(&nameBuf[0]);
+
+        UniformInfo info;
+        info.location = results[2];
+        info.type = results[1];
+        info.hash = HashCString(name.c_str());
+        entries.push_back(UniformEntry(info, name));
+        maxLocation = std::max(maxLocation, results[2] + std::max(results[3], 1) - 1);
+
+        // Arrays are reported as "name[0]", but can be set by plain name too,
+        // and their other elements by "name[k]" at consecutive locations
+        const std::string arraySuffix = "[0]";
+        if (name.length() > arraySuffix.length() && name.compare(name.length() - arraySuffix.length(), arraySuffix.length(), arraySuffix) == 0) {
+            std::string baseName = name.substr(0, name.length() - arraySuffix.length());
+            info.hash = HashCString(baseName.c_str());
+            entries.push_back(UniformEntry(info, baseName));
+            for (GLint k = 1; k < results[3]; k++) {
+                std::string elementName = baseName + "[" + std::to_string(k) + "]";
+                info.location = results[2] + k;
+                info.hash = HashCString(elementName.c_str());
+                entries.push_back(UniformEntry(info, elementName));
+            }
+        }
+    }
+
+    // Operands of hoisted uniforms, and hoisted uniforms only used by other
+    // hoisted ones, may be gone from the shaders. They get locations past
+    // the active ones, for the shadow copy only.
+    m_virtualLocationBase = maxLocation + 1;
+    std::vector<GLSLUniformDecl> hoistedDecls;
+    for (size_t i = 0; i < m_hoistedUniforms.size(); i++) {
+        const GLSLHoistedUniform &uniform = m_hoistedUniforms[i];
+        hoistedDecls.push_back(uniform.operands[0]);
+        if (uniform.op == GLSLHoistedOp::MULTIPLY) {
+            hoistedDecls.push_back(uniform.operands[1]);
+        }
+        hoistedDecls.push_back(uniform.decl);
+    }
+    for (size_t i = 0; i < hoistedDecls.size(); i++) {
+        uint64_t hash = HashCString(hoistedDecls[i].name.c_str());
+        bool active = std::any_of(entries.begin(), entries.end(), [hash](const UniformEntry &entry) { return entry.first.hash == hash; });
+        if (!active) {
+            UniformInfo info;
+            info.location = ++maxLocation;
+            info.type = hoistedDecls[i].type;
+            info.hash = hash;
+            entries.push_back(UniformEntry(info, hoistedDecls[i].name));
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const UniformEntry &a, const UniformEntry &b) { return a.first < b.first; });
+
+    m_uniforms.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (i > 0 && entries[i - 1].first.hash == entries[i].first.hash) {
+            throw GLSLException("Uniform name hash collision: " + entries[i - 1].second + ", " + entries[i].second);
+        }
+        m_uniforms.push_back(entries[i].first);
+    }
+
+    _ResetShadow();
+    _ResolveHoistedUniforms();
+}
+
+void GLSLProgram::_ResetShadow()
+{
+    m_shadowSlots.clear();
+    m_shadowSlotByLocation.clear();
+    m_shadowData.clear();
+    m_dirtySlots.clear();
+
+    size_t dataSize = 0;
+    for (size_t i = 0; i < m_uniforms.size(); i++) {
+        const UniformInfo &info = m_uniforms[i];
+        size_t size = UniformTypeSize(info.type);
+        if (size == 0) {
+            continue;
+        }
+        if (info.location >= static_cast<GLint>(m_shadowSlotByLocation.size())) {
+            m_shadowSlotByLocation.resize(info.location + 1, -1);
+        }
+        // The first element of an array is also registered by plain name
+        if (m_shadowSlotByLocation[info.location] != -1) {
+            continue;
+        }
+
+        ShadowSlot slot;
+        slot.location = info.location;
+        slot.type = info.type;
+        slot.offset = dataSize;
+        slot.size = size;
+        slot.valid = false;
+        slot.dirty = false;
+        m_shadowSlotByLocation[info.location] = static_cast<int>(m_shadowSlots.size());
+        m_shadowSlots.push_back(slot);
+        dataSize += size;
+    }
+    m_shadowData.resize(dataSize);
+}
+
+void GLSLProgram::_ResolveHoistedUniforms()
 {
-    std::map<std::string, int>::iterator it = m_uniformLocations.find(name);
-    if (it == m_uniformLocations.end()) {
-        GLint location = glGetUniformLocation(m_handle, name);
-        m_uniformLocations[name] = location;
+    m_hoistedSlots.clear();
+    for (size_t i = 0; i < m_hoistedUniforms.size(); i++) {
+        const GLSLHoistedUniform &uniform = m_hoistedUniforms[i];
+        const GLSLUniformDecl *decls[] = { &uniform.decl, &uniform.operands[0], &uniform.operands[1] };
+        int slots[3] = { -1, -1, -1 };
+        for (size_t j = 0; j < (uniform.op == GLSLHoistedOp::MULTIPLY ? 3u : 2u); j++) {
+            GLint location = _GetUniformLocation(GLSLUniformName(decls[j]->name.c_str()));
+            if (location != -1 && location < static_cast<GLint>(m_shadowSlotByLocation.size())) {
+                slots[j] = m_shadowSlotByLocation[location];
+            }
+        }
+        if (slots[0] == -1 || slots[1] == -1 || (uniform.op == GLSLHoistedOp::MULTIPLY && slots[2] == -1)) {
+            continue;
+        }
+
+        HoistedSlot hoistedSlot;
+        hoistedSlot.uniform = i;
+        hoistedSlot.slot = slots[0];
+        hoistedSlot.operandSlots[0] = slots[1];
+        hoistedSlot.operandSlots[1] = (uniform.op == GLSLHoistedOp::MULTIPLY ? slots[2] : slots[1]);
+        m_hoistedSlots.push_back(hoistedSlot);
     }
+}
+
+void GLSLProgram::_ReflectUniformBlocks()
+{
+    m_uniformBlocks.clear();
+
+    GLint blockNum;
+    glGetProgramInterfaceiv(m_handle, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockNum);
+    GLenum props[] = { GL_NAME_LENGTH, GL_BUFFER_DATA_SIZE };
+    for (int i = 0; i < blockNum; i++) {
+        GLint results[2];
+        glGetProgramResourceiv(m_handle, GL_UNIFORM_BLOCK, i, 2, props, 2, nullptr, results);
 
-    return m_uniformLocations[name];
+        std::vector<char> name(results[0] + 1);
+        glGetProgramResourceName(m_handle, GL_UNIFORM_BLOCK, i, static_cast<GLsizei>(name.size()), nullptr, &name[0]);
+
+        UniformBlockInfo info;
+        info.hash = HashCString(&name[0]);
+        info.index = i;
+        info.dataSize = results[1];
+        m_uniformBlocks.push_back(info);
+    }
+}
+
+const GLSLProgram::UniformBlockInfo * GLSLProgram::_FindUniformBlock(GLSLUniformName name) const
+{
+    // Programs have a handful of blocks at most
+    for (size_t i = 0; i < m_uniformBlocks.size(); i++) {
+        if (m_uniformBlocks[i].hash == name.Hash()) {
+            return &m_uniformBlocks[i];
+        }
+    }
+    return nullptr;
+}
+
+GLint GLSLProgram::GetUniformBlockSize(GLSLUniformName name) const
+{
+    const UniformBlockInfo *info = _FindUniformBlock(name);
+    return info ? info->dataSize : 0;
+}
+
+void GLSLProgram::BindUniformBlock(GLSLUniformName name, GLuint binding)
+{
+    const UniformBlockInfo *info = _FindUniformBlock(name);
+    if (info) {
+        glUniformBlockBinding(m_handle, info->index, binding);
+    }
+}
+
+void GLSLProgram::BindUniformBlocks(UniformBlockBindings &bindings)
+{
+    for (size_t i = 0; i < m_uniformBlocks.size(); i++) {
+        GLuint binding = bindings.GetBinding(GLSLUniformName::FromHash(m_uniformBlocks[i].hash));
+        glUniformBlockBinding(m_handle, m_uniformBlocks[i].index, binding);
+    }
+}
+
+const GLSLProgram::UniformInfo * GLSLProgram::_FindUniform(GLSLUniformName name) const
+{
+    UniformInfo key;
+    key.hash = name.Hash();
+    std::vector<UniformInfo>::const_iterator it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), key);
+    if (it == m_uniforms.end() || it->hash != key.hash) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+GLint GLSLProgram::_GetUniformLocation(GLSLUniformName name) const
+{
+    const UniformInfo *info = _FindUniform(name);
+    return info ? info->location : -1;
+}
+
+GLint GLSLProgram::_GetUniformLocation(GLSLUniformName name, GLenum type) const
+{
+    const UniformInfo *info = _FindUniform(name);
+    if (!info) {
+        return -1;
+    }
+
+    // Integer handles also set booleans, samplers and images
+    bool compatible = (info->type == type);
+    if (!compatible && type == GL_INT) {
+        const char *typeName = OglTypeToString(info->type);
+        compatible = (info->type == GL_BOOL || std::strstr(typeName, "sampler") || std::strstr(typeName, "image"));
+    }
+    if (!compatible) {
+        std::ostringstream msg;
+        msg << "Uniform at location " << info->location << " has type " << OglTypeToString(info->type)
+            << ", requested " << OglTypeToString(type);
+        throw GLSLException(msg.str());
+    }
+    return info->location;
 }
 
-void GLSLProgram::SetUniform(const char *name, float x, float y, float z)
+void GLSLProgram::SetUniform(GLSLUniformName name, float x, float y, float z)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniform3f(location, x, y, z);
+    glm::vec3 v(x, y, z);
+    _SetUniform(_GetUniformLocation(name), GL_FLOAT_VEC3, &v[0], sizeof(v));
 }
 
-void GLSLProgram::SetUniform(const char *name, const glm::vec3 &v)
+void GLSLProgram::SetUniform(GLSLUniformName name, const glm::vec3 &v)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniform3fv(location, 1, &v[0]);
+    _SetUniform(_GetUniformLocation(name), GL_FLOAT_VEC3, &v[0], sizeof(v));
 }
 
-void GLSLProgram::SetUniform(const char *name, const glm::vec4 &v)
+void GLSLProgram::SetUniform(GLSLUniformName name, const glm::vec4 &v)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniform4fv(location, 1, &v[0]);
+    _SetUniform(_GetUniformLocation(name), GL_FLOAT_VEC4, &v[0], sizeof(v));
 }
     
-void GLSLProgram::SetUniform(const char *name, const glm::mat3 &m)
+void GLSLProgram::SetUniform(GLSLUniformName name, const glm::mat3 &m)
+{
+    _SetUniform(_GetUniformLocation(name), GL_FLOAT_MAT3, &m[0][0], sizeof(m));
+}
+
+void GLSLProgram::SetUniform(GLSLUniformName name, const glm::mat4 &m)
+{
+    _SetUniform(_GetUniformLocation(name), GL_FLOAT_MAT4, &m[0][0], sizeof(m));
+}
+
+void GLSLProgram::SetUniform(GLSLUniformName name, float val)
+{
+    _SetUniform(_GetUniformLocation(name), GL_FLOAT, &val, sizeof(val));
+}
+
+void GLSLProgram::SetUniform(GLSLUniformName name, int val)
+{
+    _SetUniform(_GetUniformLocation(name), GL_INT, &val, sizeof(val));
+}
+
+void GLSLProgram::SetUniform(GLSLUniform<glm::vec3> uniform, const glm::vec3 &v)
+{
+    _SetUniform(uniform.Location(), GL_FLOAT_VEC3, &v[0], sizeof(v));
+}
+
+void GLSLProgram::SetUniform(GLSLUniform<glm::vec4> uniform, const glm::vec4 &v)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniformMatrix3fv(location, 1, GL_FALSE, &m[0][0]);
+    _SetUniform(uniform.Location(), GL_FLOAT_VEC4, &v[0], sizeof(v));
 }
 
-void GLSLProgram::SetUniform(const char *name, const glm::mat4 &m)
+void GLSLProgram::SetUniform(GLSLUniform<glm::mat3> uniform, const glm::mat3 &m)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniformMatrix4fv(location, 1, GL_FALSE, &m[0][0]);
+    _SetUniform(uniform.Location(), GL_FLOAT_MAT3, &m[0][0], sizeof(m));
 }
 
-void GLSLProgram::SetUniform(const char *name, float val)
+void GLSLProgram::SetUniform(GLSLUniform<glm::mat4> uniform, const glm::mat4 &m)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniform1f(location, val);
+    _SetUniform(uniform.Location(), GL_FLOAT_MAT4, &m[0][0], sizeof(m));
 }
 
-void GLSLProgram::SetUniform(const char *name, int val)
+void GLSLProgram::SetUniform(GLSLUniform<float> uniform, float val)
 {
-    GLuint location = _GetUniformLocation(name);
-    glUniform1i(location, val);
+    _SetUniform(uniform.Location(), GL_FLOAT, &val, sizeof(val));
+}
+
+void GLSLProgram::SetUniform(GLSLUniform<int> uniform, int val)
+{
+    _SetUniform(uniform.Location(), GL_INT, &val, sizeof(val));
+}
+
+void GLSLProgram::EnableUniformShadowing(bool enable)
+{
+    if (!enable) {
+        FlushUniforms();
+    }
+    m_shadowUniforms = enable;
+}
+
+void GLSLProgram::FlushUniforms()
+{
+    _UpdateHoistedUniforms();
+    for (size_t i = 0; i < m_dirtySlots.size(); i++) {
+        ShadowSlot &slot = m_shadowSlots[m_dirtySlots[i]];
+        _UploadUniform(slot.location, slot.type, &m_shadowData[slot.offset]);
+        slot.dirty = false;
+    }
+    m_dirtySlots.clear();
+}
+
+void GLSLProgram::_UpdateHoistedUniforms()
+{
+    // In dependency order, so that a changed hoisted uniform is seen as a
+    // dirty operand by the ones computed from it
+    for (size_t i = 0; i < m_hoistedSlots.size(); i++) {
+        const HoistedSlot &hoistedSlot = m_hoistedSlots[i];
+        ShadowSlot &slot = m_shadowSlots[hoistedSlot.slot];
+        const ShadowSlot &a = m_shadowSlots[hoistedSlot.operandSlots[0]];
+        const ShadowSlot &b = m_shadowSlots[hoistedSlot.operandSlots[1]];
+        if (!a.valid || !b.valid || (slot.valid && !a.dirty && !b.dirty)) {
+            continue;
+        }
+
+        unsigned char value[sizeof(glm::mat4)];
+        EvaluateHoistedUniform(m_hoistedUniforms[hoistedSlot.uniform], &m_shadowData[a.offset], &m_shadowData[b.offset], value);
+        unsigned char *shadow = &m_shadowData[slot.offset];
+        if (slot.valid && std::memcmp(shadow, value, slot.size) == 0) {
+            continue;
+        }
+        std::memcpy(shadow, value, slot.size);
+        slot.valid = true;
+        if (!slot.dirty) {
+            slot.dirty = true;
+            m_dirtySlots.push_back(hoistedSlot.slot);
+        }
+    }
+}
+
+void GLSLProgram::_SetUniform(GLint location, GLenum type, const void *data, size_t size)
+{
+    if (location == -1) {
+        return;
+    }
+    m_uniformStats.sets++;
+
+    // Hoisted uniforms are computed from the shadow copy
+    bool shadow = (m_shadowUniforms || !m_hoistedSlots.empty());
+    if (shadow && location < static_cast<GLint>(m_shadowSlotByLocation.size())) {
+        int slotIndex = m_shadowSlotByLocation[location];
+        // Samplers and images have no slot, and values of another type than
+        // the slot's are uploaded directly
+        if (slotIndex != -1 && IsShadowCompatible(m_shadowSlots[slotIndex].type, type)) {
+            ShadowSlot &slot = m_shadowSlots[slotIndex];
+            unsigned char *shadow = &m_shadowData[slot.offset];
+            if (slot.valid && std::memcmp(shadow, data, size) == 0) {
+                return;
+            }
+            std::memcpy(shadow, data, size);
+            slot.valid = true;
+            if (!slot.dirty) {
+                slot.dirty = true;
+                m_dirtySlots.push_back(slotIndex);
+            }
+            return;
+        }
+    }
+
+    _UploadUniform(location, type, data);
+}
+
+void GLSLProgram::_UploadUniform(GLint location, GLenum type, const void *data)
+{
+    if (location >= m_virtualLocationBase) {
+        return;
+    }
+    const GLfloat *floats = static_cast<const GLfloat *>(data);
+    switch (type) {
+        case GL_FLOAT:      glProgramUniform1fv(m_handle, location, 1, floats); break;
+        case GL_FLOAT_VEC2: glProgramUniform2fv(m_handle, location, 1, floats); break;
+        case GL_FLOAT_VEC3: glProgramUniform3fv(m_handle, location, 1, floats); break;
+        case GL_FLOAT_VEC4: glProgramUniform4fv(m_handle, location, 1, floats); break;
+        case GL_FLOAT_MAT3: glProgramUniformMatrix3fv(m_handle, location, 1, GL_FALSE, floats); break;
+        case GL_FLOAT_MAT4: glProgramUniformMatrix4fv(m_handle, location, 1, GL_FALSE, floats); break;
+        default:            glProgramUniform1iv(m_handle, location, 1, static_cast<const GLint *>(data)); break;
+    }
+    m_uniformStats.issued++;
 }
 
 void GLSLProgram::PrintActiveUniforms()
@@ -343,4 +1071,37 @@ void GLSLProgram::PrintActiveAttribs()
 
         printf("  [%d] %s (%s)\n", results[2], &name[0], OglTypeToString(results[1]));
     }
-}
\ No newline at end of file
+}
+
+void GLSLProgram::PrintActiveUniformBlocks()
+{
+    std::cout << "Program uniform blocks:" << std::endl;
+    GLint blockNum;
+    glGetProgramInterfaceiv(m_handle, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &blockNum);
+    GLenum blockProps[] = { GL_NAME_LENGTH, GL_BUFFER_BINDING, GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES };
+    GLenum activeVarsProp = GL_ACTIVE_VARIABLES;
+    GLenum uniformProps[] = { GL_NAME_LENGTH, GL_TYPE, GL_OFFSET };
+    for (int i = 0; i < blockNum; i++) {
+        GLint results[4];
+        glGetProgramResourceiv(m_handle, GL_UNIFORM_BLOCK, i, 4, blockProps, 4, nullptr, results);
+
+        std::vector<char> name(results[0] + 1);
+        glGetProgramResourceName(m_handle, GL_UNIFORM_BLOCK, i, static_cast<GLsizei>(name.size()), nullptr, &name[0]);
+        printf("  %s (binding %d, %d bytes)\n", &name[0], results[1], results[2]);
+
+        GLint varNum = results[3];
+        if (varNum <= 0) {
+            continue;
+        }
+        std::vector<GLint> vars(varNum);
+        glGetProgramResourceiv(m_handle, GL_UNIFORM_BLOCK, i, 1, &activeVarsProp, varNum, nullptr, &vars[0]);
+        for (int j = 0; j < varNum; j++) {
+            GLint varResults[3];
+            glGetProgramResourceiv(m_handle, GL_UNIFORM, vars[j], 3, uniformProps, 3, nullptr, varResults);
+
+            std::vector<char> varName(varResults[0] + 1);
+            glGetProgramResourceName(m_handle, GL_UNIFORM, vars[j], static_cast<GLsizei>(varName.size()), nullptr, &varName[0]);
+            printf("    +%d %s (%s)\n", varResults[2], &varName[0], OglTypeToString(varResults[1]));
+        }
+    }
+}
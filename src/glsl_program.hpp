@@ -3,9 +3,22 @@
 
 #include <GL/glew.h>
 #include <glm/glm.hpp>
-#include <map>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 #include "glsl_exception.hpp"
+#include "glsl_preprocessor.hpp"
+#include "glsl_uniform.hpp"
+#include "glsl_uniform_hoisting.hpp"
+
+class GLSLProgramCache;
+class GLSLShaderCache;
+class UniformBlockBindings;
+
+// Whether the driver compiles and links in the background
+// (GL_ARB_parallel_shader_compile or GL_KHR_parallel_shader_compile)
+bool HasParallelShaderCompile();
 
 enum class GLSLShaderType
 {
@@ -17,45 +30,247 @@ enum class GLSLShaderType
     COMPUTE         = GL_COMPUTE_SHADER,
 };
 
+// Number of SetUniform() calls and of glUniform* calls actually issued
+struct GLSLUniformStats
+{
+    GLSLUniformStats() : sets(0), issued(0) {}
+
+    unsigned long long Skipped() const { return sets - issued; }
+
+    unsigned long long sets;
+    unsigned long long issued;
+};
+
 class GLSLProgram
 {
 public:
     GLSLProgram();
     ~GLSLProgram();
 
+    GLSLProgram(const GLSLProgram &) = delete;
+    GLSLProgram & operator=(const GLSLProgram &) = delete;
+
+    // Sources are run through a preprocessor (a default one without include
+    // paths unless set) with the program's defines. Both must be set before
+    // compiling shaders.
+    void SetPreprocessor(const GLSLPreprocessor *preprocessor) { m_preprocessor = preprocessor; }
+    void SetDefines(const GLSLDefines &defines) { m_defines = defines; }
+    const GLSLDefines & Defines() const { return m_defines; }
+
     void CompileShader(const char *file);
     void CompileShader(const char *file, GLSLShaderType type);
     void CompileShader(const std::string &source, GLSLShaderType type, const char *fileName = nullptr);
 
+    // Link binaries through an on-disk cache. Compilation is skipped entirely
+    // when a matching binary is found.
+    void SetBinaryCache(GLSLProgramCache *cache) { m_cache = cache; }
+    // Share shader objects with other programs compiled through the same
+    // cache. Must be set before compiling shaders.
+    void SetShaderCache(GLSLShaderCache *shaderCache) { m_shaderCache = shaderCache; }
+
+    // Rewrite expressions that only depend on uniforms, such as
+    // inverse(ModelViewMatrix), into uniforms computed on the CPU when
+    // uniforms are flushed (see HoistUniformExpressions()). Their operands
+    // stay settable even when no longer used by the shaders. Uniforms are
+    // then always shadowed, since the CPU copies are the operands. Must be
+    // set before compiling shaders.
+    void SetUniformHoisting(bool hoist) { m_hoistUniforms = hoist; }
+    bool IsUniformHoistingEnabled() const { return m_hoistUniforms; }
+    const std::vector<GLSLHoistedUniform> & HoistedUniforms() const { return m_hoistedUniforms; }
+
+    // A separable program holds a subset of the pipeline stages and is
+    // combined with others in a GLSLPipeline. Must be set before linking.
+    void SetSeparable(bool separable);
+    bool IsSeparable() const { return m_separable; }
+    // GL_*_SHADER_BIT flags of the program's stages
+    GLbitfield GetStageBits() const;
+
+    // Shader sources are only recorded by CompileShader(). Link() compiles
+    // them, links the program and checks the result. SubmitLink() only issues
+    // the compile and link commands, and FinishLink() collects the status, so
+    // that many programs can be submitted before waiting on any of them.
+    // Shader objects are detached and released once the program is linked.
     void Link();
+    void SubmitLink();
+    bool IsLinkComplete();
+    void FinishLink();
     void Use();
+    // Unbind the program bound by Use(), if any, so that a bound pipeline
+    // takes effect. Cheaper than glUseProgram(0) before every draw.
+    static void UseNone();
     //void Validate() throw(GLSLException);
 
+    // Compute programs: use the program, flush shadowed uniforms and launch
+    // work groups. DispatchThreads() launches enough groups along X for
+    // threadNum invocations; the shader must skip the ones past the end.
+    // Memory barriers are up to the caller.
+    void Dispatch(GLuint groupNumX, GLuint groupNumY = 1, GLuint groupNumZ = 1);
+    void DispatchThreads(GLuint threadNum);
+    // local_size_x/y/z declared by the linked compute shader
+    glm::uvec3 GetWorkGroupSize() const;
+
+    // Create an unlinked program with the same stages (re-read from their
+    // files), attribute locations, binary and shader caches, preprocessor,
+    // defines, separable flag, uniform shadowing and hoisting modes
+    std::unique_ptr<GLSLProgram> CreateReloaded() const;
+    // Shader files, including the files they include
+    std::vector<std::string> GetSourceFiles() const;
+
+    // Exchange the GL program and all of its state with another program.
+    // Uniform statistics stay with each object.
+    void Swap(GLSLProgram &other);
+
     GLuint Handle() const { return m_handle; }
+    // Unique to the GL program, so it changes when Swap() replaces it
+    uint64_t Generation() const { return m_generation; }
     bool IsLinked() const { return m_linked; }
+    bool IsLoadedFromCache() const { return m_loadedFromCache; }
 
     void BindAttribLocation(GLuint location, const char *name);
     //void BindFragDataLocation(GLuint location, const char *name);
 
-    void SetUniform(const char *name, float x, float y, float z);
-    void SetUniform(const char *name, const glm::vec3 &v);
-    void SetUniform(const char *name, const glm::vec4 &v);
-    void SetUniform(const char *name, const glm::mat3 &m);
-    void SetUniform(const char *name, const glm::mat4 &m);
-    void SetUniform(const char *name, float val);
-    void SetUniform(const char *name, int val);
-    //void SetUniform(const char *name, bool val);
+    // Active uniforms are reflected into a table sorted by name hash when
+    // the program is linked, so setting a uniform by name costs a binary
+    // search and no allocations. Resolving a typed handle once avoids even
+    // that; it throws if the uniform has a different type.
+    template <typename T>
+    GLSLUniform<T> GetUniform(GLSLUniformName name) const
+    {
+        return GLSLUniform<T>(_GetUniformLocation(name, GLSLUniformType<T>::value));
+    }
+
+    void SetUniform(GLSLUniformName name, float x, float y, float z);
+    void SetUniform(GLSLUniformName name, const glm::vec3 &v);
+    void SetUniform(GLSLUniformName name, const glm::vec4 &v);
+    void SetUniform(GLSLUniformName name, const glm::mat3 &m);
+    void SetUniform(GLSLUniformName name, const glm::mat4 &m);
+    void SetUniform(GLSLUniformName name, float val);
+    void SetUniform(GLSLUniformName name, int val);
+    //void SetUniform(GLSLUniformName name, bool val);
+
+    void SetUniform(GLSLUniform<glm::vec3> uniform, const glm::vec3 &v);
+    void SetUniform(GLSLUniform<glm::vec4> uniform, const glm::vec4 &v);
+    void SetUniform(GLSLUniform<glm::mat3> uniform, const glm::mat3 &m);
+    void SetUniform(GLSLUniform<glm::mat4> uniform, const glm::mat4 &m);
+    void SetUniform(GLSLUniform<float> uniform, float val);
+    void SetUniform(GLSLUniform<int> uniform, int val);
+
+    // With shadowing enabled, SetUniform() only records values in a CPU-side
+    // copy and skips those equal to the last one set. Changed values reach GL
+    // at the next FlushUniforms(), which must be called before drawing.
+    void EnableUniformShadowing(bool enable);
+    bool IsUniformShadowingEnabled() const { return m_shadowUniforms; }
+    void FlushUniforms();
+
+    const GLSLUniformStats & UniformStats() const { return m_uniformStats; }
+    void ResetUniformStats() { m_uniformStats = GLSLUniformStats(); }
+
+    // Uniform blocks are reflected at link time as well. A block size of 0
+    // means the block is not active.
+    GLint GetUniformBlockSize(GLSLUniformName name) const;
+    void BindUniformBlock(GLSLUniformName name, GLuint binding);
+    // Bind every active block to the binding point shared for its name
+    void BindUniformBlocks(UniformBlockBindings &bindings);
 
     void PrintActiveUniforms();
     void PrintActiveAttribs();
-    // TODO: void PrintActiveUniformBlocks();
+    void PrintActiveUniformBlocks();
 
 private:
-    GLuint _GetUniformLocation(const char *name);
+    struct ShaderSource
+    {
+        GLSLShaderType type;
+        std::string source;
+        std::string fileName;
+        std::vector<std::string> files;
+        std::vector<GLSLHoistedUniform> hoistedUniforms;
+    };
+
+    struct AttribLocation
+    {
+        GLuint location;
+        std::string name;
+    };
+
+    struct UniformInfo
+    {
+        uint64_t hash;
+        GLint location;
+        GLenum type;
+
+        bool operator<(const UniformInfo &other) const { return hash < other.hash; }
+    };
+
+    struct UniformBlockInfo
+    {
+        uint64_t hash;
+        GLuint index;
+        GLint dataSize;
+    };
+
+    struct ShadowSlot
+    {
+        GLint location;
+        GLenum type;
+        size_t offset;
+        size_t size;
+        bool valid;
+        bool dirty;
+    };
+
+    // Shadow slots of a hoisted uniform and its operands
+    struct HoistedSlot
+    {
+        size_t uniform;
+        int slot;
+        int operandSlots[2];
+    };
+
+    void _AddSource(const ShaderSource &shaderSource);
+    GLuint _SubmitShader(size_t index);
+    void _ReleaseShaders();
+    void _CheckShader(GLuint shader, const ShaderSource &shaderSource);
+    uint64_t _GetCacheKey() const;
+    void _ReflectUniforms();
+    void _ReflectUniformBlocks();
+    const UniformBlockInfo * _FindUniformBlock(GLSLUniformName name) const;
+    void _ResetShadow();
+    void _ResolveHoistedUniforms();
+    void _UpdateHoistedUniforms();
+    const UniformInfo * _FindUniform(GLSLUniformName name) const;
+    GLint _GetUniformLocation(GLSLUniformName name) const;
+    GLint _GetUniformLocation(GLSLUniformName name, GLenum type) const;
+    void _SetUniform(GLint location, GLenum type, const void *data, size_t size);
+    void _UploadUniform(GLint location, GLenum type, const void *data);
 
     GLuint m_handle;
+    uint64_t m_generation;
     bool m_linked;
-    std::map<std::string, int> m_uniformLocations;
+    bool m_loadedFromCache;
+    bool m_separable;
+    GLSLProgramCache *m_cache;
+    uint64_t m_cacheKey;
+    GLSLShaderCache *m_shaderCache;
+    const GLSLPreprocessor *m_preprocessor;
+    GLSLDefines m_defines;
+    std::vector<ShaderSource> m_sources;
+    std::vector<GLuint> m_shaders;
+    std::vector<uint64_t> m_shaderKeys;
+    std::vector<AttribLocation> m_attribLocations;
+    std::vector<UniformInfo> m_uniforms;
+    std::vector<UniformBlockInfo> m_uniformBlocks;
+    bool m_shadowUniforms;
+    std::vector<ShadowSlot> m_shadowSlots;
+    std::vector<int> m_shadowSlotByLocation;
+    std::vector<unsigned char> m_shadowData;
+    std::vector<size_t> m_dirtySlots;
+    bool m_hoistUniforms;
+    std::vector<GLSLHoistedUniform> m_hoistedUniforms;
+    std::vector<HoistedSlot> m_hoistedSlots;
+    // Locations from here on are not active in GL: operands of hoisted
+    // uniforms only kept on the CPU
+    GLint m_virtualLocationBase;
+    GLSLUniformStats m_uniformStats;
 };
 
 #endif
@@ -0,0 +1,193 @@
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "glsl_program_cache.hpp"
+#include "hash.hpp"
+#include "trace.hpp"
+
+static const uint32_t CACHE_FILE_MAGIC = 0x43505347; // "GSPC"
+static const uint32_t CACHE_FILE_VERSION = 1;
+static const char CACHE_FILE_EXTENSION[] = ".bin";
+
+struct CacheFileHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t driverHash;
+    uint64_t key;
+    uint32_t format;
+    uint32_t length;
+};
+
+static uint64_t HashGLString(GLenum name, uint64_t hash)
+{
+    const GLubyte *str = glGetString(name);
+    return HashString(str ? reinterpret_cast<const char *>(str) : "", hash);
+}
+
+static bool ReadHeader(std::ifstream &ifs, CacheFileHeader &header)
+{
+    ifs.read(reinterpret_cast<char *>(&header), sizeof(header));
+    return ifs && header.magic == CACHE_FILE_MAGIC && header.version == CACHE_FILE_VERSION;
+}
+
+GLSLProgramCache::GLSLProgramCache(const std::string &directory) :
+    m_directory(directory),
+    m_driverHash(HASH_OFFSET_BASIS),
+    m_supported(false),
+    m_hits(0),
+    m_misses(0)
+{
+    m_driverHash = HashGLString(GL_VENDOR, m_driverHash);
+    m_driverHash = HashGLString(GL_RENDERER, m_driverHash);
+    m_driverHash = HashGLString(GL_VERSION, m_driverHash);
+
+    GLint formatNum = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatNum);
+    if (formatNum <= 0) {
+        return;
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::create_directories(m_directory, ec);
+    if (ec) {
+        return;
+    }
+
+    m_supported = true;
+    _RemoveStaleFiles();
+}
+
+bool GLSLProgramCache::Load(GLuint program, uint64_t key)
+{
+    if (!m_supported) {
+        return false;
+    }
+    TraceZone zone("load binary", "shader");
+
+    boost::filesystem::path path = _GetPath(key);
+    std::ifstream ifs(path.string().c_str(), std::ios::binary);
+    if (!ifs) {
+        m_misses++;
+        return false;
+    }
+
+    CacheFileHeader header;
+    // An empty binary can only come from a corrupt file
+    bool valid = ReadHeader(ifs, header) && header.driverHash == m_driverHash && header.key == key && header.length > 0;
+    std::vector<char> binary;
+    if (valid) {
+        binary.resize(header.length);
+        ifs.read(binary.data(), header.length);
+        valid = static_cast<bool>(ifs);
+    }
+    ifs.close();
+
+    if (valid) {
+        glProgramBinary(program, header.format, binary.data(), header.length);
+        GLint linkStatus;
+        glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+        valid = (linkStatus != 0);
+    }
+
+    // The driver is free to reject binaries (e.g. after an update that kept
+    // the version string), so a failed load just drops the file
+    if (!valid) {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+        m_misses++;
+        return false;
+    }
+
+    m_hits++;
+    return true;
+}
+
+void GLSLProgramCache::Store(GLuint program, uint64_t key)
+{
+    if (!m_supported) {
+        return;
+    }
+    TraceZone zone("store binary", "shader");
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format;
+    glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+    CacheFileHeader header;
+    header.magic = CACHE_FILE_MAGIC;
+    header.version = CACHE_FILE_VERSION;
+    header.driverHash = m_driverHash;
+    header.key = key;
+    header.format = format;
+    header.length = static_cast<uint32_t>(length);
+
+    // Write to a temporary file first, so that a crash never leaves a
+    // truncated binary under a valid name
+    boost::filesystem::path path = _GetPath(key);
+    boost::filesystem::path tmpPath = path;
+    tmpPath += ".tmp";
+    {
+        std::ofstream ofs(tmpPath.string().c_str(), std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        ofs.write(binary.data(), length);
+        if (!ofs) {
+            return;
+        }
+    }
+
+    boost::system::error_code ec;
+    boost::filesystem::rename(tmpPath, path, ec);
+    if (ec) {
+        boost::filesystem::remove(tmpPath, ec);
+    }
+}
+
+void GLSLProgramCache::Clear()
+{
+    if (!m_supported) {
+        return;
+    }
+
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(m_directory, ec), end; it != end; it.increment(ec)) {
+        if (it->path().extension() == CACHE_FILE_EXTENSION) {
+            boost::filesystem::remove(it->path(), ec);
+        }
+    }
+}
+
+boost::filesystem::path GLSLProgramCache::_GetPath(uint64_t key) const
+{
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << CACHE_FILE_EXTENSION;
+    return m_directory / name.str();
+}
+
+void GLSLProgramCache::_RemoveStaleFiles()
+{
+    boost::system::error_code ec;
+    std::vector<boost::filesystem::path> stale;
+    for (boost::filesystem::directory_iterator it(m_directory, ec), end; it != end; it.increment(ec)) {
+        if (it->path().extension() != CACHE_FILE_EXTENSION) {
+            continue;
+        }
+
+        std::ifstream ifs(it->path().string().c_str(), std::ios::binary);
+        CacheFileHeader header;
+        if (!ReadHeader(ifs, header) || header.driverHash != m_driverHash) {
+            stale.push_back(it->path());
+        }
+    }
+
+    for (size_t i = 0; i < stale.size(); i++) {
+        boost::filesystem::remove(stale[i], ec);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef GLSL_PROGRAM_CACHE_HPP
+#define GLSL_PROGRAM_CACHE_HPP
+
+#include <GL/glew.h>
+#include <boost/filesystem.hpp>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// On-disk cache of linked program binaries (glGetProgramBinary/glProgramBinary).
+// Must be created with a current OpenGL context: the driver identity (vendor,
+// renderer and version strings) is part of every key, and cache files written
+// by a different driver are removed on construction. Load() may be called from
+// worker threads with a shared context.
+class GLSLProgramCache
+{
+public:
+    explicit GLSLProgramCache(const std::string &directory);
+
+    bool IsSupported() const { return m_supported; }
+    uint64_t DriverHash() const { return m_driverHash; }
+
+    // Try to load a binary for the key into the program. On success the
+    // program is linked and ready to use.
+    bool Load(GLuint program, uint64_t key);
+
+    // Store the binary of a successfully linked program
+    void Store(GLuint program, uint64_t key);
+
+    // Remove every cache file
+    void Clear();
+
+    unsigned long Hits() const { return m_hits; }
+    unsigned long Misses() const { return m_misses; }
+
+private:
+    boost::filesystem::path _GetPath(uint64_t key) const;
+    void _RemoveStaleFiles();
+
+    boost::filesystem::path m_directory;
+    uint64_t m_driverHash;
+    bool m_supported;
+    std::atomic<unsigned long> m_hits;
+    std::atomic<unsigned long> m_misses;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "glsl_exception.hpp"
+#include "glsl_shader_cache.hpp"
+#include "hash.hpp"
+
+GLSLShaderCache::GLSLShaderCache() :
+    m_mutex(),
+    m_compiled(),
+    m_entries(),
+    m_liveShaderNum(0),
+    m_peakLiveShaderNum(0),
+    m_liveShaderBytes(0),
+    m_compiles(0),
+    m_reuses(0)
+{
+}
+
+GLSLShaderCache::~GLSLShaderCache()
+{
+    for (std::unordered_map<uint64_t, Entry>::iterator it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->second.shader != 0) {
+            glDeleteShader(it->second.shader);
+            glDeleteSync(it->second.fence);
+        }
+    }
+}
+
+uint64_t GLSLShaderCache::Acquire(GLenum type, const std::string &source)
+{
+    uint64_t key = HashString(source, HashValue(type));
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<uint64_t, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        Entry entry;
+        entry.type = type;
+        entry.size = source.length();
+        entry.refs = 0;
+        entry.shader = 0;
+        entry.fence = nullptr;
+        entry.compiling = false;
+        it = m_entries.insert(std::make_pair(key, entry)).first;
+    }
+    it->second.refs++;
+    return key;
+}
+
+GLuint GLSLShaderCache::Compile(uint64_t key, const std::string &source)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    std::unordered_map<uint64_t, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end()) {
+        throw GLSLException("Compiling a shader that was not acquired");
+    }
+    // Entries do not move on rehash, and a referenced entry is not erased
+    Entry &entry = it->second;
+
+    if (entry.shader != 0) {
+        m_compiled.wait(lock, [&entry] { return !entry.compiling; });
+        m_reuses++;
+        // The compile may have been issued in another context
+        glWaitSync(entry.fence, 0, GL_TIMEOUT_IGNORED);
+        return entry.shader;
+    }
+
+    GLuint shader = glCreateShader(entry.type);
+    if (shader == 0) {
+        throw GLSLException("Failed to create shader");
+    }
+    entry.shader = shader;
+    entry.compiling = true;
+    m_compiles++;
+    m_liveShaderNum++;
+    m_liveShaderBytes += entry.size;
+    if (m_liveShaderNum > m_peakLiveShaderNum) {
+        m_peakLiveShaderNum = m_liveShaderNum;
+    }
+
+    // Other threads may compile different shaders meanwhile
+    lock.unlock();
+    const GLchar *sourcePtr = source.c_str();
+    GLint sourceLen = static_cast<GLint>(source.length());
+    glShaderSource(shader, 1, &sourcePtr, &sourceLen);
+    glCompileShader(shader);
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    lock.lock();
+
+    entry.fence = fence;
+    entry.compiling = false;
+    m_compiled.notify_all();
+    return shader;
+}
+
+void GLSLShaderCache::Release(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<uint64_t, Entry>::iterator it = m_entries.find(key);
+    if (it == m_entries.end() || --it->second.refs > 0) {
+        return;
+    }
+
+    if (it->second.shader != 0) {
+        glDeleteShader(it->second.shader);
+        glDeleteSync(it->second.fence);
+        m_liveShaderNum--;
+        m_liveShaderBytes -= it->second.size;
+    }
+    m_entries.erase(it);
+}
+
+size_t GLSLShaderCache::LiveShaderNum() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_liveShaderNum;
+}
+
+size_t GLSLShaderCache::PeakLiveShaderNum() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peakLiveShaderNum;
+}
+
+size_t GLSLShaderCache::LiveShaderBytes() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_liveShaderBytes;
+}
+
+unsigned long GLSLShaderCache::Compiles() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_compiles;
+}
+
+unsigned long GLSLShaderCache::Reuses() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reuses;
+}
@@ -0,0 +1,60 @@
+#ifndef GLSL_SHADER_CACHE_HPP
+#define GLSL_SHADER_CACHE_HPP
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Shader objects shared between programs, keyed by stage and preprocessed
+// source (which includes the defines). A program references an entry when
+// it records a shader, compiles it at most once when linking and drops the
+// reference after the link. The last reference deletes the shader object.
+class GLSLShaderCache
+{
+public:
+    GLSLShaderCache();
+    ~GLSLShaderCache();
+
+    GLSLShaderCache(const GLSLShaderCache &) = delete;
+    GLSLShaderCache & operator=(const GLSLShaderCache &) = delete;
+
+    uint64_t Acquire(GLenum type, const std::string &source);
+    // Issues the compile on the first call and returns the shared object on
+    // later ones. May be called from any context sharing objects with the
+    // one that compiled it.
+    GLuint Compile(uint64_t key, const std::string &source);
+    void Release(uint64_t key);
+
+    size_t LiveShaderNum() const;
+    size_t PeakLiveShaderNum() const;
+    // Source bytes held by the live shader objects. GL does not report the
+    // size of compiled code, so this is a lower bound of their memory.
+    size_t LiveShaderBytes() const;
+    unsigned long Compiles() const;
+    unsigned long Reuses() const;
+
+private:
+    struct Entry
+    {
+        GLenum type;
+        size_t size;
+        unsigned refs;
+        GLuint shader;
+        GLsync fence;
+        bool compiling;
+    };
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_compiled;
+    std::unordered_map<uint64_t, Entry> m_entries;
+    size_t m_liveShaderNum;
+    size_t m_peakLiveShaderNum;
+    size_t m_liveShaderBytes;
+    unsigned long m_compiles;
+    unsigned long m_reuses;
+};
+
+#endif
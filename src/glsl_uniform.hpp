@@ -0,0 +1,68 @@
+#ifndef GLSL_UNIFORM_HPP
+#define GLSL_UNIFORM_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <type_traits>
+#include "hash.hpp"
+
+// Uniform name reduced to its hash. The compiler may hash string literals
+// at compile time, but only GLSL_UNIFORM_NAME() makes sure of it; other
+// strings are hashed when the name is constructed.
+class GLSLUniformName
+{
+public:
+    template <size_t N>
+    constexpr GLSLUniformName(const char (&name)[N]) : m_hash(HashLiteral(name)) {}
+
+    // A template, so that literals prefer the array overload above
+    template <typename T, typename = typename std::enable_if<std::is_same<T, const char *>::value || std::is_same<T, char *>::value>::type>
+    GLSLUniformName(T name) : m_hash(HashCString(name)) {}
+
+    static constexpr GLSLUniformName FromHash(uint64_t hash)
+    {
+        return GLSLUniformName(hash, 0);
+    }
+
+    constexpr uint64_t Hash() const { return m_hash; }
+
+private:
+    constexpr GLSLUniformName(uint64_t hash, int) : m_hash(hash) {}
+
+    uint64_t m_hash;
+};
+
+// Name of a string literal, hashed as a template argument and thus at
+// compile time, for uniforms set by name in hot paths
+#define GLSL_UNIFORM_NAME(literal) \
+    GLSLUniformName::FromHash(std::integral_constant<uint64_t, HashLiteral(literal)>::value)
+
+// GL type of the values accepted by a typed uniform handle
+template <typename T> struct GLSLUniformType;
+template <> struct GLSLUniformType<float>     { static const GLenum value = GL_FLOAT; };
+template <> struct GLSLUniformType<int>       { static const GLenum value = GL_INT; };
+template <> struct GLSLUniformType<glm::vec3> { static const GLenum value = GL_FLOAT_VEC3; };
+template <> struct GLSLUniformType<glm::vec4> { static const GLenum value = GL_FLOAT_VEC4; };
+template <> struct GLSLUniformType<glm::mat3> { static const GLenum value = GL_FLOAT_MAT3; };
+template <> struct GLSLUniformType<glm::mat4> { static const GLenum value = GL_FLOAT_MAT4; };
+
+// Resolved uniform location of a known type. Obtained from
+// GLSLProgram::GetUniform() and valid until the program is linked again or
+// swapped. A handle for a uniform that is not active is silently ignored,
+// like location -1 in glUniform*().
+template <typename T>
+class GLSLUniform
+{
+public:
+    GLSLUniform() : m_location(-1) {}
+    explicit GLSLUniform(GLint location) : m_location(location) {}
+
+    GLint Location() const { return m_location; }
+    bool IsActive() const { return m_location != -1; }
+
+private:
+    GLint m_location;
+};
+
+#endif
@@ -0,0 +1,377 @@
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <set>
+#include "glsl_uniform_hoisting.hpp"
+
+// Source split into tokens, each owning the whitespace, comments and
+// preprocessor lines before it. Rewritten tokens get empty text, hoisted
+// declarations are appended as a suffix.
+struct SourceToken
+{
+    std::string leading;
+    std::string text;
+    std::string suffix;
+};
+
+struct UniformEntry
+{
+    GLSLUniformDecl decl;
+    // Token ending the declaration, after which uniforms computed from this
+    // one are declared
+    size_t declEnd;
+    int declNum;
+    bool shadowed;
+};
+
+static bool IsIdentifierStart(char c)
+{
+    return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static bool IsIdentifierChar(char c)
+{
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+static bool IsIdentifier(const std::string &text)
+{
+    return !text.empty() && IsIdentifierStart(text[0]);
+}
+
+static size_t SkipLine(const std::string &source, size_t pos)
+{
+    // Preprocessor lines continue past escaped line ends
+    while (pos < source.size() && source[pos] != '\n') {
+        if (source[pos] == '\\' && pos + 1 < source.size() && source[pos + 1] == '\n') {
+            pos++;
+        }
+        pos++;
+    }
+    return pos;
+}
+
+static std::vector<SourceToken> Tokenize(const std::string &source)
+{
+    static const char *const PUNCTUATORS[] = {
+        "<<=", ">>=", "++", "--", "<<", ">>", "<=", ">=", "==", "!=", "&&", "||", "^^",
+        "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+    };
+
+    std::vector<SourceToken> tokens;
+    SourceToken token;
+    bool lineStart = true;
+    size_t pos = 0;
+    while (pos < source.size()) {
+        char c = source[pos];
+        size_t start = pos;
+        if (c == '\n') {
+            lineStart = true;
+            pos++;
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            pos++;
+        } else if (c == '#' && lineStart) {
+            pos = SkipLine(source, pos);
+        } else if (source.compare(pos, 2, "//") == 0) {
+            pos = SkipLine(source, pos);
+        } else if (source.compare(pos, 2, "/*") == 0) {
+            size_t end = source.find("*/", pos + 2);
+            pos = (end == std::string::npos ? source.size() : end + 2);
+        } else {
+            lineStart = false;
+            if (IsIdentifierStart(c)) {
+                while (pos < source.size() && IsIdentifierChar(source[pos])) {
+                    pos++;
+                }
+            } else if (std::isdigit(static_cast<unsigned char>(c)) || (c == '.' && pos + 1 < source.size() && std::isdigit(static_cast<unsigned char>(source[pos + 1])))) {
+                while (pos < source.size() && (IsIdentifierChar(source[pos]) || source[pos] == '.' ||
+                       ((source[pos] == '+' || source[pos] == '-') && (source[pos - 1] == 'e' || source[pos - 1] == 'E')))) {
+                    pos++;
+                }
+            } else {
+                pos++;
+                for (size_t i = 0; i < sizeof(PUNCTUATORS) / sizeof(PUNCTUATORS[0]); i++) {
+                    size_t length = std::strlen(PUNCTUATORS[i]);
+                    if (source.compare(start, length, PUNCTUATORS[i]) == 0) {
+                        pos = start + length;
+                        break;
+                    }
+                }
+            }
+            token.text = source.substr(start, pos - start);
+            tokens.push_back(token);
+            token = SourceToken();
+            continue;
+        }
+        token.leading.append(source, start, pos - start);
+    }
+    // Trailing whitespace and comments
+    tokens.push_back(token);
+    return tokens;
+}
+
+static GLenum ParseType(const std::string &name)
+{
+    if (name == "mat3") {
+        return GL_FLOAT_MAT3;
+    } else if (name == "mat4") {
+        return GL_FLOAT_MAT4;
+    } else if (name == "vec3") {
+        return GL_FLOAT_VEC3;
+    } else if (name == "vec4") {
+        return GL_FLOAT_VEC4;
+    }
+    return GL_NONE;
+}
+
+static const char * TypeName(GLenum type)
+{
+    switch (type) {
+        case GL_FLOAT_MAT3: return "mat3";
+        case GL_FLOAT_MAT4: return "mat4";
+        case GL_FLOAT_VEC3: return "vec3";
+        default:            return "vec4";
+    }
+}
+
+static const char * OpName(GLSLHoistedOp op)
+{
+    switch (op) {
+        case GLSLHoistedOp::INVERSE:   return "Inverse";
+        case GLSLHoistedOp::TRANSPOSE: return "Transpose";
+        case GLSLHoistedOp::MAT3:      return "Mat3";
+        default:                       return "Multiply";
+    }
+}
+
+// "Hoisted<Op>_" followed by each operand name prefixed with its length, so
+// that different expressions never share a name ("A_B * C" and "A * B_C"
+// become HoistedMultiply_3A_B1C and HoistedMultiply_1A3B_C)
+static std::string HoistedName(GLSLHoistedOp op, const GLSLUniformDecl &a, const GLSLUniformDecl *b)
+{
+    std::string name = std::string("Hoisted") + OpName(op) + "_" + std::to_string(a.name.size()) + a.name;
+    if (b) {
+        name += std::to_string(b->name.size()) + b->name;
+    }
+    return name;
+}
+
+static GLenum ResultType(GLSLHoistedOp op, GLenum a, GLenum b)
+{
+    bool matrix = (a == GL_FLOAT_MAT3 || a == GL_FLOAT_MAT4);
+    switch (op) {
+        case GLSLHoistedOp::INVERSE:
+        case GLSLHoistedOp::TRANSPOSE:
+            return matrix ? a : GL_NONE;
+        case GLSLHoistedOp::MAT3:
+            return a == GL_FLOAT_MAT4 ? GL_FLOAT_MAT3 : GL_NONE;
+        default:
+            if (a == GL_FLOAT_MAT4 && (b == GL_FLOAT_MAT4 || b == GL_FLOAT_VEC4)) {
+                return b;
+            } else if (a == GL_FLOAT_MAT3 && (b == GL_FLOAT_MAT3 || b == GL_FLOAT_VEC3)) {
+                return b;
+            }
+            return GL_NONE;
+    }
+}
+
+// Declared uniforms of supported types, marking those declared more than
+// once (e.g. in both branches of an #if) or shadowed by other declarations
+static std::map<std::string, UniformEntry> FindUniforms(const std::vector<SourceToken> &tokens)
+{
+    std::map<std::string, UniformEntry> uniforms;
+    std::vector<bool> declNames(tokens.size(), false);
+    for (size_t i = 0; i < tokens.size(); i++) {
+        if (tokens[i].text != "uniform") {
+            continue;
+        }
+        size_t j = i + 1;
+        while (j < tokens.size() && (tokens[j].text == "lowp" || tokens[j].text == "mediump" || tokens[j].text == "highp")) {
+            j++;
+        }
+        if (j + 1 >= tokens.size() || tokens[j + 1].text == "{") {
+            continue;
+        }
+        GLenum type = ParseType(tokens[j].text);
+
+        // Names up to the end of the declaration, skipping array sizes and
+        // initializers
+        std::vector<size_t> names;
+        for (j++; j < tokens.size() && tokens[j].text != ";"; j++) {
+            if (IsIdentifier(tokens[j].text) && (tokens[j - 1].text == "," || names.empty())) {
+                names.push_back(j);
+                declNames[j] = true;
+            } else if (tokens[j].text == "[" || tokens[j].text == "=") {
+                type = GL_NONE;
+            }
+        }
+        for (size_t k = 0; k < names.size(); k++) {
+            UniformEntry &entry = uniforms[tokens[names[k]].text];
+            entry.decl.name = tokens[names[k]].text;
+            entry.decl.type = type;
+            entry.declEnd = j;
+            entry.declNum++;
+            entry.shadowed = false;
+        }
+    }
+
+    // A uniform name right after another identifier (other than a keyword
+    // starting an expression) declares a local or parameter hiding it
+    for (size_t i = 1; i < tokens.size(); i++) {
+        std::map<std::string, UniformEntry>::iterator it = uniforms.find(tokens[i].text);
+        const std::string &prev = tokens[i - 1].text;
+        if (it != uniforms.end() && !declNames[i] && IsIdentifier(prev) && prev != "return" && prev != "else" && prev != "case") {
+            it->second.shadowed = true;
+        }
+    }
+    return uniforms;
+}
+
+GLSLHoistResult HoistUniformExpressions(const std::string &source)
+{
+    GLSLHoistResult result;
+    std::vector<SourceToken> tokens = Tokenize(source);
+    std::map<std::string, UniformEntry> uniforms = FindUniforms(tokens);
+    std::set<std::string> hoistedNames;
+
+    // Hoisting an expression may turn the one around it uniform-only as well,
+    // so rewrite until nothing changes
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::vector<size_t> live;
+        for (size_t i = 0; i < tokens.size(); i++) {
+            if (!tokens[i].text.empty()) {
+                live.push_back(i);
+            }
+        }
+        std::vector<std::string> texts(live.size() + 2);
+        for (size_t i = 0; i < live.size(); i++) {
+            texts[i + 1] = tokens[live[i]].text;
+        }
+        auto uniformAt = [&](size_t p) -> const UniformEntry * {
+            std::map<std::string, UniformEntry>::const_iterator it = uniforms.find(texts[p]);
+            if (it == uniforms.end() || it->second.decl.type == GL_NONE || it->second.declNum != 1 || it->second.shadowed) {
+                return nullptr;
+            }
+            return &it->second;
+        };
+
+        // texts[p] is live[p - 1], with empty texts padding both ends
+        for (size_t p = 1; p + 3 < texts.size(); p++) {
+            GLSLHoistedOp op;
+            const UniformEntry *a = nullptr;
+            const UniformEntry *b = nullptr;
+            size_t length = 0;
+            const std::string &prev = texts[p - 1];
+            if ((texts[p] == "inverse" || texts[p] == "transpose" || texts[p] == "mat3") && prev != "." &&
+                texts[p + 1] == "(" && texts[p + 3] == ")" && (a = uniformAt(p + 2)) != nullptr) {
+                op = (texts[p] == "inverse" ? GLSLHoistedOp::INVERSE : texts[p] == "transpose" ? GLSLHoistedOp::TRANSPOSE : GLSLHoistedOp::MAT3);
+                length = 4;
+            } else if (texts[p + 1] == "*" && (a = uniformAt(p)) != nullptr && (b = uniformAt(p + 2)) != nullptr) {
+                // Only where the product binds first: not the right operand
+                // of another multiplicative operator, not indexed or called
+                const std::string &next = texts[p + 3];
+                if (prev == "*" || prev == "/" || prev == "%" || prev == "." || prev == "++" || prev == "--" ||
+                    next == "[" || next == "." || next == "++" || next == "--" || next == "(") {
+                    continue;
+                }
+                op = GLSLHoistedOp::MULTIPLY;
+                length = 3;
+            } else {
+                continue;
+            }
+
+            GLenum type = ResultType(op, a->decl.type, b ? b->decl.type : GL_NONE);
+            if (type == GL_NONE) {
+                continue;
+            }
+
+            // A name already hoisted stands for the same expression; one
+            // declared by the source does not
+            std::string name = HoistedName(op, a->decl, b ? &b->decl : nullptr);
+            if (uniforms.find(name) != uniforms.end() && hoistedNames.count(name) == 0) {
+                continue;
+            }
+            if (hoistedNames.insert(name).second) {
+                GLSLHoistedUniform hoisted;
+                hoisted.decl.name = name;
+                hoisted.decl.type = type;
+                hoisted.op = op;
+                hoisted.operands[0] = a->decl;
+                hoisted.operands[1] = (b ? b->decl : GLSLUniformDecl());
+                result.uniforms.push_back(hoisted);
+
+                UniformEntry entry;
+                entry.decl = hoisted.decl;
+                entry.declEnd = std::max(a->declEnd, b ? b->declEnd : 0);
+                entry.declNum = 1;
+                entry.shadowed = false;
+                tokens[entry.declEnd].suffix += std::string(" uniform ") + TypeName(type) + " " + name + ";";
+                uniforms[name] = entry;
+            }
+
+            tokens[live[p - 1]].text = name;
+            for (size_t i = 1; i < length; i++) {
+                tokens[live[p - 1 + i]].text.clear();
+            }
+            p += length - 1;
+            changed = true;
+        }
+    }
+
+    for (size_t i = 0; i < tokens.size(); i++) {
+        result.source += tokens[i].leading;
+        result.source += tokens[i].text;
+        result.source += tokens[i].suffix;
+    }
+    return result;
+}
+
+template <typename T>
+static T LoadValue(const void *data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+template <typename T>
+static void StoreValue(const T &value, void *data)
+{
+    std::memcpy(data, &value, sizeof(value));
+}
+
+void EvaluateHoistedUniform(const GLSLHoistedUniform &uniform, const void *a, const void *b, void *result)
+{
+    bool mat4 = (uniform.operands[0].type == GL_FLOAT_MAT4);
+    switch (uniform.op) {
+        case GLSLHoistedOp::INVERSE:
+            if (mat4) {
+                StoreValue(glm::inverse(LoadValue<glm::mat4>(a)), result);
+            } else {
+                StoreValue(glm::inverse(LoadValue<glm::mat3>(a)), result);
+            }
+            break;
+        case GLSLHoistedOp::TRANSPOSE:
+            if (mat4) {
+                StoreValue(glm::transpose(LoadValue<glm::mat4>(a)), result);
+            } else {
+                StoreValue(glm::transpose(LoadValue<glm::mat3>(a)), result);
+            }
+            break;
+        case GLSLHoistedOp::MAT3:
+            StoreValue(glm::mat3(LoadValue<glm::mat4>(a)), result);
+            break;
+        case GLSLHoistedOp::MULTIPLY:
+            switch (uniform.decl.type) {
+                case GL_FLOAT_MAT4: StoreValue(LoadValue<glm::mat4>(a) * LoadValue<glm::mat4>(b), result); break;
+                case GL_FLOAT_MAT3: StoreValue(LoadValue<glm::mat3>(a) * LoadValue<glm::mat3>(b), result); break;
+                case GL_FLOAT_VEC4: StoreValue(LoadValue<glm::mat4>(a) * LoadValue<glm::vec4>(b), result); break;
+                default:            StoreValue(LoadValue<glm::mat3>(a) * LoadValue<glm::vec3>(b), result); break;
+            }
+            break;
+    }
+}
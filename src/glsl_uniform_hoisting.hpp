@@ -0,0 +1,55 @@
+#ifndef GLSL_UNIFORM_HOISTING_HPP
+#define GLSL_UNIFORM_HOISTING_HPP
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+enum class GLSLHoistedOp
+{
+    INVERSE,
+    TRANSPOSE,
+    MAT3,       // upper-left 3x3 of a mat4
+    MULTIPLY,   // matrix * matrix or matrix * vector
+};
+
+// Default block uniform, declared in the source or generated by hoisting
+struct GLSLUniformDecl
+{
+    std::string name;
+    GLenum type;
+};
+
+// Uniform computed on the CPU from one or two other uniforms
+struct GLSLHoistedUniform
+{
+    GLSLUniformDecl decl;
+    GLSLHoistedOp op;
+    // The second operand is only used by MULTIPLY
+    GLSLUniformDecl operands[2];
+};
+
+struct GLSLHoistResult
+{
+    std::string source;
+    // In dependency order: operands come before the uniforms computed from
+    // them
+    std::vector<GLSLHoistedUniform> uniforms;
+};
+
+// Rewrite expressions of a preprocessed shader source that only depend on
+// uniforms into new uniforms named after the expression (e.g.
+// "HoistedInverse_15ModelViewMatrix"), declared right after their operands on
+// the same line, so that line numbers are kept. Recognized expressions are
+// inverse(), transpose() and mat3() of a matrix uniform and the product of
+// two uniforms, nested to any depth; operands are mat3, mat4, vec3 and vec4
+// uniforms declared once, and not redeclared as locals or parameters.
+// Preprocessor directives are left alone, so code inside #if blocks is
+// rewritten whichever branch is taken.
+GLSLHoistResult HoistUniformExpressions(const std::string &source);
+
+// Compute a hoisted uniform from the values of its operands, laid out as
+// glUniform* takes them
+void EvaluateHoistedUniform(const GLSLHoistedUniform &uniform, const void *a, const void *b, void *result);
+
+#endif
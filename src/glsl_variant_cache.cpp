@@ -0,0 +1,58 @@
+#include "glsl_variant_cache.hpp"
+#include "hash.hpp"
+
+uint64_t GLSLProgramDesc::Key() const
+{
+    uint64_t key = HASH_OFFSET_BASIS;
+    for (size_t i = 0; i < files.size(); i++) {
+        key = HashString(files[i], key);
+    }
+    key = defines.Hash(key);
+    for (size_t i = 0; i < attribLocations.size(); i++) {
+        key = HashValue(attribLocations[i].first, key);
+        key = HashString(attribLocations[i].second, key);
+    }
+    key = HashValue(hoistUniforms, key);
+    return key;
+}
+
+GLSLVariantCache::GLSLVariantCache(const GLSLPreprocessor *preprocessor, GLSLProgramCache *binaryCache,
+                                   GLSLShaderCache *shaderCache) :
+    m_preprocessor(preprocessor),
+    m_binaryCache(binaryCache),
+    m_shaderCache(shaderCache),
+    m_programs()
+{
+}
+
+GLSLProgram & GLSLVariantCache::Get(uint64_t key, const GLSLProgramDesc &desc)
+{
+    std::unordered_map<uint64_t, std::unique_ptr<GLSLProgram>>::iterator it = m_programs.find(key);
+    if (it != m_programs.end()) {
+        return *it->second;
+    }
+
+    std::unique_ptr<GLSLProgram> program(new GLSLProgram);
+    program->SetBinaryCache(m_binaryCache);
+    program->SetShaderCache(m_shaderCache);
+    program->SetPreprocessor(m_preprocessor);
+    program->SetDefines(desc.defines);
+    program->SetUniformHoisting(desc.hoistUniforms);
+    for (size_t i = 0; i < desc.files.size(); i++) {
+        program->CompileShader(desc.files[i].c_str());
+    }
+    for (size_t i = 0; i < desc.attribLocations.size(); i++) {
+        program->BindAttribLocation(desc.attribLocations[i].first, desc.attribLocations[i].second.c_str());
+    }
+    program->Link();
+
+    GLSLProgram &result = *program;
+    m_programs[key] = std::move(program);
+    return result;
+}
+
+GLSLProgram * GLSLVariantCache::Find(uint64_t key) const
+{
+    std::unordered_map<uint64_t, std::unique_ptr<GLSLProgram>>::const_iterator it = m_programs.find(key);
+    return (it == m_programs.end() ? nullptr : it->second.get());
+}
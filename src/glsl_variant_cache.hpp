@@ -0,0 +1,55 @@
+#ifndef GLSL_VARIANT_CACHE_HPP
+#define GLSL_VARIANT_CACHE_HPP
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "glsl_preprocessor.hpp"
+#include "glsl_program.hpp"
+
+class GLSLProgramCache;
+class GLSLShaderCache;
+
+// A program permutation: stage files, defines, attribute locations and
+// whether uniform expressions are hoisted. The key depends on nothing else,
+// so it is stable across runs.
+struct GLSLProgramDesc
+{
+    GLSLProgramDesc() : files(), defines(), attribLocations(), hoistUniforms(false) {}
+
+    std::vector<std::string> files;
+    GLSLDefines defines;
+    std::vector<std::pair<GLuint, std::string>> attribLocations;
+    bool hoistUniforms;
+
+    uint64_t Key() const;
+};
+
+// Linked programs by permutation. The first request for a permutation builds
+// it (loading the binary from the on-disk cache when possible); later ones
+// are a hash lookup.
+class GLSLVariantCache
+{
+public:
+    explicit GLSLVariantCache(const GLSLPreprocessor *preprocessor = nullptr, GLSLProgramCache *binaryCache = nullptr,
+                              GLSLShaderCache *shaderCache = nullptr);
+
+    GLSLProgram & Get(const GLSLProgramDesc &desc) { return Get(desc.Key(), desc); }
+    // For callers that keep the precomputed key of a permutation
+    GLSLProgram & Get(uint64_t key, const GLSLProgramDesc &desc);
+    GLSLProgram * Find(uint64_t key) const;
+
+    size_t Size() const { return m_programs.size(); }
+
+private:
+    const GLSLPreprocessor *m_preprocessor;
+    GLSLProgramCache *m_binaryCache;
+    GLSLShaderCache *m_shaderCache;
+    std::unordered_map<uint64_t, std::unique_ptr<GLSLProgram>> m_programs;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "gpu_culler.hpp"
+
+static GLuint CreateStorageBuffer(GLsizeiptr size, const void *data, GLenum usage)
+{
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, usage);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    return buffer;
+}
+
+GpuCuller::GpuCuller(GLSLProgram &cullProgram, const MeshBatch &batch, const std::vector<SceneObject> &objects) :
+    m_cullProgram(cullProgram),
+    m_batch(batch),
+    m_objectNum(objects.size()),
+    m_resetCommands(),
+    m_objectBuffer(0),
+    m_objectMeshBuffer(0),
+    m_meshSphereBuffer(0),
+    m_commandBuffer(0),
+    m_visibleBuffer(0),
+    m_viewProjectionUniform(cullProgram.GetUniform<glm::mat4>("ViewProjectionMatrix")),
+    m_objectNumUniform(cullProgram.GetUniform<int>("ObjectNum"))
+{
+    std::vector<SceneInstance> instances(objects.size());
+    std::vector<GLuint> objectMeshes(objects.size());
+    std::vector<GLuint> meshObjectNums(batch.MeshNum(), 0);
+    for (size_t i = 0; i < objects.size(); i++) {
+        instances[i] = objects[i].instance;
+        objectMeshes[i] = static_cast<GLuint>(objects[i].meshIndex);
+        meshObjectNums[objects[i].meshIndex]++;
+    }
+
+    // Each mesh gets room for all of its objects in the visible buffer
+    std::vector<glm::vec4> meshSpheres(batch.MeshNum());
+    GLuint baseInstance = 0;
+    for (size_t i = 0; i < batch.MeshNum(); i++) {
+        const MeshSphere &sphere = batch.BoundingSphere(i);
+        meshSpheres[i] = glm::vec4(sphere.center, sphere.radius);
+
+        DrawElementsIndirectCommand command = batch.MeshCommand(i);
+        command.instanceCount = 0;
+        command.baseInstance = baseInstance;
+        m_resetCommands.push_back(command);
+        baseInstance += meshObjectNums[i];
+    }
+
+    GLsizeiptr instanceSize = instances.size() * sizeof(SceneInstance);
+    m_objectBuffer = CreateStorageBuffer(instanceSize, instances.data(), GL_STATIC_DRAW);
+    m_objectMeshBuffer = CreateStorageBuffer(objectMeshes.size() * sizeof(GLuint), objectMeshes.data(), GL_STATIC_DRAW);
+    m_meshSphereBuffer = CreateStorageBuffer(meshSpheres.size() * sizeof(glm::vec4), meshSpheres.data(), GL_STATIC_DRAW);
+    m_commandBuffer = CreateStorageBuffer(m_resetCommands.size() * sizeof(DrawElementsIndirectCommand), m_resetCommands.data(), GL_DYNAMIC_DRAW);
+    m_visibleBuffer = CreateStorageBuffer(instanceSize, nullptr, GL_DYNAMIC_COPY);
+}
+
+GpuCuller::~GpuCuller()
+{
+    glDeleteBuffers(1, &m_visibleBuffer);
+    glDeleteBuffers(1, &m_commandBuffer);
+    glDeleteBuffers(1, &m_meshSphereBuffer);
+    glDeleteBuffers(1, &m_objectMeshBuffer);
+    glDeleteBuffers(1, &m_objectBuffer);
+}
+
+void GpuCuller::Cull(const glm::mat4 &viewProjectionMatrix)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, m_resetCommands.size() * sizeof(DrawElementsIndirectCommand), m_resetCommands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, m_visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_OBJECT_BUFFER_BINDING, m_objectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_OBJECT_MESH_BUFFER_BINDING, m_objectMeshBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_MESH_SPHERE_BUFFER_BINDING, m_meshSphereBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COMMAND_BUFFER_BINDING, m_commandBuffer);
+
+    m_cullProgram.SetUniform(m_viewProjectionUniform, viewProjectionMatrix);
+    m_cullProgram.SetUniform(m_objectNumUniform, static_cast<int>(m_objectNum));
+    m_cullProgram.DispatchThreads(static_cast<GLuint>(m_objectNum));
+
+    // The commands are read as draw parameters, the instances by shaders
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void GpuCuller::Draw() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, m_visibleBuffer);
+    m_batch.DrawIndirect(m_commandBuffer, static_cast<GLsizei>(m_resetCommands.size()));
+}
+
+size_t GpuCuller::ReadVisibleNum() const
+{
+    std::vector<DrawElementsIndirectCommand> commands(m_resetCommands.size());
+    glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_commandBuffer);
+    glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    size_t visibleNum = 0;
+    for (size_t i = 0; i < commands.size(); i++) {
+        visibleNum += commands[i].instanceCount;
+    }
+    return visibleNum;
+}
@@ -0,0 +1,58 @@
+#ifndef GPU_CULLER_HPP
+#define GPU_CULLER_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+#include "glsl_program.hpp"
+#include "mesh_batch.hpp"
+#include "scene.hpp"
+
+// Storage buffer bindings of cull.comp, besides INSTANCE_BUFFER_BINDING for
+// the visible objects
+static const GLuint CULL_OBJECT_BUFFER_BINDING = 2;
+static const GLuint CULL_OBJECT_MESH_BUFFER_BINDING = 3;
+static const GLuint CULL_MESH_SPHERE_BUFFER_BINDING = 4;
+static const GLuint CULL_COMMAND_BUFFER_BINDING = 5;
+
+// Frustum culling of the objects of a MeshBatch on the GPU, with cull.comp.
+// The visible objects are compacted into per-mesh ranges of an instance
+// buffer and counted in one indirect draw command per mesh, which Draw()
+// submits as they are. Objects are tested by the bounding sphere of their
+// mesh.
+class GpuCuller
+{
+public:
+    // The batch and the linked cull.comp program must outlive the culler
+    GpuCuller(GLSLProgram &cullProgram, const MeshBatch &batch, const std::vector<SceneObject> &objects);
+    ~GpuCuller();
+
+    GpuCuller(const GpuCuller &) = delete;
+    GpuCuller & operator=(const GpuCuller &) = delete;
+
+    void Cull(const glm::mat4 &viewProjectionMatrix);
+    // Draw the visible objects of the last Cull() with a program reading
+    // them from the InstanceBuffer block (GPU_CULLED ads.vert)
+    void Draw() const;
+
+    size_t ObjectNum() const { return m_objectNum; }
+    // Objects that passed the last Cull(). Reads the commands back, waiting
+    // for the GPU, so it is meant for statistics only.
+    size_t ReadVisibleNum() const;
+
+private:
+    GLSLProgram &m_cullProgram;
+    const MeshBatch &m_batch;
+    size_t m_objectNum;
+    std::vector<DrawElementsIndirectCommand> m_resetCommands;
+    GLuint m_objectBuffer;
+    GLuint m_objectMeshBuffer;
+    GLuint m_meshSphereBuffer;
+    GLuint m_commandBuffer;
+    GLuint m_visibleBuffer;
+    GLSLUniform<glm::mat4> m_viewProjectionUniform;
+    GLSLUniform<int> m_objectNumUniform;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 64-bit FNV-1a hash
+static constexpr uint64_t HASH_OFFSET_BASIS = 14695981039346656037ULL;
+static constexpr uint64_t HASH_PRIME = 1099511628211ULL;
+
+// Hash of a null-terminated string, usable in constant expressions
+constexpr uint64_t HashLiteral(const char *str, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    return *str ? HashLiteral(str + 1, (hash ^ static_cast<unsigned char>(*str)) * HASH_PRIME) : hash;
+}
+
+// Same as HashLiteral(), for strings only known at run time
+inline uint64_t HashCString(const char *str, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    for (; *str; str++) {
+        hash ^= static_cast<unsigned char>(*str);
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+inline uint64_t HashString(const std::string &str, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    // Mix in the length so that concatenated strings do not collide
+    uint64_t len = str.length();
+    hash = HashBytes(&len, sizeof(len), hash);
+    return HashBytes(str.data(), str.length(), hash);
+}
+
+template <typename T>
+inline uint64_t HashValue(const T &value, uint64_t hash = HASH_OFFSET_BASIS)
+{
+    return HashBytes(&value, sizeof(value), hash);
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include "errors.hpp"
+#include "frame_profiler.hpp"
+#include "hash.hpp"
+#include "headless_benchmark.hpp"
+#include "json_writer.hpp"
+#include "render_target.hpp"
+#include "scene.hpp"
+#include "timing_stats.hpp"
+#include "trace.hpp"
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+static double ElapsedMs(BenchClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(BenchClock::now() - start).count();
+}
+
+// One orbit around the origin over the whole run, bobbing up and down twice
+static glm::mat4 ScriptedViewMatrix(int frame, int frameNum)
+{
+    float angle = glm::two_pi<float>() * frame / frameNum;
+    glm::vec3 eye(5.0f * std::sin(angle), 1.5f * std::sin(2.0f * angle), 5.0f * std::cos(angle));
+    return glm::lookAt(eye, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// Hash of the last frame's pixels, so that a rendering change shows up in
+// the results next to the timing change it causes
+static uint64_t HashFramebuffer(const RenderTarget &target)
+{
+    std::vector<unsigned char> pixels(static_cast<size_t>(target.Width()) * target.Height() * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target.Handle());
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, target.Width(), target.Height(), GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    return HashBytes(&pixels[0], pixels.size());
+}
+
+HeadlessBenchOptions::HeadlessBenchOptions() :
+    width(1024),
+    height(768),
+    frameNum(600),
+    warmupFrameNum(30),
+    outputFile("bench.json")
+{
+}
+
+void RunHeadlessBenchmark(Scene &scene, const HeadlessBenchOptions &options)
+{
+    RenderTarget target(options.width, options.height);
+    target.Bind();
+    glm::mat4 projectionMatrix = glm::perspective(45.0f, (float)options.width / options.height, 0.01f, 100.0f);
+
+    for (int i = 0; i < options.warmupFrameNum; i++) {
+        scene.Render(ScriptedViewMatrix(0, options.frameNum), projectionMatrix);
+    }
+    glFinish();
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.frameNum);
+    unsigned long long drawStart = scene.DrawCount();
+
+    // Per-pass stats cover the whole run
+    FrameProfiler profiler(4, options.frameNum);
+    scene.SetProfiler(&profiler);
+
+    BenchClock::time_point runStart = BenchClock::now();
+    for (int i = 0; i < options.frameNum; i++) {
+        BenchClock::time_point frameStart = BenchClock::now();
+        TraceZone frameZone("frame", "frame");
+        profiler.BeginFrame();
+        {
+            TraceZone renderZone("render", "frame");
+            ProfilerScope frameScope(&profiler, "frame");
+            scene.Render(ScriptedViewMatrix(i, options.frameNum), projectionMatrix);
+        }
+        profiler.EndFrame();
+        {
+            TraceZone finishZone("finish", "frame");
+            glFinish();
+        }
+        frameTimes.push_back(ElapsedMs(frameStart));
+    }
+    double wallMs = ElapsedMs(runStart);
+
+    profiler.Flush();
+    scene.SetProfiler(nullptr);
+
+    unsigned long long drawNum = scene.DrawCount() - drawStart;
+    TimingStats frameStats = TimingStats::FromSamples(frameTimes);
+    uint64_t imageHash = HashFramebuffer(target);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    std::ofstream ofs(options.outputFile.c_str());
+    if (!ofs) {
+        THROW(Error, "Failed to open benchmark output: " + options.outputFile);
+    }
+    char imageHashHex[17];
+    std::snprintf(imageHashHex, sizeof(imageHashHex), "%016llx", static_cast<unsigned long long>(imageHash));
+
+    JsonWriter json(ofs);
+    json.BeginObject();
+    json.Key("renderer");
+    json.Value(reinterpret_cast<const char *>(glGetString(GL_RENDERER)));
+    json.Key("version");
+    json.Value(reinterpret_cast<const char *>(glGetString(GL_VERSION)));
+    json.Key("width");
+    json.Value(options.width);
+    json.Key("height");
+    json.Value(options.height);
+    json.Key("frames");
+    json.Value(options.frameNum);
+    json.Key("warmup_frames");
+    json.Value(options.warmupFrameNum);
+    json.Key("wall_time_ms");
+    json.Value(wallMs);
+    json.Key("instances");
+    json.Value(static_cast<unsigned long long>(scene.InstanceNum()));
+    json.Key("draw_calls");
+    json.Value(drawNum);
+    json.Key("draw_calls_per_frame");
+    json.Value(options.frameNum > 0 ? (double)drawNum / options.frameNum : 0.0);
+    json.Key("frame_time_ms");
+    frameStats.WriteJson(json);
+    json.Key("passes");
+    profiler.WriteJson(json);
+    json.Key("image_hash");
+    json.Value(imageHashHex);
+    json.EndObject();
+    ofs << std::endl;
+
+    std::cout << "Headless benchmark (" << options.frameNum << " frames, " << options.width << "x" << options.height << "):" << std::endl;
+    std::cout << "  frame time: p50 " << frameStats.p50 << " ms, p95 " << frameStats.p95 << " ms, p99 " << frameStats.p99 << " ms" << std::endl;
+    std::cout << "  wall time: " << wallMs << " ms, " << drawNum << " draws" << std::endl;
+    const TimingHistory &gpuTimes = profiler.GpuTimes();
+    for (size_t i = 0; i < gpuTimes.SeriesNum(); i++) {
+        std::cout << "  " << gpuTimes.SeriesName(i) << ": GPU p50 " << gpuTimes.SeriesStats(i).p50 << " ms" << std::endl;
+    }
+    std::cout << "  results written to " << options.outputFile << std::endl;
+}
@@ -0,0 +1,29 @@
+#ifndef HEADLESS_BENCHMARK_HPP
+#define HEADLESS_BENCHMARK_HPP
+
+#include <string>
+
+class Scene;
+
+struct HeadlessBenchOptions
+{
+    HeadlessBenchOptions();
+
+    int width;
+    int height;
+    int frameNum;
+    // Frames rendered before measuring, to settle shader and buffer setup
+    int warmupFrameNum;
+    std::string outputFile;
+};
+
+// Renders the scene into a framebuffer object along a scripted camera path
+// (one orbit around the scene over the run) and writes frame time
+// percentiles, per-pass CPU and GPU times, draw counts and wall time to a
+// JSON file. Every frame ends
+// with glFinish(), so a frame time covers the whole CPU and GPU work.
+// For comparable results under Mesa llvmpipe, pin the rasterizer thread
+// count with LP_NUM_THREADS.
+void RunHeadlessBenchmark(Scene &scene, const HeadlessBenchOptions &options);
+
+#endif
@@ -0,0 +1,99 @@
+#include <cstring>
+#include "errors.hpp"
+#include "headless_context.hpp"
+
+#ifdef __linux__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+static bool HasExtension(const char *extensions, const char *name)
+{
+    return extensions && std::strstr(extensions, name);
+}
+
+// Prefer the surfaceless platform, which needs neither a GPU device nor a
+// display server
+static EGLDisplay GetDisplay()
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay && HasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) {
+            return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+#endif
+
+bool HeadlessContext::IsSupported()
+{
+#ifdef __linux__
+    return true;
+#else
+    return false;
+#endif
+}
+
+HeadlessContext::HeadlessContext(int major, int minor) :
+    m_display(nullptr),
+    m_context(nullptr)
+{
+#ifdef __linux__
+    EGLDisplay display = GetDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+        THROW(GLError, "Failed to initialize EGL display");
+    }
+    m_display = display;
+
+    if (!HasExtension(eglQueryString(display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context")) {
+        eglTerminate(display);
+        THROW(GLError, "EGL_KHR_surfaceless_context is not supported");
+    }
+
+    // No surface will be created, so any surface type will do
+    EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, 0,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint configNum = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) || !eglChooseConfig(display, configAttribs, &config, 1, &configNum) || configNum == 0) {
+        eglTerminate(display);
+        THROW(GLError, "No EGL config for desktop OpenGL");
+    }
+
+    // Same profile as the GLFW window contexts
+    EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION_KHR, major,
+        EGL_CONTEXT_MINOR_VERSION_KHR, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+        eglTerminate(display);
+        THROW(GLError, "Failed to create EGL context");
+    }
+    m_context = context;
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        THROW(GLError, "Failed to make EGL context current");
+    }
+#else
+    THROW(GLError, "Headless contexts are not supported on this platform");
+#endif
+}
+
+HeadlessContext::~HeadlessContext()
+{
+#ifdef __linux__
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(m_display, m_context);
+    eglTerminate(m_display);
+#endif
+}
@@ -0,0 +1,25 @@
+#ifndef HEADLESS_CONTEXT_HPP
+#define HEADLESS_CONTEXT_HPP
+
+// OpenGL context without a window or display server, made current on
+// creation. Uses EGL with the Mesa surfaceless platform when available, so
+// that it also works with software rendering (llvmpipe) on machines without
+// a GPU. Rendering must go to a framebuffer object.
+class HeadlessContext
+{
+public:
+    // EGL contexts are only supported on Linux
+    static bool IsSupported();
+
+    HeadlessContext(int major, int minor);
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext &) = delete;
+    HeadlessContext & operator=(const HeadlessContext &) = delete;
+
+private:
+    void *m_display;
+    void *m_context;
+};
+
+#endif
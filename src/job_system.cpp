@@ -0,0 +1,373 @@
+#include <chrono>
+#include <iostream>
+#include "error.hpp"
+#include "job_system.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+static const int64_t JOB_DEQUE_INITIAL_SIZE = 256;
+// Failed attempts to find a job before a worker goes to sleep, and how long
+// it sleeps at most (submitting wakes it earlier)
+static const int JOB_IDLE_SPIN_NUM = 64;
+static const std::chrono::microseconds JOB_IDLE_SLEEP(500);
+
+struct Job
+{
+    std::function<void()> task;
+    JobCounter *counter;
+};
+
+// Workers of the system the calling thread belongs to
+static thread_local const JobSystem *t_jobSystem = nullptr;
+static thread_local int t_workerIndex = -1;
+
+JobCounter::JobCounter() :
+    m_value(0),
+    m_mutex(),
+    m_dependents(),
+    m_error()
+{
+}
+
+JobCounter::~JobCounter()
+{
+    // Dependents of a counter that never reached zero are dropped
+    for (size_t i = 0; i < m_dependents.size(); i++) {
+        delete m_dependents[i];
+    }
+}
+
+JobDeque::JobDeque() :
+    m_top(0),
+    m_bottom(0),
+    m_ring(nullptr),
+    m_rings()
+{
+    m_rings.push_back(std::unique_ptr<Ring>(new Ring(JOB_DEQUE_INITIAL_SIZE)));
+    m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+}
+
+JobDeque::~JobDeque()
+{
+}
+
+// Memory orders follow Le et al., "Correct and Efficient Work-Stealing for
+// Weak Memory Models" (PPoPP 2013)
+void JobDeque::Push(Job *job)
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+    int64_t top = m_top.load(std::memory_order_acquire);
+    Ring *ring = m_ring.load(std::memory_order_relaxed);
+    if (bottom - top > ring->size - 1) {
+        ring = _Grow(ring, top, bottom);
+    }
+    ring->Put(bottom, job);
+    // Release store rather than the paper's fence and relaxed store: same
+    // code on x86, and visible to ThreadSanitizer
+    m_bottom.store(bottom + 1, std::memory_order_release);
+}
+
+Job * JobDeque::Pop()
+{
+    int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+    Ring *ring = m_ring.load(std::memory_order_relaxed);
+    m_bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = m_top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    Job *job = ring->Get(bottom);
+    if (top == bottom) {
+        // Last job: race thieves for it
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            job = nullptr;
+        }
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+Job * JobDeque::Steal()
+{
+    int64_t top = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = m_bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    Ring *ring = m_ring.load(std::memory_order_acquire);
+    Job *job = ring->Get(top);
+    if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return job;
+}
+
+JobDeque::Ring * JobDeque::_Grow(Ring *ring, int64_t top, int64_t bottom)
+{
+    std::unique_ptr<Ring> grown(new Ring(ring->size * 2));
+    for (int64_t i = top; i < bottom; i++) {
+        grown->Put(i, ring->Get(i));
+    }
+    m_rings.push_back(std::move(grown));
+    m_ring.store(m_rings.back().get(), std::memory_order_release);
+    return m_rings.back().get();
+}
+
+JobSystem::JobSystem(unsigned threadNum) :
+    m_deques(),
+    m_workers(),
+    m_sharedJobs(),
+    m_sharedMutex(),
+    m_sharedJobNum(0),
+    m_sleepMutex(),
+    m_sleepCond(),
+    m_sleeperNum(0),
+    m_stopping(false),
+    m_ownerThread(std::this_thread::get_id())
+{
+    if (threadNum == 0) {
+        threadNum = HardwareThreadNum();
+    }
+    for (unsigned i = 0; i < threadNum; i++) {
+        m_deques.push_back(std::unique_ptr<JobDeque>(new JobDeque));
+    }
+    for (unsigned i = 1; i < threadNum; i++) {
+        m_workers.push_back(std::thread(&JobSystem::_WorkerLoop, this, i));
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    m_stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_sleepCond.notify_all();
+    }
+    for (size_t i = 0; i < m_workers.size(); i++) {
+        m_workers[i].join();
+    }
+
+    for (size_t i = 0; i < m_deques.size(); i++) {
+        while (Job *job = m_deques[i]->Steal()) {
+            delete job;
+        }
+    }
+    while (!m_sharedJobs.empty()) {
+        delete m_sharedJobs.front();
+        m_sharedJobs.pop();
+    }
+}
+
+int JobSystem::_CurrentWorker() const
+{
+    if (t_jobSystem == this) {
+        return t_workerIndex;
+    }
+    return std::this_thread::get_id() == m_ownerThread ? 0 : -1;
+}
+
+void JobSystem::Submit(std::function<void()> task, JobCounter *counter)
+{
+    if (counter) {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+    Job *job = new Job;
+    job->task = std::move(task);
+    job->counter = counter;
+    _Enqueue(job);
+}
+
+void JobSystem::SubmitAfter(JobCounter &dependency, std::function<void()> task, JobCounter *counter)
+{
+    if (counter) {
+        counter->m_value.fetch_add(1, std::memory_order_relaxed);
+    }
+    Job *job = new Job;
+    job->task = std::move(task);
+    job->counter = counter;
+
+    // The last job of the dependency drains its dependents under the same
+    // lock, after bringing it to zero
+    {
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (!dependency.IsDone()) {
+            dependency.m_dependents.push_back(job);
+            return;
+        }
+    }
+    _Enqueue(job);
+}
+
+void JobSystem::_Enqueue(Job *job)
+{
+    int worker = _CurrentWorker();
+    if (worker >= 0) {
+        m_deques[worker]->Push(job);
+    } else {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        m_sharedJobs.push(job);
+        m_sharedJobNum.fetch_add(1, std::memory_order_release);
+    }
+
+    if (m_sleeperNum.load(std::memory_order_acquire) > 0) {
+        m_sleepCond.notify_one();
+    }
+}
+
+Job * JobSystem::_FindJob(unsigned index)
+{
+    if (Job *job = m_deques[index]->Pop()) {
+        return job;
+    }
+
+    // Steal from the others, starting after ourselves so that thieves
+    // spread over victims
+    unsigned dequeNum = static_cast<unsigned>(m_deques.size());
+    for (unsigned i = 1; i < dequeNum; i++) {
+        if (Job *job = m_deques[(index + i) % dequeNum]->Steal()) {
+            return job;
+        }
+    }
+
+    if (m_sharedJobNum.load(std::memory_order_acquire) > 0) {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        if (!m_sharedJobs.empty()) {
+            Job *job = m_sharedJobs.front();
+            m_sharedJobs.pop();
+            m_sharedJobNum.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::_Run(Job *job)
+{
+    JobCounter *counter = job->counter;
+    try {
+        job->task();
+    } catch (...) {
+        if (counter) {
+            std::lock_guard<std::mutex> lock(counter->m_mutex);
+            if (!counter->m_error) {
+                counter->m_error = std::current_exception();
+            }
+        } else {
+            // Nobody waits for the job, so the error can only be reported
+            _ReportError(std::current_exception());
+        }
+    }
+    delete job;
+    _Finish(counter);
+}
+
+void JobSystem::_ReportError(std::exception_ptr error)
+{
+    try {
+        std::rethrow_exception(error);
+    } catch (const Error &ex) {
+        std::cerr << "Job failed: " << ex.Msg() << std::endl;
+    } catch (const std::exception &ex) {
+        std::cerr << "Job failed: " << ex.what() << std::endl;
+    } catch (...) {
+        std::cerr << "Job failed with an unknown exception" << std::endl;
+    }
+}
+
+void JobSystem::_Finish(JobCounter *counter)
+{
+    if (!counter) {
+        return;
+    }
+
+    // Decrement under the lock: Wait() takes it before returning, so the
+    // counter outlives the unlock. It must not be touched afterwards.
+    std::vector<Job *> dependents;
+    {
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (counter->m_value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            dependents.swap(counter->m_dependents);
+        }
+    }
+    for (size_t i = 0; i < dependents.size(); i++) {
+        _Enqueue(dependents[i]);
+    }
+}
+
+void JobSystem::Wait(JobCounter &counter)
+{
+    int worker = _CurrentWorker();
+    while (!counter.IsDone()) {
+        Job *job = (worker >= 0 ? _FindJob(static_cast<unsigned>(worker)) : nullptr);
+        if (job) {
+            _Run(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+
+    // Taking the lock also waits for the last _Finish() to let go of the
+    // counter, which the caller may destroy once we return
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        std::swap(error, counter.m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &function)
+{
+    if (begin >= end) {
+        return;
+    }
+    JobCounter counter;
+    Submit([&, begin, end, grainSize]() { _SplitRange(begin, end, grainSize, function, counter); }, &counter);
+    Wait(counter);
+}
+
+void JobSystem::_SplitRange(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &function, JobCounter &counter)
+{
+    // Hand the upper halves out and keep splitting the lower one
+    while (end - begin > grainSize) {
+        size_t middle = begin + (end - begin) / 2;
+        Submit([this, middle, end, grainSize, &function, &counter]() { _SplitRange(middle, end, grainSize, function, counter); }, &counter);
+        end = middle;
+    }
+    function(begin, end);
+}
+
+void JobSystem::_WorkerLoop(unsigned index)
+{
+    t_jobSystem = this;
+    t_workerIndex = static_cast<int>(index);
+    TraceSetThreadName("job worker");
+
+    int idleNum = 0;
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        if (Job *job = _FindJob(index)) {
+            _Run(job);
+            idleNum = 0;
+            continue;
+        }
+
+        if (++idleNum < JOB_IDLE_SPIN_NUM) {
+            std::this_thread::yield();
+            continue;
+        }
+        // A job submitted right before the wait is picked up after the
+        // timeout at the latest
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeperNum.fetch_add(1, std::memory_order_acq_rel);
+        m_sleepCond.wait_for(lock, JOB_IDLE_SLEEP);
+        m_sleeperNum.fetch_sub(1, std::memory_order_acq_rel);
+        idleNum = 0;
+    }
+}
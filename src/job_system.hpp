@@ -0,0 +1,139 @@
+#ifndef JOB_SYSTEM_HPP
+#define JOB_SYSTEM_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class JobSystem;
+struct Job;
+
+// Number of jobs not yet finished. Jobs submitted with a counter increment
+// it and decrement it when done; jobs can wait for a counter to reach zero,
+// and so can threads (see JobSystem::Wait()). The first exception thrown by
+// one of its jobs is kept and rethrown by Wait().
+class JobCounter
+{
+public:
+    JobCounter();
+    ~JobCounter();
+
+    JobCounter(const JobCounter &) = delete;
+    JobCounter & operator=(const JobCounter &) = delete;
+
+    bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    std::atomic<int> m_value;
+    std::mutex m_mutex;
+    // Jobs to submit once the counter reaches zero
+    std::vector<Job *> m_dependents;
+    std::exception_ptr m_error;
+};
+
+// Chase-Lev work-stealing deque of jobs. The owner thread pushes and pops at
+// the bottom, other threads steal from the top. The ring grows when full;
+// replaced rings are kept until destruction, since a thief may still read
+// from one.
+class JobDeque
+{
+public:
+    JobDeque();
+    ~JobDeque();
+
+    JobDeque(const JobDeque &) = delete;
+    JobDeque & operator=(const JobDeque &) = delete;
+
+    // Owner thread only
+    void Push(Job *job);
+    Job * Pop();
+    // Any thread; null when empty or when losing a race for the last job
+    Job * Steal();
+
+private:
+    struct Ring
+    {
+        explicit Ring(int64_t size) : size(size), jobs(new std::atomic<Job *>[size]) {}
+
+        Job * Get(int64_t i) const { return jobs[i & (size - 1)].load(std::memory_order_relaxed); }
+        void Put(int64_t i, Job *job) { jobs[i & (size - 1)].store(job, std::memory_order_relaxed); }
+
+        int64_t size;
+        std::unique_ptr<std::atomic<Job *>[]> jobs;
+    };
+
+    Ring * _Grow(Ring *ring, int64_t top, int64_t bottom);
+
+    std::atomic<int64_t> m_top;
+    std::atomic<int64_t> m_bottom;
+    std::atomic<Ring *> m_ring;
+    std::vector<std::unique_ptr<Ring>> m_rings;
+};
+
+// Work-stealing scheduler: one deque per worker thread, plus one for the
+// thread that created the system, which takes part in the work while it
+// waits. Jobs submitted from a worker go to its own deque and run in LIFO
+// order there, idle workers steal the oldest jobs of others. Jobs submitted
+// from any other thread go through a shared queue.
+class JobSystem
+{
+public:
+    // threadNum counts the creating thread (0: one per core)
+    explicit JobSystem(unsigned threadNum = 0);
+    // Waits for the workers to finish their current jobs; queued jobs are
+    // dropped
+    ~JobSystem();
+
+    JobSystem(const JobSystem &) = delete;
+    JobSystem & operator=(const JobSystem &) = delete;
+
+    unsigned ThreadNum() const { return static_cast<unsigned>(m_deques.size()); }
+
+    // Exceptions of jobs without a counter are written to std::cerr
+    void Submit(std::function<void()> task, JobCounter *counter = nullptr);
+    // Submit once the dependency counter reaches zero
+    void SubmitAfter(JobCounter &dependency, std::function<void()> task, JobCounter *counter = nullptr);
+
+    // Run other jobs until the counter reaches zero, then rethrow the first
+    // exception of its jobs, if any. Can be called from jobs.
+    void Wait(JobCounter &counter);
+
+    // Call function(begin, end) over subranges of [begin, end) of at most
+    // grainSize indices, splitting the range in halves so that thieves take
+    // large pieces, and wait for all of them
+    void ParallelFor(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &function);
+
+private:
+    void _WorkerLoop(unsigned index);
+    void _Enqueue(Job *job);
+    Job * _FindJob(unsigned index);
+    void _Run(Job *job);
+    void _Finish(JobCounter *counter);
+    static void _ReportError(std::exception_ptr error);
+    void _SplitRange(size_t begin, size_t end, size_t grainSize, const std::function<void(size_t, size_t)> &function, JobCounter &counter);
+    // Index of the calling thread's deque, or -1 for other threads
+    int _CurrentWorker() const;
+
+    std::vector<std::unique_ptr<JobDeque>> m_deques;
+    std::vector<std::thread> m_workers;
+    std::queue<Job *> m_sharedJobs;
+    std::mutex m_sharedMutex;
+    std::atomic<size_t> m_sharedJobNum;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_sleepCond;
+    std::atomic<int> m_sleeperNum;
+    std::atomic<bool> m_stopping;
+    std::thread::id m_ownerThread;
+};
+
+#endif
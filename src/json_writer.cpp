@@ -0,0 +1,135 @@
+#include <cstdio>
+#include <limits>
+#include "json_writer.hpp"
+
+JsonWriter::JsonWriter(std::ostream &os) :
+    m_os(os),
+    m_hasElements(),
+    m_afterKey(false)
+{
+    m_os.precision(std::numeric_limits<double>::digits10);
+}
+
+void JsonWriter::BeginObject()
+{
+    _BeginValue();
+    m_os << '{';
+    m_hasElements.push_back(false);
+}
+
+void JsonWriter::EndObject()
+{
+    _End('}');
+}
+
+void JsonWriter::BeginArray()
+{
+    _BeginValue();
+    m_os << '[';
+    m_hasElements.push_back(false);
+}
+
+void JsonWriter::EndArray()
+{
+    _End(']');
+}
+
+void JsonWriter::Key(const char *key)
+{
+    _BeginValue();
+    _WriteString(key);
+    m_os << ": ";
+    m_afterKey = true;
+}
+
+void JsonWriter::Value(const char *value)
+{
+    _BeginValue();
+    _WriteString(value);
+}
+
+void JsonWriter::Value(const std::string &value)
+{
+    Value(value.c_str());
+}
+
+void JsonWriter::Value(double value)
+{
+    _BeginValue();
+    // JSON has no representation of infinity or NaN
+    if (value != value || value == std::numeric_limits<double>::infinity() || value == -std::numeric_limits<double>::infinity()) {
+        m_os << "null";
+    } else {
+        m_os << value;
+    }
+}
+
+void JsonWriter::Value(int value)
+{
+    _BeginValue();
+    m_os << value;
+}
+
+void JsonWriter::Value(unsigned long long value)
+{
+    _BeginValue();
+    m_os << value;
+}
+
+void JsonWriter::Value(bool value)
+{
+    _BeginValue();
+    m_os << (value ? "true" : "false");
+}
+
+// Writes the separator and indentation before a value or key. A value
+// directly following its key goes on the same line.
+void JsonWriter::_BeginValue()
+{
+    if (m_afterKey) {
+        m_afterKey = false;
+        return;
+    }
+    if (m_hasElements.empty()) {
+        return;
+    }
+    if (m_hasElements.back()) {
+        m_os << ',';
+    }
+    m_hasElements.back() = true;
+    m_os << '\n' << std::string(m_hasElements.size() * 2, ' ');
+}
+
+void JsonWriter::_End(char bracket)
+{
+    bool hasElements = m_hasElements.back();
+    m_hasElements.pop_back();
+    if (hasElements) {
+        m_os << '\n' << std::string(m_hasElements.size() * 2, ' ');
+    }
+    m_os << bracket;
+}
+
+void JsonWriter::_WriteString(const char *str)
+{
+    m_os << '"';
+    for (; *str; str++) {
+        unsigned char c = static_cast<unsigned char>(*str);
+        switch (c) {
+            case '"':  m_os << "\\\""; break;
+            case '\\': m_os << "\\\\"; break;
+            case '\n': m_os << "\\n"; break;
+            case '\r': m_os << "\\r"; break;
+            case '\t': m_os << "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    m_os << escaped;
+                } else {
+                    m_os << *str;
+                }
+        }
+    }
+    m_os << '"';
+}
@@ -0,0 +1,38 @@
+#ifndef JSON_WRITER_HPP
+#define JSON_WRITER_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Streaming JSON output. Values inside an object must be preceded by Key().
+class JsonWriter
+{
+public:
+    explicit JsonWriter(std::ostream &os);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    void Key(const char *key);
+    void Value(const char *value);
+    void Value(const std::string &value);
+    void Value(double value);
+    void Value(int value);
+    void Value(unsigned long long value);
+    void Value(bool value);
+
+private:
+    void _BeginValue();
+    void _End(char bracket);
+    void _WriteString(const char *str);
+
+    std::ostream &m_os;
+    // Whether each open object or array already has an element
+    std::vector<bool> m_hasElements;
+    bool m_afterKey;
+};
+
+#endif
@@ -2,19 +2,64 @@
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/euler_angles.hpp>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <utility>
 #include <fstream>
 #include <vector>
 #include <cstdio>
+#include "benchmark.hpp"
 #include "errors.hpp"
+#include "frame_profiler.hpp"
 #include "glsl_program.hpp"
+#include "glsl_compiler.hpp"
+#include "glsl_program_cache.hpp"
+#include "glsl_shader_cache.hpp"
+#include "glsl_variant_cache.hpp"
+#include "headless_benchmark.hpp"
+#include "cooked_mesh.hpp"
+#include "headless_context.hpp"
+#include "mesh_loader.hpp"
+#include "mesh_optimizer.hpp"
+#include "scene.hpp"
+#include "shader_reloader.hpp"
+#include "simulation.hpp"
+#include "trace.hpp"
+#include "vertex_format.hpp"
 #include "glsl_exception.hpp"
 
 static const int WINDOW_WIDTH = 1024;
 static const int WINDOW_HEIGHT = 768;
 static const char WINDOW_TITLE[] = "Window";
+static const char PROGRAM_CACHE_DIR[] = "../cache";
+static const char SHADER_DIR[] = "../src";
+static const int STARTUP_BENCH_PROGRAM_NUM = 64;
+static const int COMPILE_BENCH_PROGRAM_NUM = 128;
+static const int PIPELINE_BENCH_VARIANT_NUM = 8;
+static const int PIPELINE_BENCH_DRAW_NUM = 100000;
+static const int SHADER_BENCH_VARIANT_NUM = 16;
+static const int MESH_BENCH_SEGMENT_NUM = 512;
+static const int LOADER_BENCH_SEGMENT_NUM = 2048;
+static const size_t INSTANCE_BENCH_MAX_INSTANCE_NUM = 1000000;
+static const size_t INSTANCE_BENCH_MAX_PER_OBJECT_NUM = 100000;
+static const uint32_t INSTANCE_MATERIAL_NUM = 16;
+static const size_t MULTI_DRAW_BENCH_MAX_OBJECT_NUM = 100000;
+static const uint32_t MULTI_DRAW_BENCH_MESH_NUM = 8;
+static const size_t CPU_CULL_BENCH_MAX_BOX_NUM = 1000000;
+static const size_t STREAM_BENCH_MAX_FRAME_BYTES = 64 * 1024 * 1024;
+static const int VERTEX_FORMAT_BENCH_SEGMENT_NUM = 2048;
+static const size_t LIGHT_BENCH_MAX_LIGHT_NUM = 10000;
+static const int LIGHT_BENCH_SEGMENT_NUM = 256;
+static const int HOIST_BENCH_SEGMENT_NUM = 1024;
+static const int JOB_BENCH_FIB_N = 32;
+static const size_t JOB_BENCH_REDUCE_NUM = 16 * 1024 * 1024;
+static const size_t JOB_BENCH_BODY_NUM = 4096;
+static const double SIMULATION_TICK_RATE = 60.0;
 
 // Print general OpenGL info (version, extensions, etc.)
 void PrintOglInfo()
@@ -57,233 +102,407 @@ void DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsiz
     std::cout << "[DEBUG] " << message << std::endl;
 }
 
-static glm::vec3 g_movement(0.0f);
-
+// Input goes to the simulation set as the window user pointer, if any
 void OnKeyPress(GLFWwindow *window, int key, int scancode, int action, int mods)
 {
     // Ignore key repeats
     if (action == GLFW_REPEAT) {
         return;
     }
+    Simulation *simulation = static_cast<Simulation *>(glfwGetWindowUserPointer(window));
+    if (!simulation) {
+        return;
+    }
 
-    std::map<int, glm::vec3> moveVectors;
-    moveVectors[GLFW_KEY_W] = glm::vec3(0.0f, 0.0f, -1.0f);
-    moveVectors[GLFW_KEY_S] = glm::vec3(0.0f, 0.0f, 1.0f);
-    moveVectors[GLFW_KEY_A] = glm::vec3(-1.0f, 0.0f, 0.0f);
-    moveVectors[GLFW_KEY_D] = glm::vec3(1.0f, 0.0f, 0.0f);
-    moveVectors[GLFW_KEY_SPACE] = glm::vec3(0.0f, 1.0f, 0.0f);
-    moveVectors[GLFW_KEY_C] = glm::vec3(0.0f, -1.0f, 0.0f);
-
-    std::map<int, glm::vec3>::iterator it = moveVectors.find(key);
-    if (it != moveVectors.end()) {
-        float direction = (action == GLFW_PRESS ? -1.0f : 1.0f);
-        g_movement += it->second * direction;
+    std::map<int, MoveKey> moveKeys;
+    moveKeys[GLFW_KEY_W] = MoveKey::FORWARD;
+    moveKeys[GLFW_KEY_S] = MoveKey::BACK;
+    moveKeys[GLFW_KEY_A] = MoveKey::LEFT;
+    moveKeys[GLFW_KEY_D] = MoveKey::RIGHT;
+    moveKeys[GLFW_KEY_SPACE] = MoveKey::UP;
+    moveKeys[GLFW_KEY_C] = MoveKey::DOWN;
+
+    std::map<int, MoveKey>::iterator it = moveKeys.find(key);
+    if (it != moveKeys.end()) {
+        simulation->SetKey(it->second, action == GLFW_PRESS);
     }
 }
 
-static glm::mat4 g_rotation(1.0f);
-
 void OnMouseMove(GLFWwindow *window, double xpos, double ypos)
 {
-    static double xx = xpos, yy = ypos;
-    
-    glm::vec2 moveVec(xpos - xx, ypos - yy);
-    xx = xpos;
-    yy = ypos;
-    moveVec *= 0.005f;
-
-    glm::mat4 rot = glm::eulerAngleXY(moveVec.y, moveVec.x);
-    g_rotation = g_rotation * rot;
+    Simulation *simulation = static_cast<Simulation *>(glfwGetWindowUserPointer(window));
+    if (simulation) {
+        simulation->SetCursor(xpos, ypos);
+    }
 }
 
-int main()
+static bool HasExtension(const char *file, const char *extension)
 {
-    try {
-
-    if (!glfwInit()) {
-        return 1;
-    }
+    size_t fileLength = std::strlen(file);
+    size_t extensionLength = std::strlen(extension);
+    return fileLength >= extensionLength && std::strcmp(file + fileLength - extensionLength, extension) == 0;
+}
 
-    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+// OBJ or PLY mesh prepared for the scene: framed like the cube and optimized
+static MeshData LoadSceneMesh(const char *file)
+{
+    MeshData mesh = LoadMesh(file);
+    FitToUnitCube(mesh);
+    OptimizeMesh(mesh);
+    return mesh;
+}
 
-    GLFWwindow *window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, nullptr, nullptr);
-    if (!window) {
-        glfwTerminate();
-        return 1;
+static VertexFormat ParseVertexFormat(const char *name)
+{
+    static const VertexFormat FORMATS[] = { VertexFormat::FLOAT, VertexFormat::HALF, VertexFormat::QUANTIZED };
+    for (size_t i = 0; i < sizeof(FORMATS) / sizeof(FORMATS[0]); i++) {
+        if (std::strcmp(name, VertexFormatName(FORMATS[i])) == 0) {
+            return FORMATS[i];
+        }
     }
-    glfwMakeContextCurrent(window);
-    int windowWidth, windowHeight;
-    glfwGetWindowSize(window, &windowWidth, &windowHeight);
-    float aspectRatio = (float)windowWidth / windowHeight;
-
-    glfwSetInputMode(window, GLFW_STICKY_KEYS, 0);
-    glfwSetKeyCallback(window, OnKeyPress);
-    glfwSetCursorPosCallback(window, OnMouseMove);
+    THROW(Error, std::string("Unknown vertex format: ") + name);
+}
 
-    glewExperimental = true;
-    if (glewInit() != GLEW_OK) {
-        glfwTerminate();
-        return 1;
+static int ParseFrameNum(const char *value)
+{
+    char *end = nullptr;
+    long frameNum = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0' || frameNum < 1 || frameNum > INT_MAX) {
+        THROW(Error, std::string("--frames expects a positive number of frames, got: ") + value);
     }
+    return static_cast<int>(frameNum);
+}
 
-    glDebugMessageCallback(DebugCallback, nullptr);
-    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
-
-    glEnable(GL_DEPTH_TEST);
-
-    GLSLProgram program;
-    program.CompileShader("../src/ads.vert");
-    program.CompileShader("../src/ads.frag");
-
-    program.BindAttribLocation(0, "VertexPosition");
-    program.BindAttribLocation(1, "VertexNormal");
-
-    program.Link();
-    program.Use();
-
-    // Vertex data: coordinates, normals
-    const size_t VERTEX_NUM = 36;
-    GLfloat vertexData[VERTEX_NUM * 6] = {
-        // <position>           <normal>
-
-        // -X side
-        -1.0f, -1.0f, -1.0f,    -1.0f, 0.0f, 0.0f,
-        -1.0f,  1.0f,  1.0f,    -1.0f, 0.0f, 0.0f,
-        -1.0f, -1.0f,  1.0f,    -1.0f, 0.0f, 0.0f,
-
-        -1.0f,  1.0f,  1.0f,    -1.0f, 0.0f, 0.0f,
-        -1.0f,  1.0f, -1.0f,    -1.0f, 0.0f, 0.0f,
-        -1.0f, -1.0f, -1.0f,    -1.0f, 0.0f, 0.0f,
-
-        // +X side        
-         1.0f, -1.0f, -1.0f,     1.0f, 0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,     1.0f, 0.0f, 0.0f,
-         1.0f,  1.0f,  1.0f,     1.0f, 0.0f, 0.0f,
-
-         1.0f,  1.0f,  1.0f,     1.0f, 0.0f, 0.0f,
-         1.0f,  1.0f, -1.0f,     1.0f, 0.0f, 0.0f,
-         1.0f, -1.0f, -1.0f,     1.0f, 0.0f, 0.0f,
+static size_t ParseInstanceNum(const char *value)
+{
+    char *end = nullptr;
+    long instanceNum = std::strtol(value, &end, 10);
+    if (end == value || *end != '\0' || instanceNum < 1 || instanceNum > INT_MAX) {
+        THROW(Error, std::string("--instances expects a positive number of instances, got: ") + value);
+    }
+    return static_cast<size_t>(instanceNum);
+}
 
-        // -Y side
-        -1.0f, -1.0f, -1.0f,     0.0f, -1.0f, 0.0f,
-        -1.0f, -1.0f,  1.0f,     0.0f, -1.0f, 0.0f,
-         1.0f, -1.0f,  1.0f,     0.0f, -1.0f, 0.0f,
+int main(int argc, char *argv[])
+{
+    try {
 
-         1.0f, -1.0f,  1.0f,     0.0f, -1.0f, 0.0f,
-         1.0f, -1.0f, -1.0f,     0.0f, -1.0f, 0.0f,
-        -1.0f, -1.0f, -1.0f,     0.0f, -1.0f, 0.0f,
+    // "--bench <name>" runs a benchmark in a hidden window and exits (on the
+    // EGL context instead, given --headless, whose file is then unused),
+    // "--headless <file>" renders "--frames <n>" frames offscreen and writes
+    // their timings to a JSON file, "--watch" recompiles shaders when their
+    // files change, "--trace <file>" writes a Chrome trace of the run,
+    // "--mesh <file>" draws an OBJ, PLY or cooked mesh instead of the cube,
+    // "--cook <input> <output>" cooks an OBJ or PLY mesh and exits,
+    // "--instances <n>" draws a grid of n instanced copies of the mesh,
+    // "--vertex-format <float|half|quantized>" packs an OBJ or PLY mesh
+    const char *benchName = nullptr;
+    const char *meshFile = nullptr;
+    const char *cookInput = nullptr;
+    const char *cookOutput = nullptr;
+    size_t instanceNum = 0;
+    VertexFormat vertexFormat = VertexFormat::FLOAT;
+    const char *headlessOutput = nullptr;
+    const char *traceOutput = nullptr;
+    HeadlessBenchOptions headlessOptions;
+    bool watchShaders = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            benchName = argv[++i];
+        } else if (std::strcmp(argv[i], "--headless") == 0 && i + 1 < argc) {
+            headlessOutput = argv[++i];
+        } else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            headlessOptions.frameNum = ParseFrameNum(argv[++i]);
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceOutput = argv[++i];
+        } else if (std::strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            meshFile = argv[++i];
+        } else if (std::strcmp(argv[i], "--instances") == 0 && i + 1 < argc) {
+            instanceNum = ParseInstanceNum(argv[++i]);
+        } else if (std::strcmp(argv[i], "--vertex-format") == 0 && i + 1 < argc) {
+            vertexFormat = ParseVertexFormat(argv[++i]);
+        } else if (std::strcmp(argv[i], "--cook") == 0 && i + 2 < argc) {
+            cookInput = argv[++i];
+            cookOutput = argv[++i];
+        } else if (std::strcmp(argv[i], "--watch") == 0) {
+            watchShaders = true;
+        }
+    }
+    // The compile benchmark shares the window's context, which headless runs
+    // on EGL do not create; the others only need a current context
+    if (benchName && headlessOutput && std::strcmp(benchName, "compile") == 0) {
+        THROW(Error, "--bench compile needs a window and cannot be combined with --headless");
+    }
 
-        // +Y side
-        -1.0f,  1.0f, -1.0f,     0.0f,  1.0f, 0.0f,
-        -1.0f,  1.0f,  1.0f,     0.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f,     0.0f,  1.0f, 0.0f,
+    TraceSession traceSession(traceOutput);
 
-         1.0f,  1.0f,  1.0f,     0.0f,  1.0f, 0.0f,
-         1.0f,  1.0f, -1.0f,     0.0f,  1.0f, 0.0f,
-        -1.0f,  1.0f, -1.0f,     0.0f,  1.0f, 0.0f,
+    if (cookInput) {
+        MeshData mesh = LoadSceneMesh(cookInput);
+        CookMesh(mesh, cookOutput);
+        std::cout << "Cooked " << cookInput << " into " << cookOutput << ": " << mesh.vertices.size() << " vertices, "
+                  << mesh.indices.size() / 3 << " triangles" << std::endl;
+        return 0;
+    }
 
-        // -Z side
-        -1.0f, -1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
-        -1.0f,  1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
-         1.0f,  1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+    TraceZone contextZone("create context", "startup");
+
+    // Headless runs need no display server where EGL is available, and fall
+    // back to a hidden window elsewhere
+    std::unique_ptr<HeadlessContext> headlessContext;
+    GLFWwindow *window = nullptr;
+    float aspectRatio = (float)WINDOW_WIDTH / WINDOW_HEIGHT;
+    if (headlessOutput && HeadlessContext::IsSupported()) {
+        headlessContext.reset(new HeadlessContext(4, 3));
+    } else {
+        if (!glfwInit()) {
+            return 1;
+        }
 
-         1.0f,  1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
-         1.0f, -1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
-        -1.0f, -1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+        glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+        if (benchName || headlessOutput) {
+            glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+        }
 
-        // +Z side
-        -1.0f, -1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
-        -1.0f,  1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
-         1.0f,  1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+        window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, nullptr, nullptr);
+        if (!window) {
+            glfwTerminate();
+            return 1;
+        }
+        glfwMakeContextCurrent(window);
+        int windowWidth, windowHeight;
+        glfwGetWindowSize(window, &windowWidth, &windowHeight);
+        aspectRatio = (float)windowWidth / windowHeight;
+
+        glfwSetInputMode(window, GLFW_STICKY_KEYS, 0);
+        glfwSetKeyCallback(window, OnKeyPress);
+        glfwSetCursorPosCallback(window, OnMouseMove);
+    }
+    contextZone.End();
 
-         1.0f,  1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
-         1.0f, -1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
-        -1.0f, -1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
-    };
+    TraceZone glewZone("glewInit", "startup");
+    glewExperimental = true;
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX loads the GL entry points before failing to find a
+    // GLX display, which an EGL context does not have
+    if (headlessContext && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) {
+        glewStatus = GLEW_OK;
+    }
+#endif
+    if (glewStatus != GLEW_OK) {
+        if (window) {
+            glfwTerminate();
+        }
+        return 1;
+    }
 
-    GLuint vertexBuffer;
-    glGenBuffers(1, &vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertexData), vertexData, GL_STATIC_DRAW);
+    glewZone.End();
 
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+    glDebugMessageCallback(DebugCallback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    glEnable(GL_DEPTH_TEST);
 
-    glBindVertexBuffer(0, vertexBuffer, 0, sizeof(GLfloat) * 6);
-    glBindVertexBuffer(1, vertexBuffer, sizeof(GLfloat) * 3, sizeof(GLfloat) * 6);
+    if (benchName) {
+        if (std::strcmp(benchName, "startup") == 0) {
+            RunStartupBenchmark(STARTUP_BENCH_PROGRAM_NUM);
+        } else if (std::strcmp(benchName, "compile") == 0) {
+            RunCompileBenchmark(window, COMPILE_BENCH_PROGRAM_NUM);
+        } else if (std::strcmp(benchName, "pipeline") == 0) {
+            RunPipelineBenchmark(PIPELINE_BENCH_VARIANT_NUM, PIPELINE_BENCH_DRAW_NUM);
+        } else if (std::strcmp(benchName, "shaders") == 0) {
+            RunShaderSharingBenchmark(SHADER_BENCH_VARIANT_NUM);
+        } else if (std::strcmp(benchName, "mesh") == 0) {
+            RunMeshBenchmark(MESH_BENCH_SEGMENT_NUM);
+        } else if (std::strcmp(benchName, "loader") == 0) {
+            RunMeshLoaderBenchmark(LOADER_BENCH_SEGMENT_NUM);
+        } else if (std::strcmp(benchName, "cooked") == 0) {
+            RunCookedMeshBenchmark(LOADER_BENCH_SEGMENT_NUM);
+        } else if (std::strcmp(benchName, "instances") == 0) {
+            RunInstancingBenchmark(INSTANCE_BENCH_MAX_INSTANCE_NUM, INSTANCE_BENCH_MAX_PER_OBJECT_NUM, INSTANCE_MATERIAL_NUM);
+        } else if (std::strcmp(benchName, "multidraw") == 0) {
+            RunMultiDrawBenchmark(MULTI_DRAW_BENCH_MAX_OBJECT_NUM, MULTI_DRAW_BENCH_MESH_NUM, INSTANCE_MATERIAL_NUM);
+        } else if (std::strcmp(benchName, "culling") == 0) {
+            RunGpuCullingBenchmark(MULTI_DRAW_BENCH_MAX_OBJECT_NUM, MULTI_DRAW_BENCH_MESH_NUM, INSTANCE_MATERIAL_NUM);
+        } else if (std::strcmp(benchName, "cpuculling") == 0) {
+            RunCpuCullingBenchmark(CPU_CULL_BENCH_MAX_BOX_NUM);
+        } else if (std::strcmp(benchName, "streaming") == 0) {
+            RunStreamingBenchmark(STREAM_BENCH_MAX_FRAME_BYTES);
+        } else if (std::strcmp(benchName, "vertexformat") == 0) {
+            RunVertexFormatBenchmark(VERTEX_FORMAT_BENCH_SEGMENT_NUM);
+        } else if (std::strcmp(benchName, "lighting") == 0) {
+            RunClusteredLightingBenchmark(LIGHT_BENCH_MAX_LIGHT_NUM, LIGHT_BENCH_SEGMENT_NUM);
+        } else if (std::strcmp(benchName, "hoisting") == 0) {
+            RunUniformHoistingBenchmark(HOIST_BENCH_SEGMENT_NUM);
+        } else if (std::strcmp(benchName, "jobs") == 0) {
+            RunJobSystemBenchmark(JOB_BENCH_FIB_N, JOB_BENCH_REDUCE_NUM, JOB_BENCH_BODY_NUM);
+        } else {
+            std::cerr << "Unknown benchmark: " << benchName << std::endl;
+        }
+        if (window) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        return 0;
+    }
 
-    glVertexAttribFormat(0, 3, GL_FLOAT, GL_FALSE, 0);
-    glVertexAttribFormat(1, 3, GL_FLOAT, GL_FALSE, 0);
+    std::chrono::high_resolution_clock::time_point linkStart = std::chrono::high_resolution_clock::now();
+    TraceZone programZone("load programs", "startup");
+
+    GLSLProgramCache programCache(PROGRAM_CACHE_DIR);
+    GLSLPreprocessor preprocessor;
+    preprocessor.AddIncludePath(SHADER_DIR);
+    GLSLShaderCache shaderCache;
+    GLSLVariantCache programVariants(&preprocessor, &programCache, &shaderCache);
+
+    GLSLProgramDesc adsDesc;
+    adsDesc.files.push_back(std::string(SHADER_DIR) + "/ads.vert");
+    adsDesc.files.push_back(std::string(SHADER_DIR) + "/ads.frag");
+    adsDesc.attribLocations.push_back(std::make_pair(0, "VertexPosition"));
+    adsDesc.attribLocations.push_back(std::make_pair(1, "VertexNormal"));
+    adsDesc.hoistUniforms = true;
+    if (instanceNum > 0) {
+        adsDesc.defines.Set("INSTANCED");
+    }
+    if (meshFile && !HasExtension(meshFile, ".mesh")) {
+        AddVertexFormatDefines(vertexFormat, adsDesc.defines);
+    }
 
-    glVertexAttribBinding(0, 0);
-    glVertexAttribBinding(1, 1);
+    GLSLProgram &program = programVariants.Get(adsDesc);
+    program.Use();
+    program.EnableUniformShadowing(true);
+
+    programZone.End();
+
+    double linkMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - linkStart).count();
+    std::cout << "Program ready in " << linkMs << " ms" << (program.IsLoadedFromCache() ? " (cached binary)" : "") << std::endl;
+    std::cout << "Shader objects: " << shaderCache.Compiles() << " compiled, " << shaderCache.Reuses() << " reused, "
+              << shaderCache.LiveShaderNum() << " live (" << shaderCache.LiveShaderBytes() << " bytes)" << std::endl;
+
+    TraceZone sceneZone("create scene", "startup");
+    std::unique_ptr<Scene> scene;
+    if (meshFile) {
+        std::unique_ptr<Mesh> mesh;
+        PositionTransform positionTransform = { glm::vec3(1.0f), glm::vec3(0.0f) };
+        if (HasExtension(meshFile, ".mesh")) {
+            CookedMesh cookedMesh(meshFile);
+            mesh.reset(new Mesh(cookedMesh.Streams()));
+        } else {
+            PackedMesh packedMesh(LoadSceneMesh(meshFile), vertexFormat);
+            mesh.reset(new Mesh(packedMesh.Streams()));
+            positionTransform = packedMesh.Transform();
+        }
+        std::cout << "Mesh " << meshFile << ": " << mesh->VertexNum() << " vertices, "
+                  << mesh->IndexNum() / 3 << " triangles" << std::endl;
+        scene.reset(new Scene(program, std::move(mesh)));
+        scene->SetPositionTransform(positionTransform);
+    } else {
+        scene.reset(new Scene(program));
+    }
+    if (instanceNum > 0) {
+        scene->SetInstances(CreateInstanceGrid(instanceNum, INSTANCE_MATERIAL_NUM), CreateMaterialPalette(INSTANCE_MATERIAL_NUM));
+    }
+    sceneZone.End();
 
+    TraceZone printZone("print program info", "startup");
     program.PrintActiveAttribs();
+    program.PrintActiveUniformBlocks();
+    printZone.End();
+
+    if (headlessOutput) {
+        headlessOptions.width = WINDOW_WIDTH;
+        headlessOptions.height = WINDOW_HEIGHT;
+        headlessOptions.outputFile = headlessOutput;
+        RunHeadlessBenchmark(*scene, headlessOptions);
+
+        scene.reset();
+        if (window) {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        return 0;
+    }
 
     glm::mat4 projectionMatrix = glm::perspective(45.0f, aspectRatio, 0.01f, 100.0f);
     glm::mat4 viewMatrix = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-    glm::mat4 modelMatrix = glm::mat4(1.0f);
-
-    // Light properties
-    glm::vec3 lightPosition(10.0f, 5.0f, 2.0f);
-    glm::vec3 lightLa(0.1f, 0.2f, 0.1f);
-    glm::vec3 lightLd(1.0f, 1.0f, 1.0f);
-    glm::vec3 lightLs(0.5f, 0.5f, 0.5f);
-
-    // Material properties
-    glm::vec3 materialKa(1.0f, 0.7f, 0.7f);
-    glm::vec3 materialKd(1.0f, 0.7f, 0.7f);
-    glm::vec3 materialKs(1.0f, 0.7f, 0.7f);
-    GLfloat materialShine = 8.0f;    
-
-    program.SetUniform("Light.Position", lightPosition);
-    program.SetUniform("Light.La", lightLa);
-    program.SetUniform("Light.Ld", lightLd);
-    program.SetUniform("Light.Ls", lightLs);
-    program.SetUniform("Material.Ka", materialKa);
-    program.SetUniform("Material.Kd", materialKd);
-    program.SetUniform("Material.Ks", materialKs);
-    program.SetUniform("Material.Shine", materialShine);
 
-    while (!glfwWindowShouldClose(window)) {
-        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Shader hot reload: a single worker context is enough for occasional edits
+    std::unique_ptr<GLSLCompiler> reloadCompiler;
+    std::unique_ptr<ShaderReloader> reloader;
+    if (watchShaders) {
+        reloadCompiler.reset(new GLSLCompiler(window, 1));
+        reloader.reset(new ShaderReloader(*reloadCompiler));
+        reloader->Watch(program, [&](GLSLProgram &) {
+            scene->OnProgramReloaded();
+        });
+    }
 
-        glm::vec3 velocity(0.0f);
-        if (glm::length(g_movement) > 0.0f) {
-            velocity = glm::normalize(g_movement) * 0.1f;
-        }          
+    FrameProfiler profiler;
+    scene->SetProfiler(&profiler);
 
-        //viewMatrix = glm::translate(viewMatrix, velocity);
-        viewMatrix = glm::translate(glm::mat4(1.0f), velocity) * viewMatrix;
+    // Camera movement runs on the simulation thread; frames interpolate
+    // between its last two ticks
+    Simulation simulation(viewMatrix, SIMULATION_TICK_RATE);
+    glfwSetWindowUserPointer(window, &simulation);
+    simulation.Start();
 
-        viewMatrix = g_rotation * viewMatrix;
-        g_rotation = glm::mat4(1.0f);
+    while (!glfwWindowShouldClose(window)) {
+        TraceZone frameZone("frame", "frame");
+        profiler.BeginFrame();
 
-        glm::mat4 modelViewMatrix = viewMatrix;
-        glm::mat3 normalMatrix = glm::inverse(glm::transpose(glm::mat3(modelViewMatrix)));
-        
-        program.SetUniform("ModelViewMatrix", modelViewMatrix);
-        program.SetUniform("ProjectionMatrix", projectionMatrix);
-        program.SetUniform("NormalMatrix", normalMatrix);
+        TraceZone updateZone("update", "frame");
+        if (reloader) {
+            reloader->Update();
+        }
 
-        glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
+        viewMatrix = simulation.InterpolateView(SimulationClock::now());
+        updateZone.End();
 
+        {
+            TraceZone renderZone("render", "frame");
+            ProfilerScope frameScope(&profiler, "frame");
+            scene->Render(viewMatrix, projectionMatrix);
+        }
 
+        profiler.EndFrame();
+        TraceZone swapZone("swap", "frame");
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
 
+    simulation.Stop();
+    glfwSetWindowUserPointer(window, nullptr);
+    std::cout << "Simulation ticks: " << simulation.TickNum() << std::endl;
+
+    const GLSLUniformStats &uniformStats = program.UniformStats();
+    std::cout << "Uniform sets: " << uniformStats.sets << ", issued: " << uniformStats.issued
+              << ", skipped: " << uniformStats.Skipped() << std::endl;
+
+    // Stats over the last frames before exit
+    profiler.Flush();
+    // CPU and GPU series are created in different orders, so match by name
+    const TimingHistory &cpuTimes = profiler.CpuTimes();
+    const TimingHistory &gpuTimes = profiler.GpuTimes();
+    for (size_t i = 0; i < cpuTimes.SeriesNum(); i++) {
+        std::cout << "Pass " << cpuTimes.SeriesName(i) << ": CPU p50 " << cpuTimes.SeriesStats(i).p50 << " ms";
+        size_t gpuIndex = gpuTimes.FindSeries(cpuTimes.SeriesName(i));
+        if (gpuIndex < gpuTimes.SeriesNum()) {
+            std::cout << ", GPU p50 " << gpuTimes.SeriesStats(gpuIndex).p50 << " ms";
+        }
+        std::cout << std::endl;
+    }
+
+    reloader.reset();
+    reloadCompiler.reset();
+    scene.reset();
+
     glfwDestroyWindow(window);
     glfwTerminate();
 
     } catch (GLSLException ex) {
         std::cerr << "GLSL Exception:" << std::endl << ex.Msg() << std::endl;
+    } catch (const Error &ex) {
+        std::cerr << "Error:" << std::endl << ex.Msg() << std::endl;
     }
 
 
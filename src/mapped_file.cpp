@@ -0,0 +1,97 @@
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "error.hpp"
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path) :
+    m_data(nullptr),
+    m_size(0)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        THROW(Error, "Failed to open file: " + path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        CloseHandle(file);
+        THROW(Error, "Failed to get file size: " + path);
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        return;
+    }
+
+    // The view keeps the mapping and the file open
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        THROW(Error, "Failed to map file: " + path);
+    }
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) {
+        THROW(Error, "Failed to map file: " + path);
+    }
+
+    m_data = static_cast<const char *>(data);
+    m_size = static_cast<size_t>(size.QuadPart);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+    }
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path) :
+    m_data(nullptr),
+    m_size(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        THROW(Error, "Failed to open file: " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        THROW(Error, "Failed to get file size: " + path);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    void *data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        THROW(Error, "Failed to map file: " + path);
+    }
+    // Parsing touches the whole file from several threads at once
+    madvise(data, static_cast<size_t>(st.st_size), MADV_WILLNEED);
+
+    m_data = static_cast<const char *>(data);
+    m_size = static_cast<size_t>(st.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data) {
+        munmap(const_cast<char *>(m_data), m_size);
+    }
+}
+
+#endif
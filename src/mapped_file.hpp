@@ -0,0 +1,26 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. An empty file maps to a null
+// pointer with zero size.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    const char * Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const char *m_data;
+    size_t m_size;
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include <cstddef>
+#include "mesh.hpp"
+
+MeshBounds ComputeBounds(const MeshData &mesh)
+{
+    MeshBounds bounds = { glm::vec3(0.0f), glm::vec3(0.0f) };
+    if (mesh.vertices.empty()) {
+        return bounds;
+    }
+
+    bounds.min = mesh.vertices[0].position;
+    bounds.max = bounds.min;
+    for (size_t i = 1; i < mesh.vertices.size(); i++) {
+        bounds.min = glm::min(bounds.min, mesh.vertices[i].position);
+        bounds.max = glm::max(bounds.max, mesh.vertices[i].position);
+    }
+    return bounds;
+}
+
+MeshSphere ComputeBoundingSphere(const MeshData &mesh)
+{
+    MeshBounds bounds = ComputeBounds(mesh);
+    MeshSphere sphere = { (bounds.min + bounds.max) * 0.5f, 0.0f };
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        sphere.radius = glm::max(sphere.radius, glm::distance(sphere.center, mesh.vertices[i].position));
+    }
+    return sphere;
+}
+
+void FitToUnitCube(MeshData &mesh)
+{
+    MeshBounds bounds = ComputeBounds(mesh);
+    glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+    glm::vec3 extent = bounds.max - bounds.min;
+    float size = glm::max(extent.x, glm::max(extent.y, extent.z));
+    float scale = size > 0.0f ? 2.0f / size : 1.0f;
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        mesh.vertices[i].position = (mesh.vertices[i].position - center) * scale;
+    }
+}
+
+Mesh::Mesh(const MeshData &data) :
+    m_vertexBuffer(0),
+    m_indexBuffer(0),
+    m_vao(0),
+    m_vertexNum(0),
+    m_indexNum(0),
+    m_indexType(GL_UNSIGNED_INT)
+{
+    MeshStreams streams;
+    streams.vertexData = data.vertices.data();
+    streams.vertexDataSize = data.vertices.size() * sizeof(MeshVertex);
+    streams.vertexStride = sizeof(MeshVertex);
+    streams.attributes = MESH_VERTEX_ATTRIBUTES;
+    streams.attributeNum = sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(MESH_VERTEX_ATTRIBUTES[0]);
+    streams.indexNum = static_cast<GLsizei>(data.indices.size());
+
+    std::vector<uint16_t> shortIndices;
+    if (data.vertices.size() <= 0x10000) {
+        shortIndices.assign(data.indices.begin(), data.indices.end());
+        streams.indexData = shortIndices.data();
+        streams.indexType = GL_UNSIGNED_SHORT;
+    } else {
+        streams.indexData = data.indices.data();
+        streams.indexType = GL_UNSIGNED_INT;
+    }
+
+    _Create(streams);
+}
+
+Mesh::Mesh(const MeshStreams &streams) :
+    m_vertexBuffer(0),
+    m_indexBuffer(0),
+    m_vao(0),
+    m_vertexNum(0),
+    m_indexNum(0),
+    m_indexType(GL_UNSIGNED_INT)
+{
+    _Create(streams);
+}
+
+void Mesh::_Create(const MeshStreams &streams)
+{
+    m_vertexNum = static_cast<GLsizei>(streams.vertexDataSize / streams.vertexStride);
+    m_indexNum = streams.indexNum;
+    m_indexType = streams.indexType;
+    GLsizeiptr indexSize = static_cast<GLsizeiptr>(streams.indexNum) * (m_indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, streams.vertexDataSize, streams.vertexData, GL_STATIC_DRAW);
+
+    // The element buffer binding is part of the VAO state
+    glGenBuffers(1, &m_indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, streams.indexData, GL_STATIC_DRAW);
+
+    glBindVertexBuffer(0, m_vertexBuffer, 0, streams.vertexStride);
+    for (size_t i = 0; i < streams.attributeNum; i++) {
+        const MeshAttribute &attribute = streams.attributes[i];
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribFormat(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.relativeOffset);
+        glVertexAttribBinding(attribute.location, attribute.binding);
+    }
+
+    glBindVertexArray(0);
+}
+
+Mesh::~Mesh()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_indexBuffer);
+    glDeleteBuffers(1, &m_vertexBuffer);
+}
+
+void Mesh::Draw() const
+{
+    glBindVertexArray(m_vao);
+    glDrawElements(GL_TRIANGLES, m_indexNum, m_indexType, nullptr);
+}
+
+void Mesh::DrawInstanced(GLsizei instanceNum) const
+{
+    glBindVertexArray(m_vao);
+    glDrawElementsInstanced(GL_TRIANGLES, m_indexNum, m_indexType, nullptr, instanceNum);
+}
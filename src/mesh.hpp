@@ -0,0 +1,108 @@
+#ifndef MESH_HPP
+#define MESH_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+};
+
+// Indexed triangle list on the CPU side
+struct MeshData
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+};
+
+struct MeshBounds
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+MeshBounds ComputeBounds(const MeshData &mesh);
+
+struct MeshSphere
+{
+    glm::vec3 center;
+    float radius;
+};
+
+// Sphere around the center of the bounds, enclosing every vertex
+MeshSphere ComputeBoundingSphere(const MeshData &mesh);
+
+// Translate and uniformly scale positions so that the mesh is centered on
+// the origin and fits in [-1, 1] on every axis
+void FitToUnitCube(MeshData &mesh);
+
+// Vertex attribute, as passed to glVertexAttribFormat and
+// glVertexAttribBinding
+struct MeshAttribute
+{
+    GLuint location;
+    GLuint binding;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    GLuint relativeOffset;
+};
+
+// Attributes of MeshVertex: position at location 0, normal at 1, both in
+// binding 0
+static const MeshAttribute MESH_VERTEX_ATTRIBUTES[] = {
+    { 0, 0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, position) },
+    { 1, 0, 3, GL_FLOAT, GL_FALSE, offsetof(MeshVertex, normal) },
+};
+
+// Vertex and index data ready for upload, with their layout. All vertex
+// attributes read from a single interleaved buffer.
+struct MeshStreams
+{
+    const void *vertexData;
+    size_t vertexDataSize;
+    GLsizei vertexStride;
+    const MeshAttribute *attributes;
+    size_t attributeNum;
+    const void *indexData;
+    GLsizei indexNum;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum indexType;
+};
+
+// Indexed mesh in GPU buffers, drawn with glDrawElements
+class Mesh
+{
+public:
+    // Stores indices as 16-bit values when the vertices allow it
+    explicit Mesh(const MeshData &data);
+    // Uploads the streams as they are
+    explicit Mesh(const MeshStreams &streams);
+    ~Mesh();
+
+    Mesh(const Mesh &) = delete;
+    Mesh & operator=(const Mesh &) = delete;
+
+    void Draw() const;
+    void DrawInstanced(GLsizei instanceNum) const;
+
+    GLsizei VertexNum() const { return m_vertexNum; }
+    GLsizei IndexNum() const { return m_indexNum; }
+
+private:
+    void _Create(const MeshStreams &streams);
+
+    GLuint m_vertexBuffer;
+    GLuint m_indexBuffer;
+    GLuint m_vao;
+    GLsizei m_vertexNum;
+    GLsizei m_indexNum;
+    GLenum m_indexType;
+};
+
+#endif
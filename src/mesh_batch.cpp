@@ -0,0 +1,145 @@
+#include <cstring>
+#include "error.hpp"
+#include "mesh_batch.hpp"
+
+MeshBatch::MeshBatch(const std::vector<MeshData> &meshes, size_t maxDrawNum) :
+    m_vertexBuffer(0),
+    m_indexBuffer(0),
+    m_vao(0),
+    m_meshes(),
+    m_maxDrawNum(maxDrawNum),
+    m_commands(),
+    m_instances(),
+    m_commandRing(GL_DRAW_INDIRECT_BUFFER, maxDrawNum * sizeof(DrawElementsIndirectCommand)),
+    m_instanceRing(GL_SHADER_STORAGE_BUFFER, maxDrawNum * sizeof(SceneInstance))
+{
+    // Indices stay relative to their mesh and are offset by baseVertex
+    size_t vertexNum = 0;
+    size_t indexNum = 0;
+    for (size_t i = 0; i < meshes.size(); i++) {
+        MeshRange range;
+        range.firstIndex = static_cast<GLuint>(indexNum);
+        range.indexNum = static_cast<GLuint>(meshes[i].indices.size());
+        range.baseVertex = static_cast<GLint>(vertexNum);
+        range.sphere = ComputeBoundingSphere(meshes[i]);
+        m_meshes.push_back(range);
+        vertexNum += meshes[i].vertices.size();
+        indexNum += meshes[i].indices.size();
+    }
+
+    std::vector<MeshVertex> vertices;
+    std::vector<uint32_t> indices;
+    vertices.reserve(vertexNum);
+    indices.reserve(indexNum);
+    for (size_t i = 0; i < meshes.size(); i++) {
+        vertices.insert(vertices.end(), meshes[i].vertices.begin(), meshes[i].vertices.end());
+        indices.insert(indices.end(), meshes[i].indices.begin(), meshes[i].indices.end());
+    }
+
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertexBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+
+    glGenBuffers(1, &m_indexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexBuffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+
+    glBindVertexBuffer(0, m_vertexBuffer, 0, sizeof(MeshVertex));
+    for (size_t i = 0; i < sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(MESH_VERTEX_ATTRIBUTES[0]); i++) {
+        const MeshAttribute &attribute = MESH_VERTEX_ATTRIBUTES[i];
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribFormat(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.relativeOffset);
+        glVertexAttribBinding(attribute.location, attribute.binding);
+    }
+
+    glBindVertexArray(0);
+
+    m_commands.reserve(maxDrawNum);
+    m_instances.reserve(maxDrawNum);
+}
+
+MeshBatch::~MeshBatch()
+{
+    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_indexBuffer);
+    glDeleteBuffers(1, &m_vertexBuffer);
+}
+
+bool MeshBatch::IsSupported()
+{
+    return GLEW_ARB_shader_draw_parameters != 0;
+}
+
+void MeshBatch::Add(size_t meshIndex, const SceneInstance &instance)
+{
+    if (m_commands.size() == m_maxDrawNum) {
+        THROW(Error, "Too many draws in mesh batch");
+    }
+
+    m_commands.push_back(MeshCommand(meshIndex));
+    m_instances.push_back(instance);
+}
+
+DrawElementsIndirectCommand MeshBatch::MeshCommand(size_t meshIndex) const
+{
+    const MeshRange &range = m_meshes[meshIndex];
+    DrawElementsIndirectCommand command;
+    command.count = range.indexNum;
+    command.instanceCount = 1;
+    command.firstIndex = range.firstIndex;
+    command.baseVertex = range.baseVertex;
+    command.baseInstance = 0;
+    return command;
+}
+
+void MeshBatch::Submit()
+{
+    if (m_commands.empty()) {
+        return;
+    }
+
+    // Commands and instances go to the same index of their rings, so that
+    // gl_DrawIDARB finds the instance of its command
+    m_commandRing.BeginFrame();
+    m_instanceRing.BeginFrame();
+
+    GLsizeiptr commandSize = m_commands.size() * sizeof(DrawElementsIndirectCommand);
+    StreamAllocation commands = m_commandRing.Allocate(commandSize, sizeof(GLuint));
+    std::memcpy(commands.data, m_commands.data(), commandSize);
+
+    GLsizeiptr instanceSize = m_instances.size() * sizeof(SceneInstance);
+    StreamAllocation instances = m_instanceRing.Allocate(instanceSize);
+    std::memcpy(instances.data, m_instances.data(), instanceSize);
+    m_instanceRing.BindRange(INSTANCE_BUFFER_BINDING, instances);
+
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandRing.Handle());
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<const void *>(commands.offset),
+                                static_cast<GLsizei>(m_commands.size()), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+    m_instanceRing.EndFrame();
+    m_commandRing.EndFrame();
+
+    m_commands.clear();
+    m_instances.clear();
+}
+
+void MeshBatch::Draw(size_t meshIndex) const
+{
+    const MeshRange &range = m_meshes[meshIndex];
+    glBindVertexArray(m_vao);
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexNum, GL_UNSIGNED_INT,
+                             reinterpret_cast<const void *>(range.firstIndex * sizeof(uint32_t)), range.baseVertex);
+}
+
+void MeshBatch::DrawIndirect(GLuint commandBuffer, GLsizei drawNum) const
+{
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, drawNum, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
@@ -0,0 +1,75 @@
+#ifndef MESH_BATCH_HPP
+#define MESH_BATCH_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+#include "mesh.hpp"
+#include "scene.hpp"
+#include "stream_buffer.hpp"
+
+// Command layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Meshes packed into one vertex and one index buffer behind a single VAO,
+// so that draws of any of them can go out together. Each frame, Add() the
+// objects to draw and Submit() them as one glMultiDrawElementsIndirect
+// call. The per-object instance data is streamed to the InstanceBuffer
+// storage block, indexed by gl_DrawIDARB in the MULTI_DRAW variant of
+// ads.vert.
+class MeshBatch
+{
+public:
+    // Up to maxDrawNum objects per frame
+    MeshBatch(const std::vector<MeshData> &meshes, size_t maxDrawNum);
+    ~MeshBatch();
+
+    MeshBatch(const MeshBatch &) = delete;
+    MeshBatch & operator=(const MeshBatch &) = delete;
+
+    // gl_DrawIDARB needs ARB_shader_draw_parameters
+    static bool IsSupported();
+
+    size_t MeshNum() const { return m_meshes.size(); }
+    const MeshSphere & BoundingSphere(size_t meshIndex) const { return m_meshes[meshIndex].sphere; }
+    // Command drawing one instance of a mesh
+    DrawElementsIndirectCommand MeshCommand(size_t meshIndex) const;
+    size_t DrawNum() const { return m_commands.size(); }
+
+    void Add(size_t meshIndex, const SceneInstance &instance);
+    // Draw everything added since the last call, once per frame
+    void Submit();
+
+    // Single draw of one mesh, for programs without per-draw data
+    void Draw(size_t meshIndex) const;
+    // Draw commands written by the GPU into a buffer, from its start
+    void DrawIndirect(GLuint commandBuffer, GLsizei drawNum) const;
+
+private:
+    struct MeshRange
+    {
+        GLuint firstIndex;
+        GLuint indexNum;
+        GLint baseVertex;
+        MeshSphere sphere;
+    };
+
+    GLuint m_vertexBuffer;
+    GLuint m_indexBuffer;
+    GLuint m_vao;
+    std::vector<MeshRange> m_meshes;
+    size_t m_maxDrawNum;
+    std::vector<DrawElementsIndirectCommand> m_commands;
+    std::vector<SceneInstance> m_instances;
+    StreamBuffer m_commandRing;
+    StreamBuffer m_instanceRing;
+};
+
+#endif
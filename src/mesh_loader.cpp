@@ -0,0 +1,982 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_map>
+#include "error.hpp"
+#include "mapped_file.hpp"
+#include "mesh_loader.hpp"
+#include "parallel.hpp"
+#include "trace.hpp"
+
+// Text is parsed in chunks of about this size, split at line ends
+static const size_t PARSE_CHUNK_SIZE = 4 * 1024 * 1024;
+// Binary PLY records are decoded in batches of this many
+static const size_t PLY_RECORD_BATCH = 64 * 1024;
+static const uint32_t NO_INDEX = 0xFFFFFFFF;
+
+// PLY properties are written into MeshVertex as an array of floats
+static_assert(sizeof(MeshVertex) == sizeof(float) * 6, "MeshVertex must be six packed floats");
+
+// Powers of ten that are exact in a double
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+struct TextRange
+{
+    const char *begin;
+    const char *end;
+};
+
+static bool IsSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static const char * SkipSpaces(const char *p, const char *end)
+{
+    while (p != end && IsSpace(*p)) {
+        p++;
+    }
+    return p;
+}
+
+static const char * LineEnd(const char *p, const char *end)
+{
+    const char *newline = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// Split text into ranges of at least chunkSize bytes, each ending after a
+// newline (or at the end of the text)
+static std::vector<TextRange> SplitLines(const char *begin, const char *end, size_t chunkSize)
+{
+    std::vector<TextRange> chunks;
+    const char *p = begin;
+    while (p != end) {
+        const char *chunkEnd = end;
+        if (static_cast<size_t>(end - p) > chunkSize) {
+            chunkEnd = LineEnd(p + chunkSize, end);
+            if (chunkEnd != end) {
+                chunkEnd++;
+            }
+        }
+        TextRange chunk = { p, chunkEnd };
+        chunks.push_back(chunk);
+        p = chunkEnd;
+    }
+    return chunks;
+}
+
+// Decimal to float without locale or stream overhead. Up to 19 significant
+// digits with a decimal exponent within +-22, which covers nearly all mesh
+// data, take one exact scaling of an exact integer; anything else goes
+// through strtof. Returns the end of the number, or nullptr if there is none.
+static const char * ParseFloat(const char *p, const char *end, float &value)
+{
+    const char *start = p;
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digitNum = 0;
+    int exponent = 0;
+    bool truncated = false;
+    bool hasDigits = false;
+    for (; p != end && IsDigit(*p); p++) {
+        hasDigits = true;
+        if (digitNum < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digitNum += mantissa != 0;
+        } else {
+            exponent++;
+            truncated |= *p != '0';
+        }
+    }
+    if (p != end && *p == '.') {
+        for (p++; p != end && IsDigit(*p); p++) {
+            hasDigits = true;
+            if (digitNum < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digitNum += mantissa != 0;
+                exponent--;
+            } else {
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if (!hasDigits) {
+        return nullptr;
+    }
+
+    if (p != end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q != end && (*q == '-' || *q == '+')) {
+            negativeExponent = *q == '-';
+            q++;
+        }
+        if (q != end && IsDigit(*q)) {
+            int exponentValue = 0;
+            for (; q != end && IsDigit(*q); q++) {
+                if (exponentValue < 10000) {
+                    exponentValue = exponentValue * 10 + (*q - '0');
+                }
+            }
+            exponent += negativeExponent ? -exponentValue : exponentValue;
+            p = q;
+        }
+    }
+
+    if (!truncated && (mantissa == 0 || (mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22))) {
+        double result = static_cast<double>(mantissa);
+        if (mantissa != 0) {
+            result = exponent < 0 ? result / POW10[-exponent] : result * POW10[exponent];
+        }
+        value = static_cast<float>(negative ? -result : result);
+        return p;
+    }
+
+    char buffer[64];
+    size_t length = std::min<size_t>(p - start, sizeof(buffer) - 1);
+    std::memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    value = std::strtof(buffer, nullptr);
+    return p;
+}
+
+static const char * ParseInt(const char *p, const char *end, int64_t &value)
+{
+    bool negative = false;
+    if (p != end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p == end || !IsDigit(*p)) {
+        return nullptr;
+    }
+
+    int64_t result = 0;
+    for (; p != end && IsDigit(*p); p++) {
+        // Saturate instead of overflowing, so that range checks fail
+        if (result < (int64_t(1) << 40)) {
+            result = result * 10 + (*p - '0');
+        }
+    }
+    value = negative ? -result : result;
+    return p;
+}
+
+static const char * ParseVec3(const char *p, const char *end, glm::vec3 &value)
+{
+    for (int i = 0; i < 3 && p; i++) {
+        p = ParseFloat(SkipSpaces(p, end), end, value[i]);
+    }
+    return p;
+}
+
+// Area-weighted vertex normals: the sum of the unnormalized face normals
+// around each vertex
+static void ComputeVertexNormals(MeshData &mesh)
+{
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        mesh.vertices[i].normal = glm::vec3(0.0f);
+    }
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        MeshVertex &v0 = mesh.vertices[mesh.indices[i]];
+        MeshVertex &v1 = mesh.vertices[mesh.indices[i + 1]];
+        MeshVertex &v2 = mesh.vertices[mesh.indices[i + 2]];
+        glm::vec3 normal = glm::cross(v1.position - v0.position, v2.position - v0.position);
+        v0.normal += normal;
+        v1.normal += normal;
+        v2.normal += normal;
+    }
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        glm::vec3 &normal = mesh.vertices[i].normal;
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+}
+
+//
+// OBJ
+//
+
+struct ObjCorner
+{
+    uint32_t position;
+    uint32_t normal;
+};
+
+struct ObjChunk
+{
+    TextRange text;
+    // Positions and normals defined in the chunk, and before it
+    size_t positionNum;
+    size_t normalNum;
+    size_t positionOffset;
+    size_t normalOffset;
+    // Triangle corners
+    std::vector<ObjCorner> corners;
+    bool missingNormals;
+};
+
+// OBJ indices are 1-based, or negative to count back from the last element
+// defined so far
+static uint32_t ResolveObjIndex(int64_t index, size_t definedNum, size_t totalNum)
+{
+    int64_t resolved = index > 0 ? index - 1 : static_cast<int64_t>(definedNum) + index;
+    if (index == 0 || resolved < 0 || resolved >= static_cast<int64_t>(totalNum)) {
+        return NO_INDEX;
+    }
+    return static_cast<uint32_t>(resolved);
+}
+
+// First pass: count the positions and normals in a chunk, so that every
+// chunk knows where its elements go before parsing
+static void CountObjChunk(ObjChunk &chunk)
+{
+    const char *end = chunk.text.end;
+    for (const char *p = chunk.text.begin; p < end; ) {
+        const char *lineEnd = LineEnd(p, end);
+        p = SkipSpaces(p, lineEnd);
+        if (lineEnd - p >= 2 && p[0] == 'v') {
+            if (IsSpace(p[1])) {
+                chunk.positionNum++;
+            } else if (p[1] == 'n' && lineEnd - p >= 3 && IsSpace(p[2])) {
+                chunk.normalNum++;
+            }
+        }
+        p = lineEnd + 1;
+    }
+}
+
+static void ParseObjChunk(ObjChunk &chunk, std::vector<glm::vec3> &positions, std::vector<glm::vec3> &normals, const std::string &path)
+{
+    size_t positionIndex = chunk.positionOffset;
+    size_t normalIndex = chunk.normalOffset;
+    std::vector<ObjCorner> polygon;
+
+    const char *end = chunk.text.end;
+    for (const char *p = chunk.text.begin; p < end; ) {
+        const char *lineEnd = LineEnd(p, end);
+        const char *line = SkipSpaces(p, lineEnd);
+        p = lineEnd + 1;
+        if (lineEnd - line < 2) {
+            continue;
+        }
+
+        if (line[0] == 'v' && IsSpace(line[1])) {
+            if (!ParseVec3(line + 2, lineEnd, positions[positionIndex++])) {
+                THROW(Error, "Invalid vertex position in OBJ file: " + path);
+            }
+        } else if (line[0] == 'v' && line[1] == 'n' && lineEnd - line >= 3 && IsSpace(line[2])) {
+            if (!ParseVec3(line + 3, lineEnd, normals[normalIndex++])) {
+                THROW(Error, "Invalid vertex normal in OBJ file: " + path);
+            }
+        } else if (line[0] == 'f' && IsSpace(line[1])) {
+            // Corners are "v", "v/vt", "v//vn" or "v/vt/vn"
+            polygon.clear();
+            const char *q = line + 2;
+            for (;;) {
+                q = SkipSpaces(q, lineEnd);
+                if (q == lineEnd) {
+                    break;
+                }
+
+                ObjCorner corner = { NO_INDEX, NO_INDEX };
+                int64_t index = 0;
+                q = ParseInt(q, lineEnd, index);
+                if (q) {
+                    corner.position = ResolveObjIndex(index, positionIndex, positions.size());
+                }
+                if (q && q != lineEnd && *q == '/') {
+                    q++;
+                    if (q != lineEnd && *q != '/') {
+                        q = ParseInt(q, lineEnd, index);
+                    }
+                    if (q && q != lineEnd && *q == '/') {
+                        q = ParseInt(q + 1, lineEnd, index);
+                        if (q) {
+                            corner.normal = ResolveObjIndex(index, normalIndex, normals.size());
+                            if (corner.normal == NO_INDEX) {
+                                q = nullptr;
+                            }
+                        }
+                    }
+                }
+                if (!q || corner.position == NO_INDEX || (q != lineEnd && !IsSpace(*q))) {
+                    THROW(Error, "Invalid face in OBJ file: " + path);
+                }
+                polygon.push_back(corner);
+                chunk.missingNormals |= corner.normal == NO_INDEX;
+            }
+            if (polygon.size() < 3) {
+                THROW(Error, "Face with less than three corners in OBJ file: " + path);
+            }
+
+            for (size_t i = 2; i < polygon.size(); i++) {
+                chunk.corners.push_back(polygon[0]);
+                chunk.corners.push_back(polygon[i - 1]);
+                chunk.corners.push_back(polygon[i]);
+            }
+        }
+    }
+}
+
+static MeshData LoadObj(const char *data, size_t size, unsigned threadNum, const std::string &path)
+{
+    std::vector<TextRange> ranges = SplitLines(data, data + size, PARSE_CHUNK_SIZE);
+    std::vector<ObjChunk> chunks(ranges.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        chunks[i].text = ranges[i];
+        chunks[i].positionNum = 0;
+        chunks[i].normalNum = 0;
+        chunks[i].missingNormals = false;
+    }
+
+    ParallelFor(chunks.size(), threadNum, [&](size_t i) {
+        CountObjChunk(chunks[i]);
+    });
+
+    size_t positionNum = 0;
+    size_t normalNum = 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        chunks[i].positionOffset = positionNum;
+        chunks[i].normalOffset = normalNum;
+        positionNum += chunks[i].positionNum;
+        normalNum += chunks[i].normalNum;
+    }
+    if (positionNum >= NO_INDEX) {
+        THROW(Error, "Too many vertices in OBJ file: " + path);
+    }
+
+    std::vector<glm::vec3> positions(positionNum);
+    std::vector<glm::vec3> normals(normalNum);
+    ParallelFor(chunks.size(), threadNum, [&](size_t i) {
+        ParseObjChunk(chunks[i], positions, normals, path);
+    });
+
+    size_t cornerNum = 0;
+    bool hasNormals = normalNum > 0;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        cornerNum += chunks[i].corners.size();
+        hasNormals &= !chunks[i].missingNormals;
+    }
+
+    MeshData mesh;
+    mesh.indices.reserve(cornerNum);
+    if (!hasNormals) {
+        mesh.vertices.resize(positionNum);
+        for (size_t i = 0; i < positionNum; i++) {
+            mesh.vertices[i].position = positions[i];
+        }
+        for (size_t i = 0; i < chunks.size(); i++) {
+            const std::vector<ObjCorner> &corners = chunks[i].corners;
+            for (size_t j = 0; j < corners.size(); j++) {
+                mesh.indices.push_back(corners[j].position);
+            }
+        }
+        ComputeVertexNormals(mesh);
+        return mesh;
+    }
+
+    // One vertex per distinct position/normal pair. Most positions come with
+    // a single normal, so the first pair is found directly by position and
+    // only the others go through a hash map.
+    std::vector<uint32_t> firstVertex(positionNum, NO_INDEX);
+    std::vector<uint32_t> firstNormal(positionNum, NO_INDEX);
+    std::unordered_map<uint64_t, uint32_t> otherVertices;
+    mesh.vertices.reserve(positionNum);
+    for (size_t i = 0; i < chunks.size(); i++) {
+        const std::vector<ObjCorner> &corners = chunks[i].corners;
+        for (size_t j = 0; j < corners.size(); j++) {
+            const ObjCorner &corner = corners[j];
+            uint32_t newVertex = static_cast<uint32_t>(mesh.vertices.size());
+            uint32_t vertex = newVertex;
+            if (firstVertex[corner.position] == NO_INDEX) {
+                firstVertex[corner.position] = newVertex;
+                firstNormal[corner.position] = corner.normal;
+            } else if (firstNormal[corner.position] == corner.normal) {
+                vertex = firstVertex[corner.position];
+            } else {
+                uint64_t key = (static_cast<uint64_t>(corner.position) << 32) | corner.normal;
+                vertex = otherVertices.insert(std::make_pair(key, newVertex)).first->second;
+            }
+
+            if (vertex == newVertex) {
+                MeshVertex meshVertex;
+                meshVertex.position = positions[corner.position];
+                meshVertex.normal = normals[corner.normal];
+                mesh.vertices.push_back(meshVertex);
+            }
+            mesh.indices.push_back(vertex);
+        }
+    }
+    return mesh;
+}
+
+//
+// PLY
+//
+
+enum PlyFormat
+{
+    PLY_ASCII,
+    PLY_BINARY_LITTLE_ENDIAN,
+    PLY_BINARY_BIG_ENDIAN,
+};
+
+enum PlyType
+{
+    PLY_INT8,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64,
+};
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type;
+    // Lists have a count of countType, then that many items of type
+    bool isList;
+    PlyType countType;
+};
+
+struct PlyElement
+{
+    std::string name;
+    size_t count;
+    std::vector<PlyProperty> properties;
+};
+
+static bool ParsePlyType(const std::string &name, PlyType &type)
+{
+    static const struct { const char *name; PlyType type; } TYPES[] = {
+        { "char", PLY_INT8 }, { "int8", PLY_INT8 },
+        { "uchar", PLY_UINT8 }, { "uint8", PLY_UINT8 },
+        { "short", PLY_INT16 }, { "int16", PLY_INT16 },
+        { "ushort", PLY_UINT16 }, { "uint16", PLY_UINT16 },
+        { "int", PLY_INT32 }, { "int32", PLY_INT32 },
+        { "uint", PLY_UINT32 }, { "uint32", PLY_UINT32 },
+        { "float", PLY_FLOAT32 }, { "float32", PLY_FLOAT32 },
+        { "double", PLY_FLOAT64 }, { "float64", PLY_FLOAT64 },
+    };
+    for (size_t i = 0; i < sizeof(TYPES) / sizeof(TYPES[0]); i++) {
+        if (name == TYPES[i].name) {
+            type = TYPES[i].type;
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t PlyTypeSize(PlyType type)
+{
+    static const size_t SIZES[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+    return SIZES[type];
+}
+
+static bool IsBigEndianHost()
+{
+    uint16_t value = 1;
+    unsigned char firstByte;
+    std::memcpy(&firstByte, &value, 1);
+    return firstByte == 0;
+}
+
+static double ReadPlyValue(const char *p, PlyType type, bool swapBytes)
+{
+    char bytes[8];
+    size_t size = PlyTypeSize(type);
+    if (swapBytes) {
+        std::reverse_copy(p, p + size, bytes);
+    } else {
+        std::memcpy(bytes, p, size);
+    }
+
+    switch (type) {
+    case PLY_INT8: { int8_t value; std::memcpy(&value, bytes, 1); return value; }
+    case PLY_UINT8: { uint8_t value; std::memcpy(&value, bytes, 1); return value; }
+    case PLY_INT16: { int16_t value; std::memcpy(&value, bytes, 2); return value; }
+    case PLY_UINT16: { uint16_t value; std::memcpy(&value, bytes, 2); return value; }
+    case PLY_INT32: { int32_t value; std::memcpy(&value, bytes, 4); return value; }
+    case PLY_UINT32: { uint32_t value; std::memcpy(&value, bytes, 4); return value; }
+    case PLY_FLOAT32: { float value; std::memcpy(&value, bytes, 4); return value; }
+    case PLY_FLOAT64: { double value; std::memcpy(&value, bytes, 8); return value; }
+    }
+    return 0.0;
+}
+
+static std::vector<std::string> SplitWords(const char *p, const char *end)
+{
+    std::vector<std::string> words;
+    for (;;) {
+        p = SkipSpaces(p, end);
+        if (p == end) {
+            return words;
+        }
+        const char *wordEnd = p;
+        while (wordEnd != end && !IsSpace(*wordEnd)) {
+            wordEnd++;
+        }
+        words.push_back(std::string(p, wordEnd));
+        p = wordEnd;
+    }
+}
+
+// Parse the header and return the start of the body
+static const char * ParsePlyHeader(const char *data, const char *end, PlyFormat &format, std::vector<PlyElement> &elements, const std::string &path)
+{
+    bool hasFormat = false;
+    const char *p = data;
+    for (size_t lineIndex = 0; p < end; lineIndex++) {
+        const char *lineEnd = LineEnd(p, end);
+        std::vector<std::string> words = SplitWords(p, lineEnd);
+        p = lineEnd + 1;
+
+        if (lineIndex == 0) {
+            if (words.size() != 1 || words[0] != "ply") {
+                THROW(Error, "Not a PLY file: " + path);
+            }
+        } else if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        } else if (words[0] == "format" && words.size() >= 2) {
+            if (words[1] == "ascii") {
+                format = PLY_ASCII;
+            } else if (words[1] == "binary_little_endian") {
+                format = PLY_BINARY_LITTLE_ENDIAN;
+            } else if (words[1] == "binary_big_endian") {
+                format = PLY_BINARY_BIG_ENDIAN;
+            } else {
+                THROW(Error, "Unknown PLY format " + words[1] + ": " + path);
+            }
+            hasFormat = true;
+        } else if (words[0] == "element" && words.size() == 3) {
+            PlyElement element;
+            element.name = words[1];
+            element.count = static_cast<size_t>(std::strtoull(words[2].c_str(), nullptr, 10));
+            elements.push_back(element);
+        } else if (words[0] == "property" && !elements.empty()) {
+            PlyProperty property;
+            property.isList = words.size() == 5 && words[1] == "list";
+            bool valid = property.isList
+                ? ParsePlyType(words[2], property.countType) && ParsePlyType(words[3], property.type)
+                : words.size() == 3 && ParsePlyType(words[1], property.type);
+            if (!valid) {
+                THROW(Error, "Invalid PLY property in " + path);
+            }
+            property.name = words.back();
+            elements.back().properties.push_back(property);
+        } else if (words[0] == "end_header") {
+            if (!hasFormat) {
+                THROW(Error, "PLY header has no format: " + path);
+            }
+            return std::min(p, end);
+        } else {
+            THROW(Error, "Invalid PLY header line in " + path);
+        }
+    }
+    THROW(Error, "PLY header has no end: " + path);
+}
+
+static int FindPlyProperty(const PlyElement &element, const char *name)
+{
+    for (size_t i = 0; i < element.properties.size(); i++) {
+        if (element.properties[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Fan-triangulate a polygon into indices, checking its vertex indices
+static void AddPlyPolygon(const std::vector<int64_t> &polygon, size_t vertexNum, std::vector<uint32_t> &indices, const std::string &path)
+{
+    for (size_t i = 0; i < polygon.size(); i++) {
+        if (polygon[i] < 0 || polygon[i] >= static_cast<int64_t>(vertexNum)) {
+            THROW(Error, "Face vertex index out of range in PLY file: " + path);
+        }
+    }
+    for (size_t i = 2; i < polygon.size(); i++) {
+        indices.push_back(static_cast<uint32_t>(polygon[0]));
+        indices.push_back(static_cast<uint32_t>(polygon[i - 1]));
+        indices.push_back(static_cast<uint32_t>(polygon[i]));
+    }
+}
+
+class PlyReader
+{
+public:
+    PlyReader(const char *body, const char *end, PlyFormat format, unsigned threadNum, const std::string &path);
+
+    // Read an element in place, advancing past it. Vertex positions and
+    // normals are stored in mesh; faces are triangulated into its indices.
+    void ReadVertices(const PlyElement &element, MeshData &mesh, bool &hasNormals);
+    void ReadFaces(const PlyElement &element, MeshData &mesh);
+    void SkipElement(const PlyElement &element);
+
+private:
+    // End of the next lineNum lines
+    const char * _SkipLines(size_t lineNum);
+    const char * _SkipBinaryValue(const char *p, const PlyProperty &property, std::vector<int64_t> *items);
+    // Binary faces that are all triangles have fixed-size records, which
+    // are decoded in parallel. Returns false, reading nothing, for other
+    // faces.
+    bool _ReadBinaryTriangles(const PlyElement &element, MeshData &mesh);
+
+    const char *m_p;
+    const char *m_end;
+    PlyFormat m_format;
+    bool m_swapBytes;
+    unsigned m_threadNum;
+    const std::string &m_path;
+};
+
+PlyReader::PlyReader(const char *body, const char *end, PlyFormat format, unsigned threadNum, const std::string &path) :
+    m_p(body),
+    m_end(end),
+    m_format(format),
+    m_swapBytes(format != PLY_ASCII && (format == PLY_BINARY_BIG_ENDIAN) != IsBigEndianHost()),
+    m_threadNum(threadNum),
+    m_path(path)
+{
+}
+
+const char * PlyReader::_SkipLines(size_t lineNum)
+{
+    const char *p = m_p;
+    for (size_t i = 0; i < lineNum; i++) {
+        if (p >= m_end) {
+            THROW(Error, "Unexpected end of PLY file: " + m_path);
+        }
+        p = LineEnd(p, m_end) + 1;
+    }
+    return std::min(p, m_end);
+}
+
+const char * PlyReader::_SkipBinaryValue(const char *p, const PlyProperty &property, std::vector<int64_t> *items)
+{
+    size_t itemNum = 1;
+    if (property.isList) {
+        size_t countSize = PlyTypeSize(property.countType);
+        if (static_cast<size_t>(m_end - p) < countSize) {
+            THROW(Error, "Unexpected end of PLY file: " + m_path);
+        }
+        itemNum = static_cast<size_t>(ReadPlyValue(p, property.countType, m_swapBytes));
+        p += countSize;
+    }
+
+    size_t itemSize = PlyTypeSize(property.type);
+    if (static_cast<size_t>(m_end - p) / itemSize < itemNum) {
+        THROW(Error, "Unexpected end of PLY file: " + m_path);
+    }
+    if (items) {
+        items->clear();
+        for (size_t i = 0; i < itemNum; i++) {
+            items->push_back(static_cast<int64_t>(ReadPlyValue(p + i * itemSize, property.type, m_swapBytes)));
+        }
+    }
+    return p + itemNum * itemSize;
+}
+
+void PlyReader::ReadVertices(const PlyElement &element, MeshData &mesh, bool &hasNormals)
+{
+    int x = FindPlyProperty(element, "x");
+    int y = FindPlyProperty(element, "y");
+    int z = FindPlyProperty(element, "z");
+    int nx = FindPlyProperty(element, "nx");
+    int ny = FindPlyProperty(element, "ny");
+    int nz = FindPlyProperty(element, "nz");
+    if (x < 0 || y < 0 || z < 0) {
+        THROW(Error, "PLY vertices have no position: " + m_path);
+    }
+    hasNormals = nx >= 0 && ny >= 0 && nz >= 0;
+    if (element.count >= NO_INDEX) {
+        THROW(Error, "Too many vertices in PLY file: " + m_path);
+    }
+
+    // Property index -> float destination in MeshVertex, or -1
+    std::vector<int> targets(element.properties.size(), -1);
+    targets[x] = 0;
+    targets[y] = 1;
+    targets[z] = 2;
+    if (hasNormals) {
+        targets[nx] = 3;
+        targets[ny] = 4;
+        targets[nz] = 5;
+    }
+    for (size_t i = 0; i < element.properties.size(); i++) {
+        if (element.properties[i].isList) {
+            THROW(Error, "PLY vertex lists are not supported: " + m_path);
+        }
+    }
+
+    mesh.vertices.resize(element.count);
+    if (m_format == PLY_ASCII) {
+        const char *sectionEnd = _SkipLines(element.count);
+        std::vector<TextRange> chunks = SplitLines(m_p, sectionEnd, PARSE_CHUNK_SIZE);
+
+        // Line counts give each chunk its first vertex
+        std::vector<size_t> firstVertex(chunks.size() + 1, 0);
+        ParallelFor(chunks.size(), m_threadNum, [&](size_t i) {
+            firstVertex[i + 1] = std::count(chunks[i].begin, chunks[i].end, '\n');
+        });
+        for (size_t i = 0; i < chunks.size(); i++) {
+            firstVertex[i + 1] += firstVertex[i];
+        }
+
+        ParallelFor(chunks.size(), m_threadNum, [&](size_t i) {
+            const char *end = chunks[i].end;
+            size_t vertex = firstVertex[i];
+            for (const char *p = chunks[i].begin; p < end && vertex < element.count; vertex++) {
+                const char *lineEnd = LineEnd(p, end);
+                float *values = &mesh.vertices[vertex].position.x;
+                const char *q = p;
+                for (size_t j = 0; j < targets.size() && q; j++) {
+                    float value = 0.0f;
+                    q = ParseFloat(SkipSpaces(q, lineEnd), lineEnd, value);
+                    if (targets[j] >= 0) {
+                        values[targets[j]] = value;
+                    }
+                }
+                if (!q) {
+                    THROW(Error, "Invalid vertex in PLY file: " + m_path);
+                }
+                p = lineEnd + 1;
+            }
+        });
+        m_p = sectionEnd;
+    } else {
+        // Fixed-size records: decode batches in parallel straight from the
+        // mapping
+        std::vector<size_t> offsets(element.properties.size());
+        size_t stride = 0;
+        for (size_t i = 0; i < element.properties.size(); i++) {
+            offsets[i] = stride;
+            stride += PlyTypeSize(element.properties[i].type);
+        }
+        if (static_cast<size_t>(m_end - m_p) / stride < element.count) {
+            THROW(Error, "Unexpected end of PLY file: " + m_path);
+        }
+
+        const char *records = m_p;
+        size_t batchNum = (element.count + PLY_RECORD_BATCH - 1) / PLY_RECORD_BATCH;
+        ParallelFor(batchNum, m_threadNum, [&](size_t batch) {
+            size_t first = batch * PLY_RECORD_BATCH;
+            size_t last = std::min(first + PLY_RECORD_BATCH, element.count);
+            for (size_t vertex = first; vertex < last; vertex++) {
+                const char *record = records + vertex * stride;
+                float *values = &mesh.vertices[vertex].position.x;
+                for (size_t j = 0; j < targets.size(); j++) {
+                    if (targets[j] >= 0) {
+                        values[targets[j]] = static_cast<float>(ReadPlyValue(record + offsets[j], element.properties[j].type, m_swapBytes));
+                    }
+                }
+            }
+        });
+        m_p += stride * element.count;
+    }
+}
+
+void PlyReader::ReadFaces(const PlyElement &element, MeshData &mesh)
+{
+    int indexProperty = FindPlyProperty(element, "vertex_indices");
+    if (indexProperty < 0) {
+        indexProperty = FindPlyProperty(element, "vertex_index");
+    }
+    if (indexProperty < 0 || !element.properties[indexProperty].isList) {
+        THROW(Error, "PLY faces have no vertex index list: " + m_path);
+    }
+    size_t vertexNum = mesh.vertices.size();
+
+    if (m_format == PLY_ASCII) {
+        const char *sectionEnd = _SkipLines(element.count);
+        std::vector<TextRange> chunks = SplitLines(m_p, sectionEnd, PARSE_CHUNK_SIZE);
+        std::vector<std::vector<uint32_t> > chunkIndices(chunks.size());
+
+        ParallelFor(chunks.size(), m_threadNum, [&](size_t i) {
+            std::vector<int64_t> polygon;
+            const char *end = chunks[i].end;
+            for (const char *p = chunks[i].begin; p < end; ) {
+                const char *lineEnd = LineEnd(p, end);
+                const char *q = p;
+                for (size_t j = 0; j < element.properties.size() && q; j++) {
+                    const PlyProperty &property = element.properties[j];
+                    if (!property.isList) {
+                        float value;
+                        q = ParseFloat(SkipSpaces(q, lineEnd), lineEnd, value);
+                        continue;
+                    }
+
+                    int64_t itemNum = 0;
+                    q = ParseInt(SkipSpaces(q, lineEnd), lineEnd, itemNum);
+                    if (static_cast<int>(j) == indexProperty) {
+                        polygon.clear();
+                    }
+                    for (int64_t k = 0; k < itemNum && q; k++) {
+                        int64_t item = 0;
+                        q = ParseInt(SkipSpaces(q, lineEnd), lineEnd, item);
+                        if (static_cast<int>(j) == indexProperty) {
+                            polygon.push_back(item);
+                        }
+                    }
+                }
+                if (!q) {
+                    THROW(Error, "Invalid face in PLY file: " + m_path);
+                }
+                AddPlyPolygon(polygon, vertexNum, chunkIndices[i], m_path);
+                p = lineEnd + 1;
+            }
+        });
+
+        for (size_t i = 0; i < chunkIndices.size(); i++) {
+            mesh.indices.insert(mesh.indices.end(), chunkIndices[i].begin(), chunkIndices[i].end());
+        }
+        m_p = sectionEnd;
+    } else {
+        if (_ReadBinaryTriangles(element, mesh)) {
+            return;
+        }
+
+        // Records vary in size, so they are walked in order
+        std::vector<int64_t> polygon;
+        mesh.indices.reserve(mesh.indices.size() + element.count * 3);
+        for (size_t i = 0; i < element.count; i++) {
+            for (size_t j = 0; j < element.properties.size(); j++) {
+                bool isIndexList = static_cast<int>(j) == indexProperty;
+                m_p = _SkipBinaryValue(m_p, element.properties[j], isIndexList ? &polygon : nullptr);
+            }
+            AddPlyPolygon(polygon, vertexNum, mesh.indices, m_path);
+        }
+    }
+}
+
+bool PlyReader::_ReadBinaryTriangles(const PlyElement &element, MeshData &mesh)
+{
+    if (element.properties.size() != 1) {
+        return false;
+    }
+    const PlyProperty &property = element.properties[0];
+    size_t countSize = PlyTypeSize(property.countType);
+    size_t itemSize = PlyTypeSize(property.type);
+    size_t recordSize = countSize + itemSize * 3;
+    if (static_cast<size_t>(m_end - m_p) / recordSize < element.count) {
+        return false;
+    }
+
+    size_t firstIndex = mesh.indices.size();
+    size_t vertexNum = mesh.vertices.size();
+    mesh.indices.resize(firstIndex + element.count * 3);
+    uint32_t *indices = mesh.indices.data() + firstIndex;
+    const char *records = m_p;
+    std::atomic<bool> allTriangles(true);
+    std::atomic<bool> inRange(true);
+
+    size_t batchNum = (element.count + PLY_RECORD_BATCH - 1) / PLY_RECORD_BATCH;
+    ParallelFor(batchNum, m_threadNum, [&](size_t batch) {
+        size_t first = batch * PLY_RECORD_BATCH;
+        size_t last = std::min(first + PLY_RECORD_BATCH, element.count);
+        for (size_t face = first; face < last && allTriangles.load(std::memory_order_relaxed); face++) {
+            const char *record = records + face * recordSize;
+            if (ReadPlyValue(record, property.countType, m_swapBytes) != 3.0) {
+                allTriangles.store(false, std::memory_order_relaxed);
+                break;
+            }
+            for (size_t k = 0; k < 3; k++) {
+                double index = ReadPlyValue(record + countSize + k * itemSize, property.type, m_swapBytes);
+                if (index < 0.0 || index >= static_cast<double>(vertexNum)) {
+                    inRange.store(false, std::memory_order_relaxed);
+                }
+                indices[face * 3 + k] = static_cast<uint32_t>(index);
+            }
+        }
+    });
+
+    if (!allTriangles) {
+        mesh.indices.resize(firstIndex);
+        return false;
+    }
+    if (!inRange) {
+        THROW(Error, "Face vertex index out of range in PLY file: " + m_path);
+    }
+    m_p += recordSize * element.count;
+    return true;
+}
+
+void PlyReader::SkipElement(const PlyElement &element)
+{
+    if (m_format == PLY_ASCII) {
+        m_p = _SkipLines(element.count);
+        return;
+    }
+    for (size_t i = 0; i < element.count; i++) {
+        for (size_t j = 0; j < element.properties.size(); j++) {
+            m_p = _SkipBinaryValue(m_p, element.properties[j], nullptr);
+        }
+    }
+}
+
+static MeshData LoadPly(const char *data, size_t size, unsigned threadNum, const std::string &path)
+{
+    PlyFormat format = PLY_ASCII;
+    std::vector<PlyElement> elements;
+    const char *end = data + size;
+    const char *body = ParsePlyHeader(data, end, format, elements, path);
+
+    MeshData mesh;
+    bool hasVertices = false;
+    bool hasNormals = false;
+    PlyReader reader(body, end, format, threadNum, path);
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].name == "vertex" && !hasVertices) {
+            reader.ReadVertices(elements[i], mesh, hasNormals);
+            hasVertices = true;
+        } else if (elements[i].name == "face" && hasVertices) {
+            reader.ReadFaces(elements[i], mesh);
+        } else if (elements[i].name == "face") {
+            THROW(Error, "PLY faces come before vertices: " + path);
+        } else {
+            reader.SkipElement(elements[i]);
+        }
+    }
+
+    if (!hasNormals) {
+        ComputeVertexNormals(mesh);
+    }
+    return mesh;
+}
+
+MeshData LoadMesh(const std::string &path, unsigned threadNum)
+{
+    TraceZone zone("load mesh", "mesh");
+    zone.SetDetail(path.c_str());
+
+    std::string extension = path.substr(path.find_last_of('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (extension != "obj" && extension != "ply") {
+        THROW(Error, "Unsupported mesh format: " + path);
+    }
+
+    MappedFile file(path);
+    if (extension == "obj") {
+        return LoadObj(file.Data(), file.Size(), threadNum, path);
+    }
+    return LoadPly(file.Data(), file.Size(), threadNum, path);
+}
@@ -0,0 +1,15 @@
+#ifndef MESH_LOADER_HPP
+#define MESH_LOADER_HPP
+
+#include <string>
+#include "mesh.hpp"
+
+// Load an OBJ or PLY (ASCII or binary) file, chosen by extension, into
+// indexed vertex data with one vertex per distinct position/normal pair.
+// The file is memory-mapped and parsed in chunks on threadNum threads (0: one
+// per core). Polygons are triangulated as fans and texture coordinates are
+// ignored; meshes without normals get area-weighted vertex normals.
+// Throws Error for unreadable or malformed files.
+MeshData LoadMesh(const std::string &path, unsigned threadNum = 0);
+
+#endif
@@ -0,0 +1,188 @@
+#include <cstring>
+#include <unordered_map>
+#include "hash.hpp"
+#include "mesh_optimizer.hpp"
+
+struct MeshVertexHasher
+{
+    size_t operator()(const MeshVertex &vertex) const
+    {
+        return static_cast<size_t>(HashBytes(&vertex, sizeof(vertex)));
+    }
+};
+
+struct MeshVertexEqual
+{
+    bool operator()(const MeshVertex &a, const MeshVertex &b) const
+    {
+        return std::memcmp(&a, &b, sizeof(MeshVertex)) == 0;
+    }
+};
+
+MeshData DeduplicateVertices(const std::vector<MeshVertex> &vertices)
+{
+    MeshData mesh;
+    mesh.indices.reserve(vertices.size());
+
+    std::unordered_map<MeshVertex, uint32_t, MeshVertexHasher, MeshVertexEqual> indexByVertex;
+    indexByVertex.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); i++) {
+        uint32_t newIndex = static_cast<uint32_t>(mesh.vertices.size());
+        std::pair<std::unordered_map<MeshVertex, uint32_t, MeshVertexHasher, MeshVertexEqual>::iterator, bool> inserted =
+            indexByVertex.insert(std::make_pair(vertices[i], newIndex));
+        if (inserted.second) {
+            mesh.vertices.push_back(vertices[i]);
+        }
+        mesh.indices.push_back(inserted.first->second);
+    }
+    return mesh;
+}
+
+// Tipsify: after emitting the triangles around the fanning vertex, continue
+// with a vertex that is still in the cache (and will stay there while its
+// remaining triangles are emitted), else with a recently used vertex that
+// has triangles left, else with the next such vertex in input order.
+void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexNum, unsigned cacheSize)
+{
+    size_t triangleNum = indices.size() / 3;
+    if (triangleNum == 0) {
+        return;
+    }
+
+    // Triangles adjacent to each vertex, as offsets into one array
+    std::vector<uint32_t> liveTriangles(vertexNum, 0);
+    for (size_t i = 0; i < triangleNum * 3; i++) {
+        liveTriangles[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexNum + 1, 0);
+    for (size_t v = 0; v < vertexNum; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(triangleNum * 3);
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t t = 0; t < triangleNum; t++) {
+        for (size_t j = 0; j < 3; j++) {
+            adjacency[fill[indices[t * 3 + j]]++] = static_cast<uint32_t>(t);
+        }
+    }
+
+    std::vector<uint32_t> cacheTime(vertexNum, 0);
+    std::vector<bool> emitted(triangleNum, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(triangleNum * 3);
+
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t fanning = 0;
+    while (fanning >= 0) {
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (size_t j = 0; j < 3; j++) {
+                uint32_t v = indices[t * 3 + j];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time;
+                    time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // Prefer the candidate that entered the cache earliest but will not
+        // be evicted before its remaining triangles are emitted. Candidates
+        // about to leave the cache have priority 0 and are never picked, as
+        // in the paper; the dead-end stack takes over then.
+        fanning = -1;
+        int64_t bestPriority = 0;
+        for (size_t i = 0; i < candidates.size(); i++) {
+            uint32_t v = candidates[i];
+            if (liveTriangles[v] == 0) {
+                continue;
+            }
+            int64_t priority = 0;
+            if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                priority = time - cacheTime[v];
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                fanning = v;
+            }
+        }
+
+        if (fanning < 0) {
+            while (!deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveTriangles[v] > 0) {
+                    fanning = v;
+                    break;
+                }
+            }
+        }
+        if (fanning < 0) {
+            while (cursor < vertexNum && liveTriangles[cursor] == 0) {
+                cursor++;
+            }
+            if (cursor < vertexNum) {
+                fanning = static_cast<int64_t>(cursor);
+            }
+        }
+    }
+
+    // A trailing partial triangle is kept as it was
+    result.insert(result.end(), indices.begin() + triangleNum * 3, indices.end());
+    indices.swap(result);
+}
+
+void OptimizeVertexFetch(MeshData &mesh)
+{
+    static const uint32_t UNUSED = 0xFFFFFFFF;
+
+    std::vector<uint32_t> remap(mesh.vertices.size(), UNUSED);
+    std::vector<MeshVertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        uint32_t &newIndex = remap[mesh.indices[i]];
+        if (newIndex == UNUSED) {
+            newIndex = static_cast<uint32_t>(vertices.size());
+            vertices.push_back(mesh.vertices[mesh.indices[i]]);
+        }
+        mesh.indices[i] = newIndex;
+    }
+    mesh.vertices.swap(vertices);
+}
+
+void OptimizeMesh(MeshData &mesh)
+{
+    OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+    OptimizeVertexFetch(mesh);
+}
+
+double ComputeACMR(const std::vector<uint32_t> &indices, size_t vertexNum, unsigned cacheSize)
+{
+    size_t triangleNum = indices.size() / 3;
+    if (triangleNum == 0) {
+        return 0.0;
+    }
+
+    // A vertex is in the FIFO if it entered it within the last cacheSize misses
+    std::vector<uint64_t> entryTime(vertexNum, 0);
+    uint64_t misses = 0;
+    for (size_t i = 0; i < triangleNum * 3; i++) {
+        uint32_t v = indices[i];
+        if (entryTime[v] == 0 || misses - entryTime[v] >= cacheSize) {
+            misses++;
+            entryTime[v] = misses;
+        }
+    }
+    return static_cast<double>(misses) / triangleNum;
+}
@@ -0,0 +1,33 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "mesh.hpp"
+
+// Post-transform vertex cache size assumed when optimizing and measuring.
+// Real caches vary between GPUs; results are not sensitive to the exact size.
+static const unsigned VERTEX_CACHE_SIZE = 16;
+
+// Index an unindexed triangle list, merging bitwise identical vertices
+MeshData DeduplicateVertices(const std::vector<MeshVertex> &vertices);
+
+// Reorder triangles for post-transform cache hits (Tipsify, Sander et al.
+// 2007: fan around recently used vertices, with dead-end recovery). Runs in
+// linear time.
+void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexNum, unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorder vertices by first use in the index buffer so that vertex fetches
+// walk memory forward. Unreferenced vertices are dropped.
+void OptimizeVertexFetch(MeshData &mesh);
+
+// Vertex cache, then vertex fetch optimization
+void OptimizeMesh(MeshData &mesh);
+
+// Average cache miss ratio: vertex shader invocations per triangle with a
+// FIFO post-transform cache. 3.0 is no reuse at all, 0.5 the ideal for large
+// regular meshes.
+double ComputeACMR(const std::vector<uint32_t> &indices, size_t vertexNum, unsigned cacheSize = VERTEX_CACHE_SIZE);
+
+#endif
@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "job_system.hpp"
+#include "parallel.hpp"
+
+// Job systems by thread count, created on first use and kept until exit
+static std::mutex g_jobSystemMutex;
+static std::map<unsigned, std::unique_ptr<JobSystem>> g_jobSystems;
+
+unsigned HardwareThreadNum()
+{
+    unsigned threadNum = std::thread::hardware_concurrency();
+    return threadNum > 0 ? threadNum : 1;
+}
+
+static JobSystem & SharedJobSystem(unsigned threadNum)
+{
+    std::lock_guard<std::mutex> lock(g_jobSystemMutex);
+    std::unique_ptr<JobSystem> &jobs = g_jobSystems[threadNum];
+    if (!jobs) {
+        jobs.reset(new JobSystem(threadNum));
+    }
+    return *jobs;
+}
+
+void ParallelFor(size_t taskNum, unsigned threadNum, const std::function<void(size_t)> &task)
+{
+    if (threadNum == 0) {
+        threadNum = HardwareThreadNum();
+    }
+    threadNum = static_cast<unsigned>(std::min<size_t>(threadNum, taskNum));
+    if (threadNum <= 1) {
+        for (size_t i = 0; i < taskNum; i++) {
+            task(i);
+        }
+        return;
+    }
+
+    // Jobs still queued after a failure skip their tasks
+    std::atomic<bool> failed(false);
+    SharedJobSystem(threadNum).ParallelFor(0, taskNum, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end && !failed.load(std::memory_order_relaxed); i++) {
+            try {
+                task(i);
+            } catch (...) {
+                failed.store(true, std::memory_order_relaxed);
+                throw;
+            }
+        }
+    });
+}
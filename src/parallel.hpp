@@ -0,0 +1,17 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <cstddef>
+#include <functional>
+
+// Number of hardware threads, at least 1
+unsigned HardwareThreadNum();
+
+// Run task(0) ... task(taskNum - 1) on up to threadNum threads (0: one per
+// core), as one job per task on a JobSystem with that many threads, shared
+// by all callers. Jobs are stolen one at a time, so uneven tasks balance
+// out. The first exception thrown by a task is rethrown once all jobs are
+// done.
+void ParallelFor(size_t taskNum, unsigned threadNum, const std::function<void(size_t)> &task);
+
+#endif
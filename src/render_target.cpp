@@ -0,0 +1,45 @@
+#include "errors.hpp"
+#include "render_target.hpp"
+
+RenderTarget::RenderTarget(GLsizei width, GLsizei height) :
+    m_width(width),
+    m_height(height),
+    m_framebuffer(0),
+    m_colorBuffer(0),
+    m_depthBuffer(0)
+{
+    glGenRenderbuffers(1, &m_colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    glGenRenderbuffers(1, &m_depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_depthBuffer);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        glDeleteFramebuffers(1, &m_framebuffer);
+        glDeleteRenderbuffers(1, &m_depthBuffer);
+        glDeleteRenderbuffers(1, &m_colorBuffer);
+        THROW(GLError, "Render target framebuffer is incomplete");
+    }
+}
+
+RenderTarget::~RenderTarget()
+{
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteRenderbuffers(1, &m_depthBuffer);
+    glDeleteRenderbuffers(1, &m_colorBuffer);
+}
+
+void RenderTarget::Bind()
+{
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, m_width, m_height);
+}
@@ -0,0 +1,32 @@
+#ifndef RENDER_TARGET_HPP
+#define RENDER_TARGET_HPP
+
+#include <GL/glew.h>
+
+// Framebuffer object with RGBA8 color and 24-bit depth renderbuffers, for
+// rendering without a window
+class RenderTarget
+{
+public:
+    RenderTarget(GLsizei width, GLsizei height);
+    ~RenderTarget();
+
+    RenderTarget(const RenderTarget &) = delete;
+    RenderTarget & operator=(const RenderTarget &) = delete;
+
+    // Bind as the draw framebuffer and set the viewport to cover it
+    void Bind();
+
+    GLuint Handle() const { return m_framebuffer; }
+    GLsizei Width() const { return m_width; }
+    GLsizei Height() const { return m_height; }
+
+private:
+    GLsizei m_width;
+    GLsizei m_height;
+    GLuint m_framebuffer;
+    GLuint m_colorBuffer;
+    GLuint m_depthBuffer;
+};
+
+#endif
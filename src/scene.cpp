@@ -0,0 +1,420 @@
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "clustered_lighting.hpp"
+#include "cpu_culler.hpp"
+#include "error.hpp"
+#include "gpu_culler.hpp"
+#include "mesh_batch.hpp"
+#include "mesh_optimizer.hpp"
+#include "scene.hpp"
+
+
+// Triangle soup: coordinates, normals. Indexed and optimized on load.
+static const GLfloat CUBE_VERTEX_DATA[] = {
+    // <position>           <normal>
+
+    // -X side
+    -1.0f, -1.0f, -1.0f,    -1.0f, 0.0f, 0.0f,
+    -1.0f,  1.0f,  1.0f,    -1.0f, 0.0f, 0.0f,
+    -1.0f, -1.0f,  1.0f,    -1.0f, 0.0f, 0.0f,
+
+    -1.0f,  1.0f,  1.0f,    -1.0f, 0.0f, 0.0f,
+    -1.0f,  1.0f, -1.0f,    -1.0f, 0.0f, 0.0f,
+    -1.0f, -1.0f, -1.0f,    -1.0f, 0.0f, 0.0f,
+
+    // +X side        
+     1.0f, -1.0f, -1.0f,     1.0f, 0.0f, 0.0f,
+     1.0f, -1.0f,  1.0f,     1.0f, 0.0f, 0.0f,
+     1.0f,  1.0f,  1.0f,     1.0f, 0.0f, 0.0f,
+
+     1.0f,  1.0f,  1.0f,     1.0f, 0.0f, 0.0f,
+     1.0f,  1.0f, -1.0f,     1.0f, 0.0f, 0.0f,
+     1.0f, -1.0f, -1.0f,     1.0f, 0.0f, 0.0f,
+
+    // -Y side
+    -1.0f, -1.0f, -1.0f,     0.0f, -1.0f, 0.0f,
+    -1.0f, -1.0f,  1.0f,     0.0f, -1.0f, 0.0f,
+     1.0f, -1.0f,  1.0f,     0.0f, -1.0f, 0.0f,
+
+     1.0f, -1.0f,  1.0f,     0.0f, -1.0f, 0.0f,
+     1.0f, -1.0f, -1.0f,     0.0f, -1.0f, 0.0f,
+    -1.0f, -1.0f, -1.0f,     0.0f, -1.0f, 0.0f,
+
+    // +Y side
+    -1.0f,  1.0f, -1.0f,     0.0f,  1.0f, 0.0f,
+    -1.0f,  1.0f,  1.0f,     0.0f,  1.0f, 0.0f,
+     1.0f,  1.0f,  1.0f,     0.0f,  1.0f, 0.0f,
+
+     1.0f,  1.0f,  1.0f,     0.0f,  1.0f, 0.0f,
+     1.0f,  1.0f, -1.0f,     0.0f,  1.0f, 0.0f,
+    -1.0f,  1.0f, -1.0f,     0.0f,  1.0f, 0.0f,
+
+    // -Z side
+    -1.0f, -1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+    -1.0f,  1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+     1.0f,  1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+
+     1.0f,  1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+     1.0f, -1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+    -1.0f, -1.0f, -1.0f,     0.0f,  0.0f, -1.0f,
+
+    // +Z side
+    -1.0f, -1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+    -1.0f,  1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+     1.0f,  1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+
+     1.0f,  1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+     1.0f, -1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+    -1.0f, -1.0f,  1.0f,     0.0f,  0.0f,  1.0f,
+};
+
+static_assert(sizeof(MeshVertex) == sizeof(GLfloat) * 6, "MeshVertex must match the cube vertex data layout");
+
+static MeshData CreateCubeMesh()
+{
+    const MeshVertex *vertices = reinterpret_cast<const MeshVertex *>(CUBE_VERTEX_DATA);
+    size_t vertexNum = sizeof(CUBE_VERTEX_DATA) / (sizeof(MeshVertex));
+
+    MeshData mesh = DeduplicateVertices(std::vector<MeshVertex>(vertices, vertices + vertexNum));
+    OptimizeMesh(mesh);
+    return mesh;
+}
+
+std::vector<SceneInstance> CreateInstanceGrid(size_t instanceNum, uint32_t materialNum)
+{
+    if (materialNum == 0) {
+        THROW(Error, "Instance grid needs at least one material");
+    }
+    size_t side = 1;
+    while (side * side * side < instanceNum) {
+        side++;
+    }
+    float cellSize = 2.0f / side;
+    glm::vec3 rotationAxis = glm::normalize(glm::vec3(1.0f, 1.0f, 0.0f));
+
+    std::vector<SceneInstance> instances(instanceNum);
+    for (size_t i = 0; i < instanceNum; i++) {
+        glm::vec3 cell(static_cast<float>(i % side), static_cast<float>(i / side % side), static_cast<float>(i / (side * side)));
+        glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), (cell + 0.5f) * cellSize - 1.0f);
+        modelMatrix = glm::rotate(modelMatrix, 0.7f * i, rotationAxis);
+        modelMatrix = glm::scale(modelMatrix, glm::vec3(0.35f * cellSize));
+
+        instances[i].modelMatrix = modelMatrix;
+        instances[i].materialIndex = static_cast<uint32_t>(i % materialNum);
+        instances[i].padding[0] = instances[i].padding[1] = instances[i].padding[2] = 0;
+    }
+    return instances;
+}
+
+std::vector<SceneMaterial> CreateMaterialPalette(size_t materialNum)
+{
+    std::vector<SceneMaterial> materials(materialNum);
+    for (size_t i = 0; i < materialNum; i++) {
+        // Hues spread around the color wheel
+        float hue = glm::two_pi<float>() * i / materialNum;
+        glm::vec3 color = 0.6f + 0.4f * glm::vec3(std::cos(hue), std::cos(hue - 2.1f), std::cos(hue + 2.1f));
+
+        materials[i].ka = color;
+        materials[i].kd = color;
+        materials[i].ks = glm::vec3(0.5f);
+        materials[i].shine = 8.0f;
+        materials[i].padding0 = materials[i].padding1 = 0.0f;
+    }
+    return materials;
+}
+
+Scene::Scene(GLSLProgram &program) :
+    Scene(program, std::unique_ptr<Mesh>(new Mesh(CreateCubeMesh())))
+{
+}
+
+Scene::Scene(GLSLProgram &program, std::unique_ptr<Mesh> mesh) :
+    m_program(program),
+    m_profiler(nullptr),
+    m_mesh(std::move(mesh)),
+    m_instances(),
+    m_batch(),
+    m_objects(),
+    m_cullProgram(nullptr),
+    m_culler(),
+    m_cpuCulling(false),
+    m_cpuCuller(),
+    m_cpuCulledObjectNum(0),
+    m_lighting(nullptr),
+    m_instanceBuffer(0),
+    m_materialBuffer(0),
+    m_instancedProgram(false),
+    m_gpuCulledProgram(false),
+    m_blockBindings(),
+    m_lightBlockBuffer(0),
+    m_lightBlockSize(0),
+    m_materialBlockBuffer(0),
+    m_materialBlockSize(0),
+    m_modelViewUniform(),
+    m_projectionUniform(),
+    m_normalUniform(),
+    m_positionScaleUniform(),
+    m_positionOffsetUniform(),
+    m_positionTransform(),
+    m_lightPosition(10.0f, 5.0f, 2.0f),
+    m_lightLa(0.1f, 0.2f, 0.1f),
+    m_lightLd(1.0f, 1.0f, 1.0f),
+    m_lightLs(0.5f, 0.5f, 0.5f),
+    m_materialKa(1.0f, 0.7f, 0.7f),
+    m_materialKd(1.0f, 0.7f, 0.7f),
+    m_materialKs(1.0f, 0.7f, 0.7f),
+    m_materialShine(8.0f),
+    m_drawCount(0)
+{
+    m_positionTransform.scale = glm::vec3(1.0f);
+    m_positionTransform.offset = glm::vec3(0.0f);
+    OnProgramReloaded();
+}
+
+Scene::~Scene()
+{
+    glDeleteBuffers(1, &m_materialBlockBuffer);
+    glDeleteBuffers(1, &m_lightBlockBuffer);
+    glDeleteBuffers(1, &m_materialBuffer);
+    glDeleteBuffers(1, &m_instanceBuffer);
+}
+
+void Scene::SetInstances(const std::vector<SceneInstance> &instances, const std::vector<SceneMaterial> &materials)
+{
+    m_instances = instances;
+
+    if (!m_instanceBuffer) {
+        glGenBuffers(1, &m_instanceBuffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_instanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, instances.size() * sizeof(SceneInstance), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    _UploadMaterials(materials);
+}
+
+void Scene::SetObjects(std::unique_ptr<MeshBatch> batch, const std::vector<SceneObject> &objects, const std::vector<SceneMaterial> &materials)
+{
+    m_culler.reset();
+    m_batch = std::move(batch);
+    m_objects = objects;
+    _UploadMaterials(materials);
+    SetGpuCulling(m_cullProgram);
+    SetCpuCulling(m_cpuCulling);
+}
+
+void Scene::SetGpuCulling(GLSLProgram *cullProgram)
+{
+    m_cullProgram = cullProgram;
+    m_culler.reset();
+    if (m_cullProgram && m_batch) {
+        m_culler.reset(new GpuCuller(*m_cullProgram, *m_batch, m_objects));
+    }
+}
+
+void Scene::SetCpuCulling(bool enable)
+{
+    m_cpuCulling = enable;
+    m_cpuCuller.reset();
+    m_cpuCulledObjectNum = 0;
+    if (!m_cpuCulling || !m_batch) {
+        return;
+    }
+
+    std::vector<MeshBounds> boxes(m_objects.size());
+    for (size_t i = 0; i < m_objects.size(); i++) {
+        const glm::mat4 &modelMatrix = m_objects[i].instance.modelMatrix;
+        const MeshSphere &sphere = m_batch->BoundingSphere(m_objects[i].meshIndex);
+        glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(sphere.center, 1.0f));
+        glm::vec3 radius(sphere.radius * glm::length(glm::vec3(modelMatrix[0])));
+        boxes[i].min = center - radius;
+        boxes[i].max = center + radius;
+    }
+    m_cpuCuller.reset(new CpuCuller());
+    m_cpuCuller->SetBoxes(boxes);
+}
+
+void Scene::_UploadMaterials(const std::vector<SceneMaterial> &materials)
+{
+    if (!m_materialBuffer) {
+        glGenBuffers(1, &m_materialBuffer);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_materialBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(SceneMaterial), materials.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Scene::OnProgramReloaded()
+{
+    // Light and material go to uniform blocks. They only change with the
+    // block layout, so they are uploaded here rather than each frame.
+    m_program.BindUniformBlocks(m_blockBindings);
+    _ResolveUniforms();
+    _UploadUniformBlocks();
+}
+
+// Std140 copy of a block in its own buffer; size 0 (inactive block) leaves
+// the buffer alone
+static void UploadUniformBlock(GLuint &buffer, GLint size, const std::vector<unsigned char> &data)
+{
+    if (size <= 0) {
+        return;
+    }
+    if (!buffer) {
+        glGenBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void Scene::_UploadUniformBlocks()
+{
+    // Instanced programs read materials from a storage buffer instead, and
+    // an inactive block reports size 0
+    m_lightBlockSize = m_program.GetUniformBlockSize("LightBlock");
+    m_materialBlockSize = m_program.GetUniformBlockSize("MaterialBlock");
+
+    std::vector<unsigned char> lightData(std::max(m_lightBlockSize, 0));
+    Std140Writer lightWriter(lightData.data(), lightData.size());
+    if (!lightData.empty()) {
+        lightWriter.BeginStruct();
+        lightWriter.Write(m_lightPosition);
+        lightWriter.Write(m_lightLa);
+        lightWriter.Write(m_lightLd);
+        lightWriter.Write(m_lightLs);
+        lightWriter.EndStruct();
+    }
+    UploadUniformBlock(m_lightBlockBuffer, m_lightBlockSize, lightData);
+
+    std::vector<unsigned char> materialData(std::max(m_materialBlockSize, 0));
+    Std140Writer materialWriter(materialData.data(), materialData.size());
+    if (!materialData.empty()) {
+        materialWriter.BeginStruct();
+        materialWriter.Write(m_materialKa);
+        materialWriter.Write(m_materialKd);
+        materialWriter.Write(m_materialKs);
+        materialWriter.Write(m_materialShine);
+        materialWriter.EndStruct();
+    }
+    UploadUniformBlock(m_materialBlockBuffer, m_materialBlockSize, materialData);
+}
+
+void Scene::_ResolveUniforms()
+{
+    // Per-frame uniforms are resolved once, and again after a reload
+    m_modelViewUniform = m_program.GetUniform<glm::mat4>("ModelViewMatrix");
+    m_projectionUniform = m_program.GetUniform<glm::mat4>("ProjectionMatrix");
+    m_normalUniform = m_program.GetUniform<glm::mat3>("NormalMatrix");
+    m_positionScaleUniform = m_program.GetUniform<glm::vec3>("PositionScale");
+    m_positionOffsetUniform = m_program.GetUniform<glm::vec3>("PositionOffset");
+    m_instancedProgram = glGetProgramResourceIndex(m_program.Handle(), GL_SHADER_STORAGE_BLOCK, "InstanceBuffer") != GL_INVALID_INDEX;
+    // MULTI_DRAW and INSTANCED read the instance buffer as well, but index
+    // it differently from the culler's draws
+    m_gpuCulledProgram = m_instancedProgram && m_program.Defines().IsSet("GPU_CULLED");
+}
+
+void Scene::Render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix)
+{
+    {
+        ProfilerScope clearScope(m_profiler, "clear");
+        glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Culling dispatches its own program, so it goes before the draw
+    // program is set up
+    const std::vector<uint32_t> *visibleObjects = nullptr;
+    if (m_culler && m_gpuCulledProgram) {
+        ProfilerScope cullScope(m_profiler, "cull");
+        m_culler->Cull(projectionMatrix * viewMatrix);
+    } else if (m_cpuCuller) {
+        ProfilerScope cullScope(m_profiler, "cull");
+        visibleObjects = &m_cpuCuller->Cull(projectionMatrix * viewMatrix);
+        m_cpuCulledObjectNum = m_objects.size() - visibleObjects->size();
+    }
+    size_t objectNum = visibleObjects ? visibleObjects->size() : m_objects.size();
+
+    // Light binning dispatches a program as well
+    if (m_lighting) {
+        ProfilerScope lightScope(m_profiler, "lights");
+        m_lighting->Update(viewMatrix, projectionMatrix);
+    }
+
+    {
+        ProfilerScope uniformScope(m_profiler, "uniforms");
+        glm::mat4 modelViewMatrix = viewMatrix;
+        glm::mat3 normalMatrix = glm::inverse(glm::transpose(glm::mat3(modelViewMatrix)));
+
+        m_program.Use();
+        m_program.SetUniform(m_modelViewUniform, modelViewMatrix);
+        m_program.SetUniform(m_projectionUniform, projectionMatrix);
+        m_program.SetUniform(m_normalUniform, normalMatrix);
+        m_program.SetUniform(m_positionScaleUniform, m_positionTransform.scale);
+        m_program.SetUniform(m_positionOffsetUniform, m_positionTransform.offset);
+
+        // Binding points are shared with other programs, so bind every frame
+        if (m_lightBlockSize > 0) {
+            glBindBufferBase(GL_UNIFORM_BUFFER, m_blockBindings.GetBinding(GLSL_UNIFORM_NAME("LightBlock")), m_lightBlockBuffer);
+        }
+        if (m_materialBlockSize > 0) {
+            glBindBufferBase(GL_UNIFORM_BUFFER, m_blockBindings.GetBinding(GLSL_UNIFORM_NAME("MaterialBlock")), m_materialBlockBuffer);
+        }
+
+        m_program.FlushUniforms();
+    }
+
+    {
+        ProfilerScope drawScope(m_profiler, "draw");
+        if (m_lighting) {
+            m_lighting->Bind();
+        }
+        if (m_culler && m_gpuCulledProgram) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, m_materialBuffer);
+            m_culler->Draw();
+            m_drawCount++;
+        } else if (m_batch && m_instancedProgram) {
+            // Per-object data goes out with the draw commands
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, m_materialBuffer);
+            for (size_t i = 0; i < objectNum; i++) {
+                const SceneObject &object = m_objects[visibleObjects ? (*visibleObjects)[i] : i];
+                m_batch->Add(object.meshIndex, object.instance);
+            }
+            m_batch->Submit();
+            m_drawCount++;
+        } else if (m_batch) {
+            for (size_t i = 0; i < objectNum; i++) {
+                const SceneObject &object = m_objects[visibleObjects ? (*visibleObjects)[i] : i];
+                glm::mat4 modelViewMatrix = viewMatrix * object.instance.modelMatrix;
+                m_program.SetUniform(m_modelViewUniform, modelViewMatrix);
+                m_program.SetUniform(m_normalUniform, glm::inverse(glm::transpose(glm::mat3(modelViewMatrix))));
+                m_program.FlushUniforms();
+                m_batch->Draw(object.meshIndex);
+                m_drawCount++;
+            }
+        } else if (m_instances.empty()) {
+            m_mesh->Draw();
+            m_drawCount++;
+        } else if (m_instancedProgram) {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INSTANCE_BUFFER_BINDING, m_instanceBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MATERIAL_BUFFER_BINDING, m_materialBuffer);
+            m_mesh->DrawInstanced(static_cast<GLsizei>(m_instances.size()));
+            m_drawCount++;
+        } else {
+            for (size_t i = 0; i < m_instances.size(); i++) {
+                glm::mat4 modelViewMatrix = viewMatrix * m_instances[i].modelMatrix;
+                m_program.SetUniform(m_modelViewUniform, modelViewMatrix);
+                m_program.SetUniform(m_normalUniform, glm::inverse(glm::transpose(glm::mat3(modelViewMatrix))));
+                m_program.FlushUniforms();
+                m_mesh->Draw();
+                m_drawCount++;
+            }
+        }
+    }
+
+    if (m_lighting) {
+        m_lighting->EndFrame();
+    }
+}
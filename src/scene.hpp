@@ -0,0 +1,160 @@
+#ifndef SCENE_HPP
+#define SCENE_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "frame_profiler.hpp"
+#include "glsl_program.hpp"
+#include "mesh.hpp"
+#include "uniform_block.hpp"
+#include "vertex_format.hpp"
+
+class ClusteredLighting;
+class CpuCuller;
+class GpuCuller;
+class MeshBatch;
+
+// Storage buffer bindings of the INSTANCED variant of ads.vert
+static const GLuint INSTANCE_BUFFER_BINDING = 0;
+static const GLuint MATERIAL_BUFFER_BINDING = 1;
+
+// InstanceInfo of the INSTANCED ads.vert, in std430 layout
+struct SceneInstance
+{
+    // Rotation and uniform scale only, so that it also transforms normals
+    glm::mat4 modelMatrix;
+    uint32_t materialIndex;
+    uint32_t padding[3];
+};
+
+// Instance of one of the meshes of a MeshBatch
+struct SceneObject
+{
+    size_t meshIndex;
+    SceneInstance instance;
+};
+
+// MaterialInfo of ads.vert, in std430 layout
+struct SceneMaterial
+{
+    glm::vec3 ka;
+    float padding0;
+    glm::vec3 kd;
+    float padding1;
+    glm::vec3 ks;
+    float shine;
+};
+
+// Grid of instanceNum differently rotated copies of a unit-cube-sized mesh,
+// together filling [-1, 1] on every axis and cycling through materialNum
+// materials
+std::vector<SceneInstance> CreateInstanceGrid(size_t instanceNum, uint32_t materialNum);
+std::vector<SceneMaterial> CreateMaterialPalette(size_t materialNum);
+
+// Lit mesh, a cube unless given another, drawn with the ADS program.
+// Rendered by both the interactive loop and the headless benchmark.
+class Scene
+{
+public:
+    explicit Scene(GLSLProgram &program);
+    Scene(GLSLProgram &program, std::unique_ptr<Mesh> mesh);
+    ~Scene();
+
+    Scene(const Scene &) = delete;
+    Scene & operator=(const Scene &) = delete;
+
+    // Bind uniform blocks and resolve uniforms again after the program was
+    // swapped by the shader reloader
+    void OnProgramReloaded();
+
+    // Draw the mesh once per instance instead of once. A program with the
+    // InstanceBuffer storage block (INSTANCED ads.vert) draws them all with
+    // one instanced draw call; other programs draw them one by one, setting
+    // the matrices per instance and keeping the uniform block material.
+    void SetInstances(const std::vector<SceneInstance> &instances, const std::vector<SceneMaterial> &materials);
+    size_t InstanceNum() const { return m_instances.size(); }
+
+    // Draw objects of different meshes from a batch instead of the mesh. A
+    // program with the InstanceBuffer storage block (MULTI_DRAW ads.vert)
+    // draws them all with one multi-draw indirect call; other programs draw
+    // them one by one, like SetInstances.
+    void SetObjects(std::unique_ptr<MeshBatch> batch, const std::vector<SceneObject> &objects, const std::vector<SceneMaterial> &materials);
+    size_t ObjectNum() const { return m_objects.size(); }
+
+    // Cull the batch objects on the GPU with the given cull.comp program
+    // before drawing them; null turns culling off. Takes effect with a
+    // program defining GPU_CULLED (ads.vert reading the culled objects);
+    // other programs draw the batch as without it. Kept across SetObjects().
+    void SetGpuCulling(GLSLProgram *cullProgram);
+    const GpuCuller * Culler() const { return m_culler.get(); }
+    // Cull the batch objects on the CPU before drawing them, by the world
+    // bounds of their mesh's bounding sphere. GPU culling takes precedence.
+    // Kept across SetObjects().
+    void SetCpuCulling(bool enable);
+    size_t CulledObjectNum() const { return m_cpuCulledObjectNum; }
+
+    // Shade with many point lights, updated before each frame, for a
+    // program reading them (clustered.frag). Null turns them off; the
+    // lighting must outlive the scene or be turned off first.
+    void SetLighting(ClusteredLighting *lighting) { m_lighting = lighting; }
+
+    // Dequantization of the mesh positions, for a mesh packed in a vertex
+    // format that stores them relative to its bounds
+    void SetPositionTransform(const PositionTransform &transform) { m_positionTransform = transform; }
+
+    // Time the passes of Render(). Null disables profiling.
+    void SetProfiler(FrameProfiler *profiler) { m_profiler = profiler; }
+
+    // Clear the current framebuffer and draw the scene
+    void Render(const glm::mat4 &viewMatrix, const glm::mat4 &projectionMatrix);
+
+    GLSLProgram & Program() { return m_program; }
+    unsigned long long DrawCount() const { return m_drawCount; }
+
+private:
+    void _ResolveUniforms();
+    void _UploadMaterials(const std::vector<SceneMaterial> &materials);
+    void _UploadUniformBlocks();
+
+    GLSLProgram &m_program;
+    FrameProfiler *m_profiler;
+    std::unique_ptr<Mesh> m_mesh;
+    std::vector<SceneInstance> m_instances;
+    std::unique_ptr<MeshBatch> m_batch;
+    std::vector<SceneObject> m_objects;
+    GLSLProgram *m_cullProgram;
+    std::unique_ptr<GpuCuller> m_culler;
+    bool m_cpuCulling;
+    std::unique_ptr<CpuCuller> m_cpuCuller;
+    size_t m_cpuCulledObjectNum;
+    ClusteredLighting *m_lighting;
+    GLuint m_instanceBuffer;
+    GLuint m_materialBuffer;
+    bool m_instancedProgram;
+    bool m_gpuCulledProgram;
+    UniformBlockBindings m_blockBindings;
+    GLuint m_lightBlockBuffer;
+    GLint m_lightBlockSize;
+    GLuint m_materialBlockBuffer;
+    GLint m_materialBlockSize;
+    GLSLUniform<glm::mat4> m_modelViewUniform;
+    GLSLUniform<glm::mat4> m_projectionUniform;
+    GLSLUniform<glm::mat3> m_normalUniform;
+    GLSLUniform<glm::vec3> m_positionScaleUniform;
+    GLSLUniform<glm::vec3> m_positionOffsetUniform;
+    PositionTransform m_positionTransform;
+    glm::vec3 m_lightPosition;
+    glm::vec3 m_lightLa;
+    glm::vec3 m_lightLd;
+    glm::vec3 m_lightLs;
+    glm::vec3 m_materialKa;
+    glm::vec3 m_materialKd;
+    glm::vec3 m_materialKs;
+    GLfloat m_materialShine;
+    unsigned long long m_drawCount;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <iostream>
+#include "shader_reloader.hpp"
+
+ShaderReloader::ShaderReloader(GLSLCompiler &compiler) :
+    m_compiler(compiler),
+    m_watcher(),
+    m_programs()
+{
+}
+
+ShaderReloader::~ShaderReloader()
+{
+    // Replacements may still be referenced by compiler worker threads
+    for (size_t i = 0; i < m_programs.size(); i++) {
+        if (m_programs[i]->replacement) {
+            try {
+                m_compiler.Wait(*m_programs[i]->replacement);
+            } catch (GLSLException) {
+            }
+        }
+    }
+}
+
+void ShaderReloader::Watch(GLSLProgram &program, ReloadCallback onReload)
+{
+    std::unique_ptr<WatchedProgram> watched(new WatchedProgram);
+    watched->program = &program;
+    watched->files = program.GetSourceFiles();
+    watched->onReload = onReload;
+    watched->stale = false;
+
+    for (size_t i = 0; i < watched->files.size(); i++) {
+        m_watcher.Watch(watched->files[i]);
+    }
+    m_programs.push_back(std::move(watched));
+}
+
+void ShaderReloader::Update()
+{
+    std::vector<std::string> changed;
+    m_watcher.Poll(changed);
+
+    for (size_t i = 0; i < m_programs.size(); i++) {
+        WatchedProgram &watched = *m_programs[i];
+
+        for (size_t j = 0; j < changed.size(); j++) {
+            if (std::find(watched.files.begin(), watched.files.end(), changed[j]) != watched.files.end()) {
+                watched.stale = true;
+            }
+        }
+
+        if (watched.replacement && m_compiler.IsComplete(*watched.replacement)) {
+            _Complete(watched);
+        }
+
+        // An edit made while a recompile is in flight is picked up once
+        // that recompile is done
+        if (watched.stale && !watched.replacement) {
+            _Submit(watched);
+        }
+    }
+}
+
+void ShaderReloader::_Submit(WatchedProgram &watched)
+{
+    watched.stale = false;
+    watched.submitTime = Clock::now();
+    try {
+        watched.replacement = watched.program->CreateReloaded();
+        m_compiler.Submit(*watched.replacement);
+    } catch (GLSLException ex) {
+        std::cerr << "Shader reload failed:" << std::endl << ex.Msg() << std::endl;
+        watched.replacement.reset();
+    }
+}
+
+void ShaderReloader::_Complete(WatchedProgram &watched)
+{
+    std::unique_ptr<GLSLProgram> replacement = std::move(watched.replacement);
+    try {
+        m_compiler.Wait(*replacement);
+    } catch (GLSLException ex) {
+        std::cerr << "Shader reload failed, keeping the previous program:" << std::endl << ex.Msg() << std::endl;
+        return;
+    }
+
+    // The old GL program ends up in the replacement and is deleted with it
+    watched.program->Swap(*replacement);
+    if (watched.onReload) {
+        watched.onReload(*watched.program);
+    }
+
+    double latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - watched.submitTime).count();
+    std::cout << "Reloaded program (";
+    for (size_t i = 0; i < watched.files.size(); i++) {
+        std::cout << (i > 0 ? ", " : "") << watched.files[i];
+    }
+    std::cout << ") in " << latencyMs << " ms" << std::endl;
+}
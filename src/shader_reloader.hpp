@@ -0,0 +1,54 @@
+#ifndef SHADER_RELOADER_HPP
+#define SHADER_RELOADER_HPP
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "file_watcher.hpp"
+#include "glsl_compiler.hpp"
+#include "glsl_program.hpp"
+
+// Recompiles programs whose shader files change on disk. Replacements are
+// compiled through a GLSLCompiler, off the render thread when possible, and
+// swapped into the original program object only once they link. Until then
+// (or if they fail to compile) the old program keeps rendering.
+class ShaderReloader
+{
+public:
+    // Called after a program is swapped, so that uniform values can be set
+    // again on the new GL program
+    typedef std::function<void(GLSLProgram &)> ReloadCallback;
+
+    explicit ShaderReloader(GLSLCompiler &compiler);
+    ~ShaderReloader();
+
+    void Watch(GLSLProgram &program, ReloadCallback onReload = ReloadCallback());
+
+    // Call at a frame boundary: picks up file changes and swaps in every
+    // replacement that has finished linking
+    void Update();
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct WatchedProgram
+    {
+        GLSLProgram *program;
+        std::vector<std::string> files;
+        ReloadCallback onReload;
+        std::unique_ptr<GLSLProgram> replacement;
+        Clock::time_point submitTime;
+        bool stale;
+    };
+
+    void _Submit(WatchedProgram &watched);
+    void _Complete(WatchedProgram &watched);
+
+    GLSLCompiler &m_compiler;
+    FileWatcher m_watcher;
+    std::vector<std::unique_ptr<WatchedProgram>> m_programs;
+};
+
+#endif
@@ -0,0 +1,184 @@
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/euler_angles.hpp>
+#include <algorithm>
+#include <cstring>
+#include "simulation.hpp"
+#include "trace.hpp"
+
+// Camera speed in units per second, and rotation in radians per pixel of
+// cursor movement
+static const float CAMERA_SPEED = 6.0f;
+static const float MOUSE_SENSITIVITY = 0.005f;
+// Ticks further behind than this are dropped
+static const int MAX_LAG_TICKS = 8;
+
+// View-space direction of each MoveKey
+static const glm::vec3 MOVE_DIRECTIONS[] = {
+    glm::vec3(0.0f, 0.0f, -1.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),
+    glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f),
+};
+
+CameraState CameraStateFromView(const glm::mat4 &viewMatrix)
+{
+    glm::mat3 rotation(viewMatrix);
+    CameraState camera;
+    camera.orientation = glm::quat_cast(rotation);
+    camera.position = -(glm::transpose(rotation) * glm::vec3(viewMatrix[3]));
+    return camera;
+}
+
+glm::mat4 CameraViewMatrix(const CameraState &camera)
+{
+    return glm::mat4_cast(camera.orientation) * glm::translate(glm::mat4(1.0f), -camera.position);
+}
+
+static uint64_t PackCursor(float x, float y)
+{
+    uint32_t bits[2];
+    std::memcpy(&bits[0], &x, sizeof(x));
+    std::memcpy(&bits[1], &y, sizeof(y));
+    return (static_cast<uint64_t>(bits[1]) << 32) | bits[0];
+}
+
+static glm::vec2 UnpackCursor(uint64_t packed)
+{
+    uint32_t bits[2] = { static_cast<uint32_t>(packed), static_cast<uint32_t>(packed >> 32) };
+    glm::vec2 cursor;
+    std::memcpy(&cursor.x, &bits[0], sizeof(cursor.x));
+    std::memcpy(&cursor.y, &bits[1], sizeof(cursor.y));
+    return cursor;
+}
+
+static SimulationSnapshot InitialSnapshot(const CameraState &camera)
+{
+    SimulationSnapshot snapshot;
+    snapshot.previous = camera;
+    snapshot.current = camera;
+    snapshot.tick = 0;
+    snapshot.tickTime = SimulationClock::now();
+    return snapshot;
+}
+
+Simulation::Simulation(const glm::mat4 &viewMatrix, double tickRate) :
+    m_tickDuration(std::chrono::duration_cast<SimulationClock::duration>(std::chrono::duration<double>(1.0 / tickRate))),
+    m_tickSeconds(static_cast<float>(1.0 / tickRate)),
+    m_camera(CameraStateFromView(viewMatrix)),
+    m_cursorRead(false),
+    m_lastCursor(0.0f),
+    m_keys(0),
+    m_cursor(0),
+    m_cursorSet(false),
+    m_snapshots(InitialSnapshot(m_camera)),
+    m_tickNum(0),
+    m_stopping(false),
+    m_thread()
+{
+}
+
+Simulation::~Simulation()
+{
+    Stop();
+}
+
+void Simulation::Start()
+{
+    if (!m_thread.joinable()) {
+        m_stopping.store(false);
+        m_thread = std::thread(&Simulation::_Run, this);
+    }
+}
+
+void Simulation::Stop()
+{
+    if (m_thread.joinable()) {
+        m_stopping.store(true);
+        m_thread.join();
+    }
+}
+
+void Simulation::SetKey(MoveKey key, bool pressed)
+{
+    uint32_t bit = 1u << static_cast<unsigned>(key);
+    if (pressed) {
+        m_keys.fetch_or(bit, std::memory_order_relaxed);
+    } else {
+        m_keys.fetch_and(~bit, std::memory_order_relaxed);
+    }
+}
+
+void Simulation::SetCursor(double x, double y)
+{
+    m_cursor.store(PackCursor(static_cast<float>(x), static_cast<float>(y)), std::memory_order_relaxed);
+    m_cursorSet.store(true, std::memory_order_release);
+}
+
+glm::mat4 Simulation::InterpolateView(SimulationClock::time_point time)
+{
+    const SimulationSnapshot &snapshot = m_snapshots.Acquire();
+    float alpha = std::chrono::duration<float>(time - snapshot.tickTime).count() / m_tickSeconds;
+    alpha = std::min(std::max(alpha, 0.0f), 1.0f);
+
+    CameraState camera;
+    camera.orientation = glm::slerp(snapshot.previous.orientation, snapshot.current.orientation, alpha);
+    camera.position = glm::mix(snapshot.previous.position, snapshot.current.position, alpha);
+    return CameraViewMatrix(camera);
+}
+
+void Simulation::_Run()
+{
+    TraceSetThreadName("simulation");
+    SimulationClock::time_point tickTime = SimulationClock::now();
+    while (!m_stopping.load(std::memory_order_relaxed)) {
+        CameraState previous = m_camera;
+        _Tick();
+
+        SimulationSnapshot &snapshot = m_snapshots.Back();
+        snapshot.previous = previous;
+        snapshot.current = m_camera;
+        snapshot.tick = m_tickNum.fetch_add(1, std::memory_order_relaxed) + 1;
+        snapshot.tickTime = tickTime;
+        m_snapshots.Publish();
+
+        tickTime += m_tickDuration;
+        SimulationClock::time_point now = SimulationClock::now();
+        if (now - tickTime > MAX_LAG_TICKS * m_tickDuration) {
+            tickTime = now;
+        }
+        std::this_thread::sleep_until(tickTime);
+    }
+}
+
+void Simulation::_Tick()
+{
+    TraceZone zone("tick", "simulation");
+
+    // Rotate about the camera by the cursor movement since the last tick
+    if (m_cursorSet.load(std::memory_order_acquire)) {
+        glm::vec2 cursor = UnpackCursor(m_cursor.load(std::memory_order_relaxed));
+        if (!m_cursorRead) {
+            m_lastCursor = cursor;
+            m_cursorRead = true;
+        }
+        glm::vec2 delta = (cursor - m_lastCursor) * MOUSE_SENSITIVITY;
+        m_lastCursor = cursor;
+        glm::quat rotation = glm::quat_cast(glm::eulerAngleXY(delta.y, delta.x));
+        m_camera.orientation = glm::normalize(rotation * m_camera.orientation);
+    }
+
+    // Move along the view-space directions of the held keys
+    uint32_t keys = m_keys.load(std::memory_order_relaxed);
+    glm::vec3 direction(0.0f);
+    for (unsigned i = 0; i < sizeof(MOVE_DIRECTIONS) / sizeof(MOVE_DIRECTIONS[0]); i++) {
+        if (keys & (1u << i)) {
+            direction += MOVE_DIRECTIONS[i];
+        }
+    }
+    if (glm::length(direction) > 0.0f) {
+        glm::vec3 step = glm::normalize(direction) * CAMERA_SPEED * m_tickSeconds;
+        m_camera.position += glm::conjugate(m_camera.orientation) * step;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef SIMULATION_HPP
+#define SIMULATION_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include "triple_buffer.hpp"
+
+typedef std::chrono::steady_clock SimulationClock;
+
+// Rigid camera: rotation from world to view space and position in world
+// space
+struct CameraState
+{
+    glm::quat orientation;
+    glm::vec3 position;
+};
+
+CameraState CameraStateFromView(const glm::mat4 &viewMatrix);
+glm::mat4 CameraViewMatrix(const CameraState &camera);
+
+// State after a tick, together with the state before it, so that the render
+// thread can interpolate between them
+struct SimulationSnapshot
+{
+    CameraState previous;
+    CameraState current;
+    uint64_t tick;
+    // Scheduled time of the tick that produced the current state
+    SimulationClock::time_point tickTime;
+};
+
+enum class MoveKey
+{
+    FORWARD,
+    BACK,
+    LEFT,
+    RIGHT,
+    UP,
+    DOWN,
+};
+
+// Camera simulation on its own thread at a fixed tick rate, so that its
+// speed does not depend on the frame rate and its cost is not part of the
+// frame. Input is recorded from any thread and consumed by the next tick;
+// ticks publish snapshots through a TripleBuffer, from which the render
+// thread interpolates the camera at the time of its frame. Ticks are
+// dropped when the thread falls far behind.
+class Simulation
+{
+public:
+    Simulation(const glm::mat4 &viewMatrix, double tickRate);
+    // Stops the thread
+    ~Simulation();
+
+    Simulation(const Simulation &) = delete;
+    Simulation & operator=(const Simulation &) = delete;
+
+    void Start();
+    void Stop();
+
+    // Input, usually from window callbacks
+    void SetKey(MoveKey key, bool pressed);
+    void SetCursor(double x, double y);
+
+    // Render thread: the view matrix at the given time, one tick behind the
+    // simulation
+    glm::mat4 InterpolateView(SimulationClock::time_point time);
+    uint64_t TickNum() const { return m_tickNum.load(std::memory_order_relaxed); }
+
+private:
+    void _Run();
+    void _Tick();
+
+    SimulationClock::duration m_tickDuration;
+    float m_tickSeconds;
+    // Simulation thread only
+    CameraState m_camera;
+    bool m_cursorRead;
+    glm::vec2 m_lastCursor;
+    // Written by input, read by ticks
+    std::atomic<uint32_t> m_keys;
+    std::atomic<uint64_t> m_cursor;
+    std::atomic<bool> m_cursorSet;
+    TripleBuffer<SimulationSnapshot> m_snapshots;
+    std::atomic<uint64_t> m_tickNum;
+    std::atomic<bool> m_stopping;
+    std::thread m_thread;
+};
+
+#endif
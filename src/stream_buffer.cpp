@@ -0,0 +1,108 @@
+#include <chrono>
+#include "errors.hpp"
+#include "stream_buffer.hpp"
+
+static const GLuint64 FENCE_WAIT_TIMEOUT_NS = 1000000000;
+
+StreamBuffer::StreamBuffer(GLenum target, GLsizeiptr regionSize, unsigned regionNum) :
+    m_target(target),
+    m_handle(0),
+    m_data(nullptr),
+    m_regionSize(regionSize),
+    m_defaultAlignment(1),
+    m_region(regionNum - 1),
+    m_regionOffset(0),
+    m_fences(regionNum, nullptr),
+    m_stats()
+{
+    GLint alignment = 1;
+    if (target == GL_UNIFORM_BUFFER) {
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    } else if (target == GL_SHADER_STORAGE_BUFFER) {
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    }
+    m_defaultAlignment = alignment;
+
+    // Keep every region start aligned
+    m_regionSize = (regionSize + m_defaultAlignment - 1) / m_defaultAlignment * m_defaultAlignment;
+    GLsizeiptr totalSize = m_regionSize * regionNum;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &m_handle);
+    glBindBuffer(m_target, m_handle);
+    glBufferStorage(m_target, totalSize, nullptr, flags);
+    m_data = static_cast<unsigned char *>(glMapBufferRange(m_target, 0, totalSize, flags));
+    if (!m_data) {
+        glDeleteBuffers(1, &m_handle);
+        THROW(GLError, "Failed to map stream buffer");
+    }
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    for (size_t i = 0; i < m_fences.size(); i++) {
+        if (m_fences[i]) {
+            glDeleteSync(m_fences[i]);
+        }
+    }
+    glBindBuffer(m_target, m_handle);
+    glUnmapBuffer(m_target);
+    glDeleteBuffers(1, &m_handle);
+}
+
+void StreamBuffer::BeginFrame()
+{
+    m_region = (m_region + 1) % m_fences.size();
+    m_regionOffset = 0;
+
+    m_stats.frames++;
+
+    GLsync &fence = m_fences[m_region];
+    if (!fence) {
+        return;
+    }
+
+    // Poll first, so that only real waits are counted
+    GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        std::chrono::high_resolution_clock::time_point waitStart = std::chrono::high_resolution_clock::now();
+        do {
+            result = glClientWaitSync(fence, 0, FENCE_WAIT_TIMEOUT_NS);
+        } while (result == GL_TIMEOUT_EXPIRED);
+        m_stats.waits++;
+        m_stats.waitMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - waitStart).count();
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+    if (result == GL_WAIT_FAILED) {
+        THROW(GLError, "Failed to wait for stream buffer fence");
+    }
+}
+
+StreamAllocation StreamBuffer::Allocate(GLsizeiptr size, GLsizeiptr alignment)
+{
+    if (alignment <= 0) {
+        alignment = m_defaultAlignment;
+    }
+    GLsizeiptr offset = (m_regionOffset + alignment - 1) / alignment * alignment;
+    if (offset + size > m_regionSize) {
+        THROW(GLError, "Stream buffer region is full");
+    }
+    m_regionOffset = offset + size;
+
+    StreamAllocation allocation;
+    allocation.offset = m_region * m_regionSize + offset;
+    allocation.data = m_data + allocation.offset;
+    allocation.size = size;
+    return allocation;
+}
+
+void StreamBuffer::EndFrame()
+{
+    m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void StreamBuffer::BindRange(GLuint index, const StreamAllocation &allocation) const
+{
+    glBindBufferRange(m_target, index, m_handle, allocation.offset, allocation.size);
+}
@@ -0,0 +1,68 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <vector>
+
+// Sub-allocation from a StreamBuffer, valid for the current frame only
+struct StreamAllocation
+{
+    void *data;
+    GLintptr offset;
+    GLsizeiptr size;
+};
+
+// How often BeginFrame() found its region still in use by the GPU, and how
+// long the CPU waited for it in total
+struct StreamBufferStats
+{
+    StreamBufferStats() : frames(0), waits(0), waitMs(0.0) {}
+
+    unsigned long long frames;
+    unsigned long long waits;
+    double waitMs;
+};
+
+// Persistently mapped buffer (glBufferStorage with GL_MAP_PERSISTENT_BIT and
+// GL_MAP_COHERENT_BIT) split into one region per frame in flight. Each frame
+// sub-allocates from its own region and writes straight into the mapping;
+// a fence placed at the end of the frame keeps the region from being reused
+// while the GPU may still read it.
+class StreamBuffer
+{
+public:
+    StreamBuffer(GLenum target, GLsizeiptr regionSize, unsigned regionNum = 3);
+    ~StreamBuffer();
+
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer & operator=(const StreamBuffer &) = delete;
+
+    // Move to the next region, waiting for the GPU if it still uses it
+    void BeginFrame();
+    StreamAllocation Allocate(GLsizeiptr size, GLsizeiptr alignment = 0);
+    void EndFrame();
+
+    // Bind an allocation to an indexed target (uniform/storage buffers)
+    void BindRange(GLuint index, const StreamAllocation &allocation) const;
+
+    GLuint Handle() const { return m_handle; }
+    GLenum Target() const { return m_target; }
+    GLsizeiptr RegionSize() const { return m_regionSize; }
+
+    const StreamBufferStats & Stats() const { return m_stats; }
+    void ResetStats() { m_stats = StreamBufferStats(); }
+
+private:
+    GLenum m_target;
+    GLuint m_handle;
+    unsigned char *m_data;
+    GLsizeiptr m_regionSize;
+    GLsizeiptr m_defaultAlignment;
+    unsigned m_region;
+    GLsizeiptr m_regionOffset;
+    std::vector<GLsync> m_fences;
+    StreamBufferStats m_stats;
+};
+
+#endif
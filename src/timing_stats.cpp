@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "json_writer.hpp"
+#include "timing_stats.hpp"
+
+static double Percentile(const std::vector<double> &sorted, double percent)
+{
+    size_t rank = static_cast<size_t>(std::ceil(percent / 100.0 * sorted.size()));
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+TimingStats::TimingStats() :
+    count(0),
+    mean(0.0),
+    min(0.0),
+    max(0.0),
+    p50(0.0),
+    p95(0.0),
+    p99(0.0)
+{
+}
+
+TimingStats TimingStats::FromSamples(std::vector<double> samples)
+{
+    TimingStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    double sum = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        sum += samples[i];
+    }
+
+    stats.count = samples.size();
+    stats.mean = sum / samples.size();
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.p50 = Percentile(samples, 50.0);
+    stats.p95 = Percentile(samples, 95.0);
+    stats.p99 = Percentile(samples, 99.0);
+    return stats;
+}
+
+void TimingStats::WriteJson(JsonWriter &json) const
+{
+    json.BeginObject();
+    json.Key("count");
+    json.Value(static_cast<unsigned long long>(count));
+    json.Key("mean");
+    json.Value(mean);
+    json.Key("min");
+    json.Value(min);
+    json.Key("p50");
+    json.Value(p50);
+    json.Key("p95");
+    json.Value(p95);
+    json.Key("p99");
+    json.Value(p99);
+    json.Key("max");
+    json.Value(max);
+    json.EndObject();
+}
+
+TimingHistory::TimingHistory(size_t windowSize) :
+    m_windowSize(windowSize),
+    m_series()
+{
+}
+
+void TimingHistory::Add(const char *name, double ms)
+{
+    size_t index = FindSeries(name);
+    if (index == m_series.size()) {
+        Series series;
+        series.name = name;
+        series.next = 0;
+        series.samples.reserve(m_windowSize);
+        m_series.push_back(series);
+    }
+
+    Series &series = m_series[index];
+    if (series.samples.size() < m_windowSize) {
+        series.samples.push_back(ms);
+    } else {
+        series.samples[series.next] = ms;
+    }
+    series.next = (series.next + 1) % m_windowSize;
+}
+
+size_t TimingHistory::FindSeries(const char *name) const
+{
+    // A handful of series: a linear search beats a map here
+    size_t index = 0;
+    while (index < m_series.size() && m_series[index].name != name && std::strcmp(m_series[index].name, name) != 0) {
+        index++;
+    }
+    return index;
+}
+
+TimingStats TimingHistory::SeriesStats(size_t index) const
+{
+    return TimingStats::FromSamples(m_series[index].samples);
+}
+
+void TimingHistory::WriteJson(JsonWriter &json) const
+{
+    json.BeginObject();
+    for (size_t i = 0; i < m_series.size(); i++) {
+        json.Key(m_series[i].name);
+        SeriesStats(i).WriteJson(json);
+    }
+    json.EndObject();
+}
@@ -0,0 +1,58 @@
+#ifndef TIMING_STATS_HPP
+#define TIMING_STATS_HPP
+
+#include <cstddef>
+#include <vector>
+
+class JsonWriter;
+
+// Summary of a set of durations in milliseconds. Percentiles use the
+// nearest-rank method, so they are always one of the samples.
+struct TimingStats
+{
+    TimingStats();
+
+    static TimingStats FromSamples(std::vector<double> samples);
+
+    void WriteJson(JsonWriter &json) const;
+
+    size_t count;
+    double mean;
+    double min;
+    double max;
+    double p50;
+    double p95;
+    double p99;
+};
+
+// Rolling window of the latest durations recorded under each name
+class TimingHistory
+{
+public:
+    explicit TimingHistory(size_t windowSize = 256);
+
+    // Names are kept by pointer and must outlive the history (literals)
+    void Add(const char *name, double ms);
+
+    size_t SeriesNum() const { return m_series.size(); }
+    const char * SeriesName(size_t index) const { return m_series[index].name; }
+    TimingStats SeriesStats(size_t index) const;
+    // Index of the series with that name, SeriesNum() if there is none
+    size_t FindSeries(const char *name) const;
+
+    // An object with the stats of every series, by name
+    void WriteJson(JsonWriter &json) const;
+
+private:
+    struct Series
+    {
+        const char *name;
+        std::vector<double> samples;
+        size_t next;
+    };
+
+    size_t m_windowSize;
+    std::vector<Series> m_series;
+};
+
+#endif
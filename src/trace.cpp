@@ -0,0 +1,189 @@
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "errors.hpp"
+#include "json_writer.hpp"
+#include "trace.hpp"
+
+std::atomic<bool> g_traceEnabled(false);
+
+struct TraceEvent
+{
+    const char *name;
+    const char *category;
+    int64_t start;
+    int64_t end;
+    char detail[64];
+};
+
+// Written only by its thread. The count is published with release
+// semantics after each event.
+struct TraceBuffer
+{
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> written;
+    unsigned threadId;
+    std::string threadName;
+};
+
+static std::mutex g_buffersMutex;
+static std::vector<std::unique_ptr<TraceBuffer>> g_buffers;
+static size_t g_eventsPerThread = 0;
+static int64_t g_traceStart = 0;
+static thread_local TraceBuffer *t_buffer = nullptr;
+
+// Buffers outlive their threads, so that worker zones are still written
+static TraceBuffer * GetThreadBuffer()
+{
+    if (!t_buffer) {
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        std::unique_ptr<TraceBuffer> buffer(new TraceBuffer);
+        buffer->events.resize(g_eventsPerThread);
+        buffer->written = 0;
+        buffer->threadId = static_cast<unsigned>(g_buffers.size() + 1);
+        t_buffer = buffer.get();
+        g_buffers.push_back(std::move(buffer));
+    }
+    return t_buffer;
+}
+
+void TraceStart(size_t eventsPerThread)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_buffersMutex);
+        g_eventsPerThread = eventsPerThread;
+        for (size_t i = 0; i < g_buffers.size(); i++) {
+            g_buffers[i]->events.assign(eventsPerThread, TraceEvent());
+            g_buffers[i]->written = 0;
+        }
+        g_traceStart = TraceNow();
+    }
+    g_traceEnabled.store(true);
+}
+
+void TraceStop()
+{
+    g_traceEnabled.store(false);
+}
+
+void TraceSetThreadName(const char *name)
+{
+    if (TraceEnabled()) {
+        GetThreadBuffer()->threadName = name;
+    }
+}
+
+void TraceRecord(const char *name, const char *category, int64_t start, int64_t end, const char *detail)
+{
+    TraceBuffer *buffer = GetThreadBuffer();
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    TraceEvent &event = buffer->events[index % buffer->events.size()];
+    event.name = name;
+    event.category = category;
+    event.start = start;
+    event.end = end;
+    std::memcpy(event.detail, detail, sizeof(event.detail));
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+void TraceWrite(const char *file)
+{
+    std::ofstream ofs(file);
+    if (!ofs) {
+        THROW(Error, std::string("Failed to open trace output: ") + file);
+    }
+
+    std::lock_guard<std::mutex> lock(g_buffersMutex);
+    uint64_t droppedNum = 0;
+
+    JsonWriter json(ofs);
+    json.BeginObject();
+    json.Key("traceEvents");
+    json.BeginArray();
+    for (size_t i = 0; i < g_buffers.size(); i++) {
+        const TraceBuffer &buffer = *g_buffers[i];
+        if (!buffer.threadName.empty()) {
+            json.BeginObject();
+            json.Key("name");
+            json.Value("thread_name");
+            json.Key("ph");
+            json.Value("M");
+            json.Key("pid");
+            json.Value(1);
+            json.Key("tid");
+            json.Value(static_cast<int>(buffer.threadId));
+            json.Key("args");
+            json.BeginObject();
+            json.Key("name");
+            json.Value(buffer.threadName);
+            json.EndObject();
+            json.EndObject();
+        }
+
+        // Only the latest events survive a ring that wrapped around
+        uint64_t written = buffer.written.load(std::memory_order_acquire);
+        uint64_t capacity = buffer.events.size();
+        uint64_t first = (written > capacity ? written - capacity : 0);
+        droppedNum += first;
+        for (uint64_t j = first; j < written; j++) {
+            const TraceEvent &event = buffer.events[j % capacity];
+            json.BeginObject();
+            json.Key("name");
+            json.Value(event.name);
+            json.Key("cat");
+            json.Value(event.category);
+            json.Key("ph");
+            json.Value("X");
+            json.Key("ts");
+            json.Value((event.start - g_traceStart) / 1000.0);
+            json.Key("dur");
+            json.Value((event.end - event.start) / 1000.0);
+            json.Key("pid");
+            json.Value(1);
+            json.Key("tid");
+            json.Value(static_cast<int>(buffer.threadId));
+            if (event.detail[0]) {
+                json.Key("args");
+                json.BeginObject();
+                json.Key("detail");
+                json.Value(event.detail);
+                json.EndObject();
+            }
+            json.EndObject();
+        }
+    }
+    json.EndArray();
+    json.Key("displayTimeUnit");
+    json.Value("ms");
+    json.Key("droppedEvents");
+    json.Value(static_cast<unsigned long long>(droppedNum));
+    json.EndObject();
+    ofs << std::endl;
+}
+
+TraceSession::TraceSession(const char *file) :
+    m_file(file)
+{
+    if (m_file) {
+        TraceStart();
+        TraceSetThreadName("main");
+    }
+}
+
+TraceSession::~TraceSession()
+{
+    if (!m_file) {
+        return;
+    }
+
+    TraceStop();
+    try {
+        TraceWrite(m_file);
+        std::cout << "Trace written to " << m_file << std::endl;
+    } catch (const Error &ex) {
+        std::cerr << "Error:" << std::endl << ex.Msg() << std::endl;
+    }
+}
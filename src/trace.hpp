@@ -0,0 +1,98 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+// Timeline of scoped zones, written as Chrome Trace Event JSON (viewable in
+// Perfetto or chrome://tracing). Each thread records into its own ring
+// buffer without locks; when a ring is full the oldest zones are
+// overwritten. With tracing off a zone costs a single relaxed atomic load.
+
+extern std::atomic<bool> g_traceEnabled;
+
+inline bool TraceEnabled()
+{
+    return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+inline int64_t TraceNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Starts recording, with rings of eventsPerThread zones
+void TraceStart(size_t eventsPerThread = 64 * 1024);
+void TraceStop();
+// Write what was recorded. Call after TraceStop(), once other threads are
+// done with their zones.
+void TraceWrite(const char *file);
+// Label the calling thread in the timeline
+void TraceSetThreadName(const char *name);
+
+// Name and category are kept by pointer and must be string literals
+void TraceRecord(const char *name, const char *category, int64_t start, int64_t end, const char *detail);
+
+class TraceZone
+{
+public:
+    TraceZone(const char *name, const char *category) : m_name(nullptr), m_category(category), m_start(0)
+    {
+        m_detail[0] = '\0';
+        if (TraceEnabled()) {
+            m_name = name;
+            m_start = TraceNow();
+        }
+    }
+
+    ~TraceZone()
+    {
+        End();
+    }
+
+    TraceZone(const TraceZone &) = delete;
+    TraceZone & operator=(const TraceZone &) = delete;
+
+    // Extra text shown with the zone (a file name...), truncated if long
+    void SetDetail(const char *detail)
+    {
+        if (m_name) {
+            std::strncpy(m_detail, detail, sizeof(m_detail) - 1);
+            m_detail[sizeof(m_detail) - 1] = '\0';
+        }
+    }
+
+    // End the zone before the end of its scope
+    void End()
+    {
+        if (m_name) {
+            TraceRecord(m_name, m_category, m_start, TraceNow(), m_detail);
+            m_name = nullptr;
+        }
+    }
+
+private:
+    const char *m_name;
+    const char *m_category;
+    int64_t m_start;
+    char m_detail[64];
+};
+
+// Starts tracing if given an output file and writes the trace when the
+// session ends
+class TraceSession
+{
+public:
+    explicit TraceSession(const char *file);
+    ~TraceSession();
+
+    TraceSession(const TraceSession &) = delete;
+    TraceSession & operator=(const TraceSession &) = delete;
+
+private:
+    const char *m_file;
+};
+
+#endif
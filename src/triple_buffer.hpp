@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+// Lock-free handoff of the latest value from one writer thread to one reader
+// thread. The writer fills the back slot and publishes it by swapping it with
+// the middle slot; the reader takes the middle slot in exchange for its
+// front slot when a newer value is there. Neither side ever waits, and the
+// reader always sees a complete value, skipping those it was too slow for.
+template <typename T>
+class TripleBuffer
+{
+public:
+    explicit TripleBuffer(const T &initial = T()) :
+        m_back(0),
+        m_middle(1),
+        m_front(2)
+    {
+        for (int i = 0; i < 3; i++) {
+            m_slots[i] = initial;
+        }
+    }
+
+    TripleBuffer(const TripleBuffer &) = delete;
+    TripleBuffer & operator=(const TripleBuffer &) = delete;
+
+    // Writer: the slot to fill, holding an older value
+    T & Back() { return m_slots[m_back]; }
+    void Publish()
+    {
+        m_back = m_middle.exchange(m_back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // Reader: the latest published value, valid until the next call
+    const T & Acquire()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & FRESH_BIT) {
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+        return m_slots[m_front];
+    }
+
+private:
+    // The middle index carries whether it was published since the last read
+    static const unsigned INDEX_MASK = 3;
+    static const unsigned FRESH_BIT = 4;
+
+    T m_slots[3];
+    unsigned m_back;
+    std::atomic<unsigned> m_middle;
+    unsigned m_front;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <cstring>
+#include "errors.hpp"
+#include "uniform_block.hpp"
+
+Std140Writer::Std140Writer(void *data, size_t capacity) :
+    m_data(static_cast<unsigned char *>(data)),
+    m_capacity(capacity),
+    m_offset(0)
+{
+}
+
+void Std140Writer::Write(float v)
+{
+    _Write(&v, sizeof(v), 4);
+}
+
+void Std140Writer::Write(int v)
+{
+    _Write(&v, sizeof(v), 4);
+}
+
+void Std140Writer::Write(const glm::vec2 &v)
+{
+    _Write(&v[0], sizeof(v), 8);
+}
+
+void Std140Writer::Write(const glm::vec3 &v)
+{
+    _Write(&v[0], sizeof(v), 16);
+}
+
+void Std140Writer::Write(const glm::vec4 &v)
+{
+    _Write(&v[0], sizeof(v), 16);
+}
+
+void Std140Writer::Write(const glm::mat3 &m)
+{
+    for (int i = 0; i < 3; i++) {
+        Write(glm::vec4(m[i], 0.0f));
+    }
+}
+
+void Std140Writer::Write(const glm::mat4 &m)
+{
+    for (int i = 0; i < 4; i++) {
+        Write(m[i]);
+    }
+}
+
+void Std140Writer::BeginStruct()
+{
+    _Align(16);
+}
+
+void Std140Writer::EndStruct()
+{
+    _Align(16);
+}
+
+void Std140Writer::_Write(const void *data, size_t size, size_t alignment)
+{
+    _Align(alignment);
+    if (m_offset + size > m_capacity) {
+        THROW(GLError, "Std140Writer: block data exceeds the buffer size");
+    }
+    std::memcpy(m_data + m_offset, data, size);
+    m_offset += size;
+}
+
+void Std140Writer::_Align(size_t alignment)
+{
+    m_offset = (m_offset + alignment - 1) / alignment * alignment;
+}
+
+UniformBlockBindings::UniformBlockBindings() :
+    m_bindings(),
+    m_nextBinding(0),
+    m_maxBindings(0)
+{
+    glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &m_maxBindings);
+}
+
+GLuint UniformBlockBindings::GetBinding(GLSLUniformName name)
+{
+    std::map<uint64_t, GLuint>::iterator it = m_bindings.find(name.Hash());
+    if (it != m_bindings.end()) {
+        return it->second;
+    }
+
+    if (static_cast<GLint>(m_nextBinding) >= m_maxBindings) {
+        THROW(GLError, "Out of uniform buffer binding points");
+    }
+    GLuint binding = m_nextBinding++;
+    m_bindings[name.Hash()] = binding;
+    return binding;
+}
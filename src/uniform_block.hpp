@@ -0,0 +1,57 @@
+#ifndef UNIFORM_BLOCK_HPP
+#define UNIFORM_BLOCK_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include "glsl_uniform.hpp"
+
+// Writes values with std140 layout rules: scalars are aligned to 4 bytes,
+// vec2 to 8, vec3/vec4 to 16, matrices are written as arrays of vec4 columns
+// and structs are aligned and padded to 16 bytes. A scalar following a vec3
+// is packed into the vec3's fourth component, as GLSL does.
+class Std140Writer
+{
+public:
+    Std140Writer(void *data, size_t capacity);
+
+    void Write(float v);
+    void Write(int v);
+    void Write(const glm::vec2 &v);
+    void Write(const glm::vec3 &v);
+    void Write(const glm::vec4 &v);
+    void Write(const glm::mat3 &m);
+    void Write(const glm::mat4 &m);
+
+    void BeginStruct();
+    void EndStruct();
+
+    size_t Size() const { return m_offset; }
+
+private:
+    void _Write(const void *data, size_t size, size_t alignment);
+    void _Align(size_t alignment);
+
+    unsigned char *m_data;
+    size_t m_capacity;
+    size_t m_offset;
+};
+
+// Assigns every uniform block name a binding point shared by all programs,
+// so that a buffer bound once for "LightBlock" serves each program using it
+class UniformBlockBindings
+{
+public:
+    UniformBlockBindings();
+
+    GLuint GetBinding(GLSLUniformName name);
+
+private:
+    std::map<uint64_t, GLuint> m_bindings;
+    GLuint m_nextBinding;
+    GLint m_maxBindings;
+};
+
+#endif
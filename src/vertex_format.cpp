@@ -0,0 +1,221 @@
+#include <glm/gtc/packing.hpp>
+#include <glm/gtx/simd_vec4.hpp>
+#include <emmintrin.h>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include "error.hpp"
+#include "parallel.hpp"
+#include "vertex_format.hpp"
+
+// Vertices per encoding task; a multiple of 4
+static const size_t ENCODE_CHUNK_VERTEX_NUM = 65536;
+
+static const MeshAttribute HALF_VERTEX_ATTRIBUTES[] = {
+    { 0, 0, 3, GL_HALF_FLOAT, GL_FALSE, 0 },
+    { 1, 0, 4, GL_INT_2_10_10_10_REV, GL_TRUE, 8 },
+};
+
+static const MeshAttribute QUANTIZED_VERTEX_ATTRIBUTES[] = {
+    { 0, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0 },
+    { 1, 0, 2, GL_BYTE, GL_TRUE, 6 },
+};
+
+const char * VertexFormatName(VertexFormat format)
+{
+    switch (format) {
+        case VertexFormat::FLOAT:     return "float";
+        case VertexFormat::HALF:      return "half";
+        case VertexFormat::QUANTIZED: return "quantized";
+        default:                      return "unknown";
+    }
+}
+
+GLsizei VertexFormatStride(VertexFormat format)
+{
+    switch (format) {
+        case VertexFormat::HALF:      return 12;
+        case VertexFormat::QUANTIZED: return 8;
+        default:                      return sizeof(MeshVertex);
+    }
+}
+
+void AddVertexFormatDefines(VertexFormat format, GLSLDefines &defines)
+{
+    // Half floats and 2_10_10_10 normals are decoded by the vertex fetch
+    if (format == VertexFormat::QUANTIZED) {
+        defines.Set("QUANTIZED_POSITION");
+        defines.Set("OCTAHEDRAL_NORMAL");
+    }
+}
+
+// glm 0.9.7's abs(simdVec4) masks with an uninitialized constant and
+// returns zeros, so clear the sign bits directly
+static glm::simdVec4 SimdAbs(const glm::simdVec4 &v)
+{
+    return glm::simdVec4(_mm_andnot_ps(_mm_set1_ps(-0.0f), v.Data));
+}
+
+// Run encode(first, num) over chunks of the vertex range
+static void EncodeChunks(size_t vertexNum, unsigned threadNum, const std::function<void(size_t, size_t)> &encode)
+{
+    size_t chunkNum = (vertexNum + ENCODE_CHUNK_VERTEX_NUM - 1) / ENCODE_CHUNK_VERTEX_NUM;
+    ParallelFor(chunkNum, threadNum, [&](size_t chunk) {
+        size_t first = chunk * ENCODE_CHUNK_VERTEX_NUM;
+        encode(first, std::min(ENCODE_CHUNK_VERTEX_NUM, vertexNum - first));
+    });
+}
+
+void EncodeHalfPositions(const MeshVertex *vertices, size_t vertexNum, void *dst, size_t stride, unsigned threadNum)
+{
+    unsigned char *bytes = static_cast<unsigned char *>(dst);
+    EncodeChunks(vertexNum, threadNum, [&](size_t first, size_t num) {
+        for (size_t i = first; i < first + num; i++) {
+            glm::uint64 packed = glm::packHalf4x16(glm::vec4(vertices[i].position, 0.0f));
+            std::memcpy(bytes + i * stride, &packed, sizeof(packed));
+        }
+    });
+}
+
+void EncodeQuantizedPositions(const MeshVertex *vertices, size_t vertexNum, const PositionTransform &transform,
+                              void *dst, size_t stride, unsigned threadNum)
+{
+    unsigned char *bytes = static_cast<unsigned char *>(dst);
+    glm::vec3 invScale = 1.0f / glm::max(transform.scale, glm::vec3(1e-30f));
+    const glm::simdVec4 offset(glm::vec4(transform.offset, 0.0f));
+    const glm::simdVec4 factor(glm::vec4(invScale * 65535.0f, 0.0f));
+    const glm::simdVec4 half(0.5f);
+    const glm::simdVec4 zero(0.0f);
+    const glm::simdVec4 maxValue(65535.0f);
+    EncodeChunks(vertexNum, threadNum, [&](size_t first, size_t num) {
+        for (size_t i = first; i < first + num; i++) {
+            const glm::vec3 &position = vertices[i].position;
+            glm::simdVec4 scaled = (glm::simdVec4(position.x, position.y, position.z, 0.0f) - offset) * factor + half;
+            int32_t lanes[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), _mm_cvttps_epi32(glm::clamp(scaled, zero, maxValue).Data));
+            uint16_t packed[3] = { static_cast<uint16_t>(lanes[0]), static_cast<uint16_t>(lanes[1]), static_cast<uint16_t>(lanes[2]) };
+            std::memcpy(bytes + i * stride, packed, sizeof(packed));
+        }
+    });
+}
+
+void EncodePackedNormals(const MeshVertex *vertices, size_t vertexNum, void *dst, size_t stride, unsigned threadNum)
+{
+    unsigned char *bytes = static_cast<unsigned char *>(dst);
+    EncodeChunks(vertexNum, threadNum, [&](size_t first, size_t num) {
+        for (size_t i = first; i < first + num; i++) {
+            glm::uint32 packed = glm::packSnorm3x10_1x2(glm::vec4(vertices[i].normal, 0.0f));
+            std::memcpy(bytes + i * stride, &packed, sizeof(packed));
+        }
+    });
+}
+
+void EncodeOctahedralNormals(const MeshVertex *vertices, size_t vertexNum, void *dst, size_t stride, unsigned threadNum)
+{
+    unsigned char *bytes = static_cast<unsigned char *>(dst);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const glm::simdVec4 one(1.0f);
+    const glm::simdVec4 snormScale(127.0f);
+    EncodeChunks(vertexNum, threadNum, [&](size_t first, size_t num) {
+        // Four normals at a time, one component per vector
+        for (size_t i = first; i < first + num; i += 4) {
+            size_t laneNum = std::min<size_t>(4, first + num - i);
+            float x[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float y[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+            float z[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            for (size_t lane = 0; lane < laneNum; lane++) {
+                x[lane] = vertices[i + lane].normal.x;
+                y[lane] = vertices[i + lane].normal.y;
+                z[lane] = vertices[i + lane].normal.z;
+            }
+            glm::simdVec4 nx(_mm_loadu_ps(x));
+            glm::simdVec4 ny(_mm_loadu_ps(y));
+            glm::simdVec4 nz(_mm_loadu_ps(z));
+
+            // Project onto the octahedron |x| + |y| + |z| = 1
+            glm::simdVec4 invL1 = one / (SimdAbs(nx) + SimdAbs(ny) + SimdAbs(nz));
+            nx = nx * invL1;
+            ny = ny * invL1;
+
+            // Fold the lower hemisphere over the diagonals
+            __m128 lower = _mm_cmplt_ps(nz.Data, _mm_setzero_ps());
+            __m128 foldX = _mm_or_ps(_mm_sub_ps(one.Data, SimdAbs(ny).Data), _mm_and_ps(nx.Data, signMask));
+            __m128 foldY = _mm_or_ps(_mm_sub_ps(one.Data, SimdAbs(nx).Data), _mm_and_ps(ny.Data, signMask));
+            nx = glm::simdVec4(_mm_or_ps(_mm_and_ps(lower, foldX), _mm_andnot_ps(lower, nx.Data)));
+            ny = glm::simdVec4(_mm_or_ps(_mm_and_ps(lower, foldY), _mm_andnot_ps(lower, ny.Data)));
+
+            __m128i qx = _mm_cvtps_epi32((glm::clamp(nx, -one, one) * snormScale).Data);
+            __m128i qy = _mm_cvtps_epi32((glm::clamp(ny, -one, one) * snormScale).Data);
+            int32_t outX[4], outY[4];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(outX), qx);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(outY), qy);
+            for (size_t lane = 0; lane < laneNum; lane++) {
+                int8_t packed[2] = { static_cast<int8_t>(outX[lane]), static_cast<int8_t>(outY[lane]) };
+                std::memcpy(bytes + (i + lane) * stride, packed, sizeof(packed));
+            }
+        }
+    });
+}
+
+PackedMesh::PackedMesh(const MeshData &mesh, VertexFormat format) :
+    m_format(format),
+    m_transform(),
+    m_vertexData(),
+    m_shortIndices(),
+    m_indices(),
+    m_streams()
+{
+    MeshBounds bounds = ComputeBounds(mesh);
+    m_transform.scale = glm::vec3(1.0f);
+    m_transform.offset = glm::vec3(0.0f);
+    if (format == VertexFormat::QUANTIZED) {
+        m_transform.scale = bounds.max - bounds.min;
+        m_transform.offset = bounds.min;
+    }
+
+    size_t vertexNum = mesh.vertices.size();
+    GLsizei stride = VertexFormatStride(format);
+    m_vertexData.assign(vertexNum * stride, 0);
+    const MeshVertex *vertices = mesh.vertices.data();
+    switch (format) {
+        case VertexFormat::FLOAT:
+            if (vertexNum > 0) {
+                std::memcpy(m_vertexData.data(), vertices, m_vertexData.size());
+            }
+            m_streams.attributes = MESH_VERTEX_ATTRIBUTES;
+            m_streams.attributeNum = sizeof(MESH_VERTEX_ATTRIBUTES) / sizeof(MESH_VERTEX_ATTRIBUTES[0]);
+            break;
+        case VertexFormat::HALF:
+            if (vertexNum > 0) {
+                EncodeHalfPositions(vertices, vertexNum, m_vertexData.data(), stride);
+                EncodePackedNormals(vertices, vertexNum, m_vertexData.data() + HALF_VERTEX_ATTRIBUTES[1].relativeOffset, stride);
+            }
+            m_streams.attributes = HALF_VERTEX_ATTRIBUTES;
+            m_streams.attributeNum = sizeof(HALF_VERTEX_ATTRIBUTES) / sizeof(HALF_VERTEX_ATTRIBUTES[0]);
+            break;
+        case VertexFormat::QUANTIZED:
+            if (vertexNum > 0) {
+                EncodeQuantizedPositions(vertices, vertexNum, m_transform, m_vertexData.data(), stride);
+                EncodeOctahedralNormals(vertices, vertexNum, m_vertexData.data() + QUANTIZED_VERTEX_ATTRIBUTES[1].relativeOffset, stride);
+            }
+            m_streams.attributes = QUANTIZED_VERTEX_ATTRIBUTES;
+            m_streams.attributeNum = sizeof(QUANTIZED_VERTEX_ATTRIBUTES) / sizeof(QUANTIZED_VERTEX_ATTRIBUTES[0]);
+            break;
+        default:
+            THROW(Error, "Unknown vertex format");
+    }
+
+    m_streams.vertexData = m_vertexData.data();
+    m_streams.vertexDataSize = m_vertexData.size();
+    m_streams.vertexStride = stride;
+    m_streams.indexNum = static_cast<GLsizei>(mesh.indices.size());
+    if (vertexNum <= 0x10000) {
+        m_shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+        m_streams.indexData = m_shortIndices.data();
+        m_streams.indexType = GL_UNSIGNED_SHORT;
+    } else {
+        m_indices = mesh.indices;
+        m_streams.indexData = m_indices.data();
+        m_streams.indexType = GL_UNSIGNED_INT;
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef VERTEX_FORMAT_HPP
+#define VERTEX_FORMAT_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "glsl_preprocessor.hpp"
+#include "mesh.hpp"
+
+// Vertex layouts a mesh can be uploaded in
+enum class VertexFormat
+{
+    // 24 bytes: float position and normal (MeshVertex)
+    FLOAT,
+    // 12 bytes: half-float position (padded to 8 bytes) and
+    // GL_INT_2_10_10_10_REV normal
+    HALF,
+    // 8 bytes: 16-bit unsigned normalized position, relative to the mesh
+    // bounds, and 8-bit octahedral normal
+    QUANTIZED,
+};
+
+const char * VertexFormatName(VertexFormat format);
+GLsizei VertexFormatStride(VertexFormat format);
+// Defines selecting the matching decoding in ads.vert
+void AddVertexFormatDefines(VertexFormat format, GLSLDefines &defines);
+
+// Maps stored positions back to mesh space: stored * scale + offset. The
+// identity for formats that store positions as they are.
+struct PositionTransform
+{
+    glm::vec3 scale;
+    glm::vec3 offset;
+};
+
+// Batch encoders: each writes one attribute of vertexNum vertices into dst,
+// stride bytes apart, on up to threadNum threads (0: one per core)
+void EncodeHalfPositions(const MeshVertex *vertices, size_t vertexNum, void *dst, size_t stride, unsigned threadNum = 0);
+void EncodeQuantizedPositions(const MeshVertex *vertices, size_t vertexNum, const PositionTransform &transform,
+                              void *dst, size_t stride, unsigned threadNum = 0);
+void EncodePackedNormals(const MeshVertex *vertices, size_t vertexNum, void *dst, size_t stride, unsigned threadNum = 0);
+void EncodeOctahedralNormals(const MeshVertex *vertices, size_t vertexNum, void *dst, size_t stride, unsigned threadNum = 0);
+
+// Mesh data encoded in a vertex format, ready for Mesh(const MeshStreams &)
+class PackedMesh
+{
+public:
+    PackedMesh(const MeshData &mesh, VertexFormat format);
+
+    PackedMesh(const PackedMesh &) = delete;
+    PackedMesh & operator=(const PackedMesh &) = delete;
+
+    // Points into the packed mesh, which must outlive its use
+    const MeshStreams & Streams() const { return m_streams; }
+    const PositionTransform & Transform() const { return m_transform; }
+    VertexFormat Format() const { return m_format; }
+
+private:
+    VertexFormat m_format;
+    PositionTransform m_transform;
+    std::vector<unsigned char> m_vertexData;
+    std::vector<uint16_t> m_shortIndices;
+    std::vector<uint32_t> m_indices;
+    MeshStreams m_streams;
+};
+
+#endif